@@ -0,0 +1,251 @@
+/*
+ * asmbench.c -- assembly output micro benchmark
+ *
+ * Writes the instructions of a synthetic program once with one
+ * fprintf per instruction, as codegen.c used to, and once with the
+ * buffered writer of asm.c, and checks that both outputs are equal.
+ * Usage: asmbench [<number of statements> ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "asm.h"
+
+#define STMS_PER_PROC	100
+
+/**************************************************************/
+
+/* the former formatting, kept here for comparison */
+
+static char *opNames[NUM_ASM_OPS] = {
+	NULL, NULL, "add", "sub", "mul", "div", "sll", "or", "ldhi",
+	"ldw", "stw", "beq", "bne", "blt", "ble", "bgt", "bge", "bgeu",
+	"j", "jal", "jr",
+};
+
+static void printInstr(FILE * outFile, AsmInstr * instr)
+{
+	switch (instr->op) {
+	case ASM_LABEL:
+		fprintf(outFile, "L%d:\n", instr->label);
+		break;
+	case ASM_PROC:
+		fprintf(outFile, "\n\t.export %s\n%s:\n",
+			symToString(instr->sym), symToString(instr->sym));
+		break;
+	case ASM_LDHI:
+		fprintf(outFile, "\tldhi\t$%d,0x%08X\n", instr->dst,
+			(unsigned) instr->imm);
+		break;
+	case ASM_OR:
+		fprintf(outFile, "\tor\t$%d,$%d,0x%04X\n", instr->dst,
+			instr->src1, (unsigned) instr->imm);
+		break;
+	case ASM_STW:
+		if (instr->comment != NULL) {
+			fprintf(outFile, "\tstw\t$%d,$%d,%d\t\t; %s\n", instr->src2,
+				instr->src1, instr->imm, instr->comment);
+		} else {
+			fprintf(outFile, "\tstw\t$%d,$%d,%d\n", instr->src2,
+				instr->src1, instr->imm);
+		}
+		break;
+	case ASM_BLT:
+		fprintf(outFile, "\tblt\t$%d,$%d,L%d\n",
+			instr->src1, instr->src2, instr->label);
+		break;
+	case ASM_J:
+		fprintf(outFile, "\tj\tL%d\n", instr->label);
+		break;
+	case ASM_JAL:
+		fprintf(outFile, "\tjal\t%s\n", symToString(instr->sym));
+		break;
+	case ASM_JR:
+		fprintf(outFile, "\tjr\t$%d\t\t\t; %s\n", instr->src1,
+			instr->comment);
+		break;
+	default:
+		if (instr->src2 != ASM_IMM) {
+			fprintf(outFile, "\t%s\t$%d,$%d,$%d\n", opNames[instr->op],
+				instr->dst, instr->src1, instr->src2);
+		} else if (instr->comment != NULL) {
+			fprintf(outFile, "\t%s\t$%d,$%d,%d\t\t; %s\n",
+				opNames[instr->op], instr->dst, instr->src1,
+				instr->imm, instr->comment);
+		} else {
+			fprintf(outFile, "\t%s\t$%d,$%d,%d\n", opNames[instr->op],
+				instr->dst, instr->src1, instr->imm);
+		}
+		break;
+	}
+}
+
+/**************************************************************/
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static AsmInstr *emit(AsmCode * code, int op, int dst, int src1, int src2,
+		      int imm)
+{
+	AsmInstr *instr;
+
+	instr = appendAsm(code, op);
+	instr->dst = dst;
+	instr->src1 = src1;
+	instr->src2 = src2;
+	instr->imm = imm;
+	return instr;
+}
+
+/**
+ * @brief Instructions like the code generator emits them for a
+ * program of simple statements: arithmetic on locals, large constants,
+ * loops and calls, a hundred statements per procedure
+ **/
+static void makeProgram(AsmCode * code, int statements)
+{
+	char name[32];
+	Sym *callee;
+	int i, label;
+
+	callee = newSym("printi");
+	label = 0;
+	for (i = 0; i < statements; i++) {
+		if (i % STMS_PER_PROC == 0) {
+			if (i != 0) {
+				emit(code, ASM_LDW, 31, 29, ASM_IMM, 4)->comment =
+				    "restore return register";
+				emit(code, ASM_LDW, 25, 29, ASM_IMM, 8)->comment =
+				    "restore old frame pointer";
+				emit(code, ASM_ADD, 29, 29, ASM_IMM, 48)->comment =
+				    "release frame";
+				emit(code, ASM_JR, 0, 31, 0, 0)->comment = "return";
+			}
+			sprintf(name, "proc%d", i / STMS_PER_PROC);
+			emit(code, ASM_PROC, 0, 0, 0, 0)->sym = newSym(name);
+			emit(code, ASM_SUB, 29, 29, ASM_IMM, 48)->comment =
+			    "allocate frame";
+			emit(code, ASM_STW, 0, 29, 25, 8)->comment =
+			    "save old frame pointer";
+			emit(code, ASM_ADD, 25, 29, ASM_IMM, 48)->comment =
+			    "setup new frame pointer";
+			emit(code, ASM_STW, 0, 29, 31, 4)->comment =
+			    "save return register";
+		}
+		switch (i % 4) {
+		case 0:
+			/* x := y + z * 4 */
+			emit(code, ASM_LDW, 8, 25, ASM_IMM, -8);
+			emit(code, ASM_LDW, 9, 25, ASM_IMM, -12);
+			emit(code, ASM_SLL, 9, 9, ASM_IMM, 2);
+			emit(code, ASM_ADD, 8, 8, 9, 0);
+			emit(code, ASM_STW, 0, 25, 8, -4);
+			break;
+		case 1:
+			/* y := 123456789 */
+			emit(code, ASM_LDHI, 10, 0, ASM_IMM, 123456789 + i);
+			emit(code, ASM_OR, 10, 10, ASM_IMM, (123456789 + i) & 0xFFFF);
+			emit(code, ASM_STW, 0, 25, 10, -8);
+			break;
+		case 2:
+			/* while (i < n) i := i + 1 */
+			emit(code, ASM_J, 0, 0, 0, 0)->label = label + 1;
+			emit(code, ASM_LABEL, 0, 0, 0, 0)->label = label;
+			emit(code, ASM_ADD, 16, 16, ASM_IMM, 1);
+			emit(code, ASM_LABEL, 0, 0, 0, 0)->label = label + 1;
+			emit(code, ASM_BLT, 0, 16, 17, 0)->label = label;
+			label += 2;
+			break;
+		case 3:
+			/* printi(x) */
+			emit(code, ASM_STW, 0, 29, 8, 0);
+			emit(code, ASM_JAL, 0, 0, 0, 0)->sym = callee;
+			break;
+		}
+	}
+}
+
+static void bench(int statements)
+{
+	AsmCode code;
+	AsmWriter writer;
+	FILE *old, *new;
+	double t0, tPrintf, tWriter;
+	long oldSize, newSize;
+	char *oldText, *newText;
+	int i;
+
+	initAsmCode(&code);
+	makeProgram(&code, statements);
+	old = tmpfile();
+	new = tmpfile();
+	if (old == NULL || new == NULL) {
+		error("cannot create temporary files");
+	}
+
+	t0 = now();
+	for (i = 0; i < code.count; i++) {
+		printInstr(old, &code.instrs[i]);
+	}
+	fflush(old);
+	tPrintf = now() - t0;
+
+	t0 = now();
+	initAsmWriter(&writer, new);
+	writeAsmCode(&writer, &code);
+	closeAsmWriter(&writer);
+	fflush(new);
+	tWriter = now() - t0;
+
+	oldSize = ftell(old);
+	newSize = ftell(new);
+	oldText = (char *) allocate(oldSize + 1);
+	newText = (char *) allocate(newSize + 1);
+	rewind(old);
+	rewind(new);
+	if (oldSize != newSize ||
+	    fread(oldText, 1, oldSize, old) != (size_t) oldSize ||
+	    fread(newText, 1, newSize, new) != (size_t) newSize ||
+	    memcmp(oldText, newText, oldSize) != 0) {
+		error("outputs differ for %d statements", statements);
+	}
+	fclose(old);
+	fclose(new);
+
+	printf("%10d %12d %10ld  %10.2f %10.2f\n", statements, code.count,
+	       oldSize, tPrintf * 1e9 / code.count, tWriter * 1e9 / code.count);
+	releaseArena(ARENA_CODEGEN);
+}
+
+int main(int argc, char *argv[])
+{
+	static int defaultSizes[] = { 1000, 10000, 100000 };
+	int i;
+
+	selectArena(ARENA_CODEGEN);
+	printf("%10s %12s %10s  %21s\n", "", "", "", "ns per instruction");
+	printf("%10s %12s %10s  %10s %10s\n",
+	       "statements", "instructions", "bytes", "fprintf", "writer");
+	if (argc > 1) {
+		for (i = 1; i < argc; i++) {
+			bench(atoi(argv[i]));
+		}
+	} else {
+		for (i = 0; i < 3; i++) {
+			bench(defaultSizes[i]);
+		}
+	}
+	return 0;
+}
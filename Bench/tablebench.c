@@ -0,0 +1,190 @@
+/*
+ * tablebench.c -- symbol table micro benchmark
+ *
+ * Compares the open addressing tables of table.c with the unbalanced
+ * search trees keyed by symbol stamp that table.c used before.
+ * Usage: tablebench [<number of symbols> ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "table.h"
+
+#define LOOKUP_ROUNDS	4
+
+/**************************************************************/
+
+/* the former per-scope search tree, kept here for comparison */
+
+typedef struct bintree {
+	Sym *sym;
+	unsigned key;
+	Entry *entry;
+	struct bintree *left;
+	struct bintree *right;
+} Bintree;
+
+typedef struct treetable {
+	Bintree *bintree;
+	struct treetable *upperLevel;
+} TreeTable;
+
+static TreeTable *newTreeTable(TreeTable * upperLevel)
+{
+	TreeTable *table;
+
+	table = (TreeTable *) allocate(sizeof(TreeTable));
+	table->bintree = NULL;
+	table->upperLevel = upperLevel;
+	return table;
+}
+
+static Entry *enterTree(TreeTable * table, Sym * sym, Entry * entry)
+{
+	unsigned key;
+	Bintree *newtree;
+	Bintree **link;
+
+	key = symToStamp(sym);
+	link = &table->bintree;
+	while (*link != NULL) {
+		if ((*link)->key == key) {
+			return NULL;
+		}
+		link = ((*link)->key > key) ? &(*link)->left : &(*link)->right;
+	}
+	newtree = (Bintree *) allocate(sizeof(Bintree));
+	newtree->sym = sym;
+	newtree->key = key;
+	newtree->entry = entry;
+	newtree->left = NULL;
+	newtree->right = NULL;
+	*link = newtree;
+	return entry;
+}
+
+static Entry *lookupTree(TreeTable * table, Sym * sym)
+{
+	unsigned key;
+	Bintree *bintree;
+
+	key = symToStamp(sym);
+	while (table != NULL) {
+		bintree = table->bintree;
+		while (bintree != NULL) {
+			if (bintree->key == key) {
+				return bintree->entry;
+			}
+			bintree = (bintree->key > key) ? bintree->left : bintree->right;
+		}
+		table = table->upperLevel;
+	}
+	return NULL;
+}
+
+/**************************************************************/
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static Sym **makeSyms(int n, int serial)
+{
+	Sym **syms;
+	char name[32];
+	int i;
+
+	syms = (Sym **) allocate(n * sizeof(Sym *));
+	for (i = 0; i < n; i++) {
+		sprintf(name, "v%d_%d", serial, i);
+		syms[i] = newSym(name);
+	}
+	return syms;
+}
+
+static void bench(int n, int serial)
+{
+	Sym **syms;
+	Entry *entry;
+	Table *global, *local;
+	TreeTable *treeGlobal, *treeLocal;
+	double t0, tHashEnter, tHashLookup, tTreeEnter, tTreeLookup;
+	int i, r;
+	long found;
+
+	syms = makeSyms(n, serial);
+	entry = newVarEntry(NULL, FALSE);
+
+	/* open addressing tables: local scope, lookups hit upper level */
+	t0 = now();
+	global = newTable(NULL);
+	for (i = 0; i < n; i++) {
+		enter(global, syms[i], entry);
+	}
+	local = newTable(global);
+	tHashEnter = now() - t0;
+	found = 0;
+	t0 = now();
+	for (r = 0; r < LOOKUP_ROUNDS; r++) {
+		for (i = 0; i < n; i++) {
+			found += lookup(local, syms[i]) != NULL;
+		}
+	}
+	tHashLookup = now() - t0;
+
+	/* search trees, same access pattern */
+	t0 = now();
+	treeGlobal = newTreeTable(NULL);
+	for (i = 0; i < n; i++) {
+		enterTree(treeGlobal, syms[i], entry);
+	}
+	treeLocal = newTreeTable(treeGlobal);
+	tTreeEnter = now() - t0;
+	t0 = now();
+	for (r = 0; r < LOOKUP_ROUNDS; r++) {
+		for (i = 0; i < n; i++) {
+			found += lookupTree(treeLocal, syms[i]) != NULL;
+		}
+	}
+	tTreeLookup = now() - t0;
+
+	if (found != 2L * LOOKUP_ROUNDS * n) {
+		error("lookup failed for %d symbols", n);
+	}
+	printf("%9d  %10.2f %10.2f  %10.2f %10.2f\n", n,
+	       tTreeEnter * 1e9 / n, tTreeLookup * 1e9 / (LOOKUP_ROUNDS * n),
+	       tHashEnter * 1e9 / n, tHashLookup * 1e9 / (LOOKUP_ROUNDS * n));
+	releaseArena(ARENA_SEMANT);
+}
+
+int main(int argc, char *argv[])
+{
+	static int defaultSizes[] = { 10000, 100000, 1000000 };
+	int i;
+
+	selectArena(ARENA_SEMANT);
+	printf("%9s  %21s  %21s\n", "", "search tree (ns/op)", "hash table (ns/op)");
+	printf("%9s  %10s %10s  %10s %10s\n",
+	       "symbols", "enter", "lookup", "enter", "lookup");
+	if (argc > 1) {
+		for (i = 1; i < argc; i++) {
+			bench(atoi(argv[i]), i);
+		}
+	} else {
+		for (i = 0; i < 3; i++) {
+			bench(defaultSizes[i], i);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,797 @@
+/*
+ * ecosim.c -- ECO32 instruction set simulator for compiled SPL programs
+ *
+ * Assembles the subset of ECO32 assembly that the SPL compiler emits
+ * and executes it. The runtime procedures imported by every program
+ * are implemented on the host, the graphics procedures draw into an
+ * in-memory framebuffer that can be saved as PPM image.
+ * After the run the number of executed instructions, cycles and calls
+ * goes to stderr. Cycles follow a simple model: one per ALU
+ * instruction or branch not taken, two per load, store and taken jump,
+ * more for multiplication and division.
+ * Usage: ecosim [--quiet] [--ops] [--ppm <file>] <file.s>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "common.h"
+
+#define MEMORY_SIZE	(4 * 1024 * 1024)	/* bytes of data memory */
+#define MAX_LINE	1024
+
+#define FB_WIDTH	640
+#define FB_HEIGHT	480
+
+/* cycles per instruction class */
+#define CYCLES_ALU	1
+#define CYCLES_MUL	4
+#define CYCLES_DIV	16
+#define CYCLES_MEM	2
+#define CYCLES_JUMP	2
+
+#define OP_ADD		0
+#define OP_SUB		1
+#define OP_MUL		2
+#define OP_DIV		3
+#define OP_REM		4
+#define OP_AND		5
+#define OP_OR		6
+#define OP_XOR		7
+#define OP_SLL		8
+#define OP_SLR		9
+#define OP_SAR		10
+#define OP_LDHI		11
+#define OP_LDW		12
+#define OP_STW		13
+#define OP_BEQ		14
+#define OP_BNE		15
+#define OP_BLT		16
+#define OP_BLE		17
+#define OP_BGT		18
+#define OP_BGE		19
+#define OP_BLTU		20
+#define OP_BLEU		21
+#define OP_BGTU		22
+#define OP_BGEU		23
+#define OP_J		24
+#define OP_JAL		25
+#define OP_JR		26
+#define OP_JALR		27
+#define NUM_OPS		28
+
+#define HOST_PRINTI	0
+#define HOST_PRINTC	1
+#define HOST_READI	2
+#define HOST_READC	3
+#define HOST_EXIT	4
+#define HOST_TIME	5
+#define HOST_CLEARALL	6
+#define HOST_SETPIXEL	7
+#define HOST_DRAWLINE	8
+#define HOST_DRAWCIRCLE	9
+#define HOST_INDEXERROR	10
+#define NUM_HOST	11
+
+static char *opNames[NUM_OPS] = {
+	"add", "sub", "mul", "div", "rem", "and", "or", "xor",
+	"sll", "slr", "sar", "ldhi", "ldw", "stw",
+	"beq", "bne", "blt", "ble", "bgt", "bge",
+	"bltu", "bleu", "bgtu", "bgeu", "j", "jal", "jr", "jalr",
+};
+
+static char *hostNames[NUM_HOST] = {
+	"printi", "printc", "readi", "readc", "exit", "time",
+	"clearAll", "setPixel", "drawLine", "drawCircle", "_indexError",
+};
+
+typedef struct {
+	int op;
+	int r1, r2, r3;		/* registers in operand order */
+	int imm;		/* immediate, or target instruction index */
+	boolean immForm;	/* last operand is an immediate */
+	char *target;		/* unresolved branch or jump target */
+	int line;
+} Insn;
+
+typedef struct {
+	char *name;
+	int index;		/* instruction index, -1 - host procedure */
+} Label;
+
+static char *fileName;
+static int lineNum;
+
+static Insn *code;
+static int numInsns, maxInsns;
+static Label *labels;
+static int numLabels, maxLabels;
+
+static unsigned reg[32];
+static unsigned char *memory;
+static unsigned *framebuffer;
+static boolean graphicsUsed;
+static long long insnCount, cycleCount, callCount;
+static long long opCount[NUM_OPS];
+static time_t startTime;
+
+/**************************************************************/
+
+static void fail(char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "ecosim: ");
+	if (lineNum > 0) {
+		fprintf(stderr, "%s, line %d: ", fileName, lineNum);
+	}
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+	exit(2);
+}
+
+static void *grow(void *p, int *max, int size)
+{
+	*max = *max == 0 ? 256 : 2 * *max;
+	p = realloc(p, *max * size);
+	if (p == NULL) {
+		fail("out of memory");
+	}
+	return p;
+}
+
+static char *copyName(char *s, int len)
+{
+	char *p;
+
+	p = malloc(len + 1);
+	if (p == NULL) {
+		fail("out of memory");
+	}
+	memcpy(p, s, len);
+	p[len] = '\0';
+	return p;
+}
+
+static int findLabel(char *name)
+{
+	int i;
+
+	for (i = 0; i < numLabels; i++) {
+		if (strcmp(labels[i].name, name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void defineLabel(char *name, int index)
+{
+	if (findLabel(name) >= 0) {
+		fail("label '%s' defined twice", name);
+	}
+	if (numLabels == maxLabels) {
+		labels = grow(labels, &maxLabels, sizeof(Label));
+	}
+	labels[numLabels].name = name;
+	labels[numLabels].index = index;
+	numLabels++;
+}
+
+/**************************************************************/
+
+/* assembler */
+
+static char *skipSpace(char *p)
+{
+	while (*p == ' ' || *p == '\t') {
+		p++;
+	}
+	return p;
+}
+
+static char *scanName(char *p, char **name)
+{
+	char *start;
+
+	start = p;
+	while (isalnum((unsigned char) *p) || *p == '_' || *p == '.') {
+		p++;
+	}
+	if (p == start) {
+		fail("name expected");
+	}
+	*name = copyName(start, p - start);
+	return p;
+}
+
+static char *scanComma(char *p)
+{
+	p = skipSpace(p);
+	if (*p != ',') {
+		fail("',' expected");
+	}
+	return skipSpace(p + 1);
+}
+
+static char *scanReg(char *p, int *r)
+{
+	char *end;
+	long n;
+
+	p = skipSpace(p);
+	if (*p != '$') {
+		fail("register expected");
+	}
+	n = strtol(p + 1, &end, 10);
+	if (end == p + 1 || n < 0 || n > 31) {
+		fail("bad register");
+	}
+	*r = n;
+	return end;
+}
+
+static char *scanImm(char *p, int *imm)
+{
+	char *end;
+	long long n;
+
+	p = skipSpace(p);
+	n = strtoll(p, &end, 0);
+	if (end == p) {
+		fail("number expected");
+	}
+	if (n < -2147483648LL || n > 4294967295LL) {
+		fail("number out of range");
+	}
+	*imm = (int) n;
+	return end;
+}
+
+static void checkImm(Insn * insn, boolean isSigned)
+{
+	if (isSigned ? (insn->imm < -32768 || insn->imm > 32767)
+	    : (insn->imm < 0 || insn->imm > 0xFFFF)) {
+		fail("immediate value %d out of range", insn->imm);
+	}
+}
+
+static void assembleInsn(char *p)
+{
+	Insn insn;
+	char *name;
+	int op;
+
+	memset(&insn, 0, sizeof(Insn));
+	insn.line = lineNum;
+	p = scanName(p, &name);
+	for (op = 0; op < NUM_OPS; op++) {
+		if (strcmp(opNames[op], name) == 0) {
+			break;
+		}
+	}
+	if (op == NUM_OPS) {
+		fail("unknown instruction '%s'", name);
+	}
+	free(name);
+	insn.op = op;
+	switch (op) {
+	case OP_LDHI:
+		p = scanReg(p, &insn.r1);
+		p = scanImm(scanComma(p), &insn.imm);
+		insn.imm = (unsigned) insn.imm & 0xFFFF0000;
+		break;
+	case OP_LDW:
+	case OP_STW:
+		p = scanReg(p, &insn.r1);
+		p = scanReg(scanComma(p), &insn.r2);
+		p = scanImm(scanComma(p), &insn.imm);
+		checkImm(&insn, TRUE);
+		break;
+	case OP_J:
+	case OP_JAL:
+		p = scanName(skipSpace(p), &insn.target);
+		break;
+	case OP_JR:
+	case OP_JALR:
+		p = scanReg(p, &insn.r1);
+		break;
+	default:
+		p = scanReg(p, &insn.r1);
+		p = scanReg(scanComma(p), &insn.r2);
+		p = scanComma(p);
+		if (op >= OP_BEQ) {
+			p = scanName(p, &insn.target);
+		} else if (*p == '$') {
+			p = scanReg(p, &insn.r3);
+		} else {
+			p = scanImm(p, &insn.imm);
+			insn.immForm = TRUE;
+			checkImm(&insn, op < OP_AND || op > OP_XOR);
+		}
+		break;
+	}
+	p = skipSpace(p);
+	if (*p != '\0') {
+		fail("junk at end of line");
+	}
+	if (numInsns == maxInsns) {
+		code = grow(code, &maxInsns, sizeof(Insn));
+	}
+	code[numInsns++] = insn;
+}
+
+static void assembleLine(char *line)
+{
+	char *p, *name, *start;
+	int i;
+
+	p = strchr(line, ';');
+	if (p != NULL) {
+		*p = '\0';
+	}
+	p = line + strlen(line);
+	while (p > line && isspace((unsigned char) p[-1])) {
+		*--p = '\0';
+	}
+	p = skipSpace(line);
+	if (*p == '\0') {
+		return;
+	}
+	if (*p == '.') {
+		start = p;
+		p = scanName(p, &name);
+		if (strcmp(name, ".import") == 0) {
+			p = scanName(skipSpace(p), &name);
+			for (i = 0; i < NUM_HOST; i++) {
+				if (strcmp(hostNames[i], name) == 0) {
+					break;
+				}
+			}
+			if (i == NUM_HOST) {
+				fail("no runtime procedure '%s'", name);
+			}
+			defineLabel(name, -1 - i);
+		} else if (strcmp(name, ".code") != 0 &&
+			   strcmp(name, ".align") != 0 &&
+			   strcmp(name, ".export") != 0) {
+			fail("unsupported directive '%s'", start);
+		}
+		return;
+	}
+	start = p;
+	p = scanName(p, &name);
+	if (*p == ':') {
+		defineLabel(name, numInsns);
+		p = skipSpace(p + 1);
+		if (*p == '\0') {
+			return;
+		}
+		start = p;
+	} else {
+		free(name);
+	}
+	assembleInsn(start);
+}
+
+static void assemble(FILE * in)
+{
+	char line[MAX_LINE];
+	int i, l;
+
+	lineNum = 0;
+	while (fgets(line, MAX_LINE, in) != NULL) {
+		lineNum++;
+		assembleLine(line);
+	}
+	for (i = 0; i < numInsns; i++) {
+		if (code[i].target == NULL) {
+			continue;
+		}
+		lineNum = code[i].line;
+		l = findLabel(code[i].target);
+		if (l < 0) {
+			fail("undefined label '%s'", code[i].target);
+		}
+		code[i].imm = labels[l].index;
+	}
+	lineNum = 0;
+}
+
+/**************************************************************/
+
+/* runtime */
+
+static unsigned *word(unsigned addr)
+{
+	if (addr >= MEMORY_SIZE || (addr & 3) != 0) {
+		fail("bad memory address 0x%08X", addr);
+	}
+	return (unsigned *) (memory + addr);
+}
+
+static int arg(int n)
+{
+	return (int) *word(reg[29] + 4 * n);
+}
+
+static void setPixel(int x, int y, int color)
+{
+	if (x >= 0 && x < FB_WIDTH && y >= 0 && y < FB_HEIGHT) {
+		framebuffer[y * FB_WIDTH + x] = color;
+	}
+}
+
+static void drawLine(int x1, int y1, int x2, int y2, int color)
+{
+	int dx, dy, sx, sy, err, e2;
+
+	dx = abs(x2 - x1);
+	dy = -abs(y2 - y1);
+	sx = x1 < x2 ? 1 : -1;
+	sy = y1 < y2 ? 1 : -1;
+	err = dx + dy;
+	while (1) {
+		setPixel(x1, y1, color);
+		if (x1 == x2 && y1 == y2) {
+			break;
+		}
+		e2 = 2 * err;
+		if (e2 >= dy) {
+			err += dy;
+			x1 += sx;
+		}
+		if (e2 <= dx) {
+			err += dx;
+			y1 += sy;
+		}
+	}
+}
+
+static void drawCircle(int x0, int y0, int radius, int color)
+{
+	int x, y, err;
+
+	x = radius;
+	y = 0;
+	err = 1 - radius;
+	while (x >= y) {
+		setPixel(x0 + x, y0 + y, color);
+		setPixel(x0 + y, y0 + x, color);
+		setPixel(x0 - y, y0 + x, color);
+		setPixel(x0 - x, y0 + y, color);
+		setPixel(x0 - x, y0 - y, color);
+		setPixel(x0 - y, y0 - x, color);
+		setPixel(x0 + y, y0 - x, color);
+		setPixel(x0 + x, y0 - y, color);
+		y++;
+		if (err < 0) {
+			err += 2 * y + 1;
+		} else {
+			x--;
+			err += 2 * (y - x) + 1;
+		}
+	}
+}
+
+/* returns exit status, or -1 to continue */
+static int hostCall(int proc)
+{
+	int i, c;
+
+	switch (proc) {
+	case HOST_PRINTI:
+		printf("%d", arg(0));
+		break;
+	case HOST_PRINTC:
+		putchar(arg(0));
+		break;
+	case HOST_READI:
+		fflush(stdout);
+		if (scanf("%d", &i) != 1) {
+			fail("readi: no integer on input");
+		}
+		*word(arg(0)) = i;
+		break;
+	case HOST_READC:
+		fflush(stdout);
+		c = getchar();
+		*word(arg(0)) = c;
+		break;
+	case HOST_EXIT:
+		return 0;
+	case HOST_TIME:
+		*word(arg(0)) = (int) (time(NULL) - startTime);
+		break;
+	case HOST_CLEARALL:
+		graphicsUsed = TRUE;
+		for (i = 0; i < FB_WIDTH * FB_HEIGHT; i++) {
+			framebuffer[i] = arg(0);
+		}
+		break;
+	case HOST_SETPIXEL:
+		graphicsUsed = TRUE;
+		setPixel(arg(0), arg(1), arg(2));
+		break;
+	case HOST_DRAWLINE:
+		graphicsUsed = TRUE;
+		drawLine(arg(0), arg(1), arg(2), arg(3), arg(4));
+		break;
+	case HOST_DRAWCIRCLE:
+		graphicsUsed = TRUE;
+		drawCircle(arg(0), arg(1), arg(2), arg(3));
+		break;
+	case HOST_INDEXERROR:
+		fflush(stdout);
+		fprintf(stderr, "Error: index out of bounds\n");
+		return 1;
+	}
+	return -1;
+}
+
+/**************************************************************/
+
+/* simulator */
+
+static int run(int entry)
+{
+	Insn *insn;
+	int pc, halt, status;
+	unsigned b;
+
+	halt = numInsns;
+	reg[29] = MEMORY_SIZE;
+	reg[31] = 4 * halt;
+	pc = entry;
+	while (pc != halt) {
+		if (pc < 0 || pc > numInsns) {
+			fail("jump to bad address 0x%08X", 4 * pc);
+		}
+		insn = &code[pc++];
+		insnCount++;
+		opCount[insn->op]++;
+		b = insn->immForm ? (unsigned) insn->imm : reg[insn->r3];
+		switch (insn->op) {
+		case OP_ADD:
+			reg[insn->r1] = reg[insn->r2] + b;
+			cycleCount += CYCLES_ALU;
+			break;
+		case OP_SUB:
+			reg[insn->r1] = reg[insn->r2] - b;
+			cycleCount += CYCLES_ALU;
+			break;
+		case OP_MUL:
+			reg[insn->r1] = (int) reg[insn->r2] * (int) b;
+			cycleCount += CYCLES_MUL;
+			break;
+		case OP_DIV:
+		case OP_REM:
+			if (b == 0) {
+				fflush(stdout);
+				fprintf(stderr, "Error: division by zero\n");
+				return 1;
+			}
+			if (reg[insn->r2] == 0x80000000 && b == 0xFFFFFFFF) {
+				/* the only overflowing division */
+				reg[insn->r1] = insn->op == OP_DIV ? 0x80000000 : 0;
+			} else if (insn->op == OP_DIV) {
+				reg[insn->r1] = (int) reg[insn->r2] / (int) b;
+			} else {
+				reg[insn->r1] = (int) reg[insn->r2] % (int) b;
+			}
+			cycleCount += CYCLES_DIV;
+			break;
+		case OP_AND:
+			reg[insn->r1] = reg[insn->r2] & b;
+			cycleCount += CYCLES_ALU;
+			break;
+		case OP_OR:
+			reg[insn->r1] = reg[insn->r2] | b;
+			cycleCount += CYCLES_ALU;
+			break;
+		case OP_XOR:
+			reg[insn->r1] = reg[insn->r2] ^ b;
+			cycleCount += CYCLES_ALU;
+			break;
+		case OP_SLL:
+			reg[insn->r1] = reg[insn->r2] << (b & 31);
+			cycleCount += CYCLES_ALU;
+			break;
+		case OP_SLR:
+			reg[insn->r1] = reg[insn->r2] >> (b & 31);
+			cycleCount += CYCLES_ALU;
+			break;
+		case OP_SAR:
+			reg[insn->r1] = (int) reg[insn->r2] >> (b & 31);
+			cycleCount += CYCLES_ALU;
+			break;
+		case OP_LDHI:
+			reg[insn->r1] = insn->imm;
+			cycleCount += CYCLES_ALU;
+			break;
+		case OP_LDW:
+			reg[insn->r1] = *word(reg[insn->r2] + insn->imm);
+			cycleCount += CYCLES_MEM;
+			break;
+		case OP_STW:
+			*word(reg[insn->r2] + insn->imm) = reg[insn->r1];
+			cycleCount += CYCLES_MEM;
+			break;
+		case OP_BEQ:
+		case OP_BNE:
+		case OP_BLT:
+		case OP_BLE:
+		case OP_BGT:
+		case OP_BGE:
+		case OP_BLTU:
+		case OP_BLEU:
+		case OP_BGTU:
+		case OP_BGEU:
+			cycleCount += CYCLES_ALU;
+			switch (insn->op) {
+			case OP_BEQ: b = reg[insn->r1] == reg[insn->r2]; break;
+			case OP_BNE: b = reg[insn->r1] != reg[insn->r2]; break;
+			case OP_BLT: b = (int) reg[insn->r1] < (int) reg[insn->r2]; break;
+			case OP_BLE: b = (int) reg[insn->r1] <= (int) reg[insn->r2]; break;
+			case OP_BGT: b = (int) reg[insn->r1] > (int) reg[insn->r2]; break;
+			case OP_BGE: b = (int) reg[insn->r1] >= (int) reg[insn->r2]; break;
+			case OP_BLTU: b = reg[insn->r1] < reg[insn->r2]; break;
+			case OP_BLEU: b = reg[insn->r1] <= reg[insn->r2]; break;
+			case OP_BGTU: b = reg[insn->r1] > reg[insn->r2]; break;
+			case OP_BGEU: b = reg[insn->r1] >= reg[insn->r2]; break;
+			}
+			if (!b) {
+				break;
+			}
+			cycleCount += CYCLES_JUMP - CYCLES_ALU;
+			if (insn->imm < 0) {
+				/* a runtime procedure that does not return */
+				status = hostCall(-1 - insn->imm);
+				if (status < 0) {
+					fail("branch to returning procedure '%s'",
+					     hostNames[-1 - insn->imm]);
+				}
+				return status;
+			}
+			pc = insn->imm;
+			break;
+		case OP_J:
+		case OP_JAL:
+			cycleCount += CYCLES_JUMP;
+			if (insn->op == OP_JAL) {
+				reg[31] = 4 * pc;
+				callCount++;
+			}
+			if (insn->imm < 0) {
+				status = hostCall(-1 - insn->imm);
+				if (status >= 0) {
+					return status;
+				}
+				if (insn->op == OP_J) {
+					pc = reg[31] / 4;
+				}
+				break;
+			}
+			pc = insn->imm;
+			break;
+		case OP_JR:
+		case OP_JALR:
+			cycleCount += CYCLES_JUMP;
+			b = reg[insn->r1];
+			if (insn->op == OP_JALR) {
+				reg[31] = 4 * pc;
+				callCount++;
+			}
+			if ((b & 3) != 0) {
+				fail("jump to bad address 0x%08X", b);
+			}
+			pc = b / 4;
+			break;
+		}
+		reg[0] = 0;
+	}
+	return 0;
+}
+
+static void writePpm(char *ppmName)
+{
+	FILE *out;
+	unsigned c;
+	int i;
+
+	out = fopen(ppmName, "wb");
+	if (out == NULL) {
+		fail("cannot open '%s'", ppmName);
+	}
+	fprintf(out, "P6\n%d %d\n255\n", FB_WIDTH, FB_HEIGHT);
+	for (i = 0; i < FB_WIDTH * FB_HEIGHT; i++) {
+		c = framebuffer[i];
+		putc((c >> 16) & 0xFF, out);
+		putc((c >> 8) & 0xFF, out);
+		putc(c & 0xFF, out);
+	}
+	fclose(out);
+}
+
+static void showOps(void)
+{
+	int op;
+
+	for (op = 0; op < NUM_OPS; op++) {
+		if (opCount[op] != 0) {
+			fprintf(stderr, "%-8s%12lld\n", opNames[op], opCount[op]);
+		}
+	}
+}
+
+static void usage(char *myself)
+{
+	fprintf(stderr,
+		"Usage: %s [--quiet] [--ops] [--ppm <file>] <file.s>\n",
+		myself);
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *in;
+	char *ppmName;
+	boolean quiet, ops;
+	int i, l, status;
+
+	quiet = FALSE;
+	ops = FALSE;
+	ppmName = NULL;
+	fileName = NULL;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--quiet") == 0) {
+			quiet = TRUE;
+		} else if (strcmp(argv[i], "--ops") == 0) {
+			ops = TRUE;
+		} else if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+			ppmName = argv[++i];
+		} else if (argv[i][0] == '-' || fileName != NULL) {
+			usage(argv[0]);
+		} else {
+			fileName = argv[i];
+		}
+	}
+	if (fileName == NULL) {
+		usage(argv[0]);
+	}
+	in = fopen(fileName, "r");
+	if (in == NULL) {
+		fail("cannot open input file '%s'", fileName);
+	}
+	assemble(in);
+	fclose(in);
+	l = findLabel("main");
+	if (l < 0 || labels[l].index < 0) {
+		fail("no procedure 'main'");
+	}
+	memory = calloc(MEMORY_SIZE, 1);
+	framebuffer = calloc(FB_WIDTH * FB_HEIGHT, sizeof(unsigned));
+	if (memory == NULL || framebuffer == NULL) {
+		fail("out of memory");
+	}
+	startTime = time(NULL);
+	status = run(labels[l].index);
+	fflush(stdout);
+	if (ppmName != NULL && graphicsUsed) {
+		writePpm(ppmName);
+	}
+	if (!quiet) {
+		fprintf(stderr, "\n%lld instructions, %lld cycles, %lld calls\n",
+			insnCount, cycleCount, callCount);
+	}
+	if (ops) {
+		showOps();
+	}
+	return status;
+}
@@ -5,286 +5,519 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <limits.h>
 
 #include "common.h"
 #include "utils.h"
 #include "sym.h"
 #include "absyn.h"
 
-/**************************************************************/
+/*
+ * Nodes only occupy the bytes their kind needs: the common header
+ * followed by their own member of the union, and a list only as many
+ * item positions as it has items. While parsing, a list is built from
+ * its first item and the list of the others, like a cons cell: it has
+ * the count of all its items, but the positions of these two only.
+ * The parser keeps positions, not pointers, because the array of the
+ * parsed nodes moves when it grows.
+ */
+#define NODE_SIZE(member)	(offsetof(Absyn, u) + sizeof(((Absyn *) 0)->u.member))
+#define LIST_SIZE(n)		(offsetof(Absyn, u.decList.items) + (n) * sizeof(AbsynRef))
+#define ALIGNED(size)		(((size) + ABSYN_UNIT - 1) & ~(size_t) (ABSYN_UNIT - 1))
+
+/* largest array allocate() can return; its positions fit an AbsynRef */
+#define MAX_NODES_SIZE		((size_t) UINT_MAX & ~(size_t) (ABSYN_UNIT - 1))
+
+__thread char *absynNodes = NULL;
+
+static __thread size_t parsedSize;	/* bytes of parsed nodes */
+static __thread size_t parsedMax;	/* bytes allocated for them */
+
+static unsigned nodeSize(Absyn * node)
+{
+	switch (node->type) {
+	case ABSYN_NAMETY:		return NODE_SIZE(nameTy);
+	case ABSYN_ARRAYTY:		return NODE_SIZE(arrayTy);
+	case ABSYN_TYPEDEC:		return NODE_SIZE(typeDec);
+	case ABSYN_PROCDEC:		return NODE_SIZE(procDec);
+	case ABSYN_PARDEC:		return NODE_SIZE(parDec);
+	case ABSYN_VARDEC:		return NODE_SIZE(varDec);
+	case ABSYN_EMPTYSTM:		return NODE_SIZE(emptyStm);
+	case ABSYN_COMPSTM:		return NODE_SIZE(compStm);
+	case ABSYN_ASSIGNSTM:		return NODE_SIZE(assignStm);
+	case ABSYN_IFSTM:		return NODE_SIZE(ifStm);
+	case ABSYN_WHILESTM:		return NODE_SIZE(whileStm);
+	case ABSYN_CALLSTM:		return NODE_SIZE(callStm);
+	case ABSYN_OPEXP:		return NODE_SIZE(opExp);
+	case ABSYN_VAREXP:		return NODE_SIZE(varExp);
+	case ABSYN_INTEXP:		return NODE_SIZE(intExp);
+	case ABSYN_SIMPLEVAR:		return NODE_SIZE(simpleVar);
+	case ABSYN_ARRAYVAR:		return NODE_SIZE(arrayVar);
+	default:
+		error("unknown node type %d in nodeSize", node->type);
+	}
+	return 0;
+}
 
-Absyn *newNameTy(int line, Sym * name)
+/**
+ * @brief Start an empty array of parsed nodes in the current arena and
+ * select it
+ *
+ * @return void
+ **/
+void startAbsyn(void)
 {
+	absynNodes = NULL;
+	parsedSize = 0;
+	parsedMax = 0;
+}
+
+static AbsynRef newNode(int type, int line, unsigned size)
+{
+	char *nodes;
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_NAMETY;
+	if (parsedSize + size > parsedMax) {
+		if (parsedSize + size > MAX_NODES_SIZE) {
+			error("program too large");
+		}
+		/* the old array stays in the arena until it is released */
+		parsedMax = parsedMax == 0 ? ARENA_CHUNK_SIZE : 2 * parsedMax;
+		if (parsedMax > MAX_NODES_SIZE) {
+			parsedMax = MAX_NODES_SIZE;
+		}
+		nodes = (char *) allocate(parsedMax);
+		memcpy(nodes, absynNodes, parsedSize);
+		absynNodes = nodes;
+	}
+	ref = parsedSize / ABSYN_UNIT;
+	parsedSize += ALIGNED(size);
+	node = ABSYN(ref);
+	node->type = type;
 	node->line = line;
-	node->u.nameTy.name = name;
-	return node;
+	node->typeGraph = NULL;
+	return ref;
 }
 
-Absyn *newArrayTy(int line, int size, Absyn * ty)
+static AbsynRef newList(int type, AbsynRef head, AbsynRef tail)
 {
+	AbsynRef ref;
 	Absyn *node;
+	int count;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_ARRAYTY;
-	node->line = line;
+	count = ABSYN(tail)->u.decList.count + 1;
+	ref = newNode(type, -1, LIST_SIZE(2));
+	node = ABSYN(ref);
+	node->u.decList.count = count;
+	node->u.decList.items[0] = head;
+	node->u.decList.items[1] = tail;
+	return ref;
+}
+
+/**************************************************************/
+
+AbsynRef newNameTy(int line, Sym * name)
+{
+	AbsynRef ref;
+
+	ref = newNode(ABSYN_NAMETY, line, NODE_SIZE(nameTy));
+	ABSYN(ref)->u.nameTy.name = name;
+	return ref;
+}
+
+AbsynRef newArrayTy(int line, int size, AbsynRef ty)
+{
+	AbsynRef ref;
+	Absyn *node;
+
+	ref = newNode(ABSYN_ARRAYTY, line, NODE_SIZE(arrayTy));
+	node = ABSYN(ref);
 	node->u.arrayTy.size = size;
 	node->u.arrayTy.ty = ty;
-	return node;
+	return ref;
 }
 
-Absyn *newTypeDec(int line, Sym * name, Absyn * ty)
+AbsynRef newTypeDec(int line, Sym * name, AbsynRef ty)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_TYPEDEC;
-	node->line = line;
+	ref = newNode(ABSYN_TYPEDEC, line, NODE_SIZE(typeDec));
+	node = ABSYN(ref);
 	node->u.typeDec.name = name;
 	node->u.typeDec.ty = ty;
-	return node;
+	return ref;
 }
 
-Absyn *newProcDec(int line, Sym * name, Absyn * params, Absyn * decls, Absyn * body)
+AbsynRef newProcDec(int line, Sym * name, AbsynRef params, AbsynRef decls, AbsynRef body)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_PROCDEC;
-	node->line = line;
+	ref = newNode(ABSYN_PROCDEC, line, NODE_SIZE(procDec));
+	node = ABSYN(ref);
 	node->u.procDec.name = name;
 	node->u.procDec.params = params;
 	node->u.procDec.decls = decls;
 	node->u.procDec.body = body;
-	return node;
+	return ref;
 }
 
-Absyn *newParDec(int line, Sym * name, Absyn * ty, boolean isRef)
+AbsynRef newParDec(int line, Sym * name, AbsynRef ty, boolean isRef)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_PARDEC;
-	node->line = line;
+	ref = newNode(ABSYN_PARDEC, line, NODE_SIZE(parDec));
+	node = ABSYN(ref);
 	node->u.parDec.name = name;
 	node->u.parDec.ty = ty;
 	node->u.parDec.isRef = isRef;
-	return node;
+	return ref;
 }
 
-Absyn *newVarDec(int line, Sym * name, Absyn * ty)
+AbsynRef newVarDec(int line, Sym * name, AbsynRef ty)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_VARDEC;
-	node->line = line;
+	ref = newNode(ABSYN_VARDEC, line, NODE_SIZE(varDec));
+	node = ABSYN(ref);
 	node->u.varDec.name = name;
 	node->u.varDec.ty = ty;
-	return node;
+	return ref;
 }
 
-Absyn *newEmptyStm(int line)
+AbsynRef newEmptyStm(int line)
 {
-	Absyn *node;
-
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_EMPTYSTM;
-	node->line = line;
-	return node;
+	return newNode(ABSYN_EMPTYSTM, line, NODE_SIZE(emptyStm));
 }
 
-Absyn *newCompStm(int line, Absyn * stms)
+AbsynRef newCompStm(int line, AbsynRef stms)
 {
-	Absyn *node;
+	AbsynRef ref;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_COMPSTM;
-	node->line = line;
-	node->u.compStm.stms = stms;
-	return node;
+	ref = newNode(ABSYN_COMPSTM, line, NODE_SIZE(compStm));
+	ABSYN(ref)->u.compStm.stms = stms;
+	return ref;
 }
 
-Absyn *newAssignStm(int line, Absyn * var, Absyn * exp)
+AbsynRef newAssignStm(int line, AbsynRef var, AbsynRef exp)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_ASSIGNSTM;
-	node->line = line;
+	ref = newNode(ABSYN_ASSIGNSTM, line, NODE_SIZE(assignStm));
+	node = ABSYN(ref);
 	node->u.assignStm.var = var;
 	node->u.assignStm.exp = exp;
-	return node;
+	return ref;
 }
 
-Absyn *newIfStm(int line, Absyn * test, Absyn * thenPart, Absyn * elsePart)
+AbsynRef newIfStm(int line, AbsynRef test, AbsynRef thenPart, AbsynRef elsePart)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_IFSTM;
-	node->line = line;
+	ref = newNode(ABSYN_IFSTM, line, NODE_SIZE(ifStm));
+	node = ABSYN(ref);
 	node->u.ifStm.test = test;
 	node->u.ifStm.thenPart = thenPart;
 	node->u.ifStm.elsePart = elsePart;
-	return node;
+	return ref;
 }
 
-Absyn *newWhileStm(int line, Absyn * test, Absyn * body)
+AbsynRef newWhileStm(int line, AbsynRef test, AbsynRef body)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_WHILESTM;
-	node->line = line;
+	ref = newNode(ABSYN_WHILESTM, line, NODE_SIZE(whileStm));
+	node = ABSYN(ref);
 	node->u.whileStm.test = test;
 	node->u.whileStm.body = body;
-	return node;
+	return ref;
 }
 
-Absyn *newCallStm(int line, Sym * name, Absyn * args)
+AbsynRef newCallStm(int line, Sym * name, AbsynRef args)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_CALLSTM;
-	node->line = line;
+	ref = newNode(ABSYN_CALLSTM, line, NODE_SIZE(callStm));
+	node = ABSYN(ref);
 	node->u.callStm.name = name;
 	node->u.callStm.args = args;
-	return node;
+	return ref;
 }
 
-Absyn *newOpExp(int line, int op, Absyn * left, Absyn * right)
+AbsynRef newOpExp(int line, int op, AbsynRef left, AbsynRef right)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_OPEXP;
-	node->line = line;
+	ref = newNode(ABSYN_OPEXP, line, NODE_SIZE(opExp));
+	node = ABSYN(ref);
 	node->u.opExp.op = op;
 	node->u.opExp.left = left;
 	node->u.opExp.right = right;
-	return node;
+	return ref;
 }
 
-Absyn *newVarExp(int line, Absyn * var)
+AbsynRef newVarExp(int line, AbsynRef var)
 {
-	Absyn *node;
+	AbsynRef ref;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_VAREXP;
-	node->line = line;
-	node->u.varExp.var = var;
-	return node;
+	ref = newNode(ABSYN_VAREXP, line, NODE_SIZE(varExp));
+	ABSYN(ref)->u.varExp.var = var;
+	return ref;
 }
 
-Absyn *newIntExp(int line, int val)
+AbsynRef newIntExp(int line, int val)
 {
-	Absyn *node;
+	AbsynRef ref;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_INTEXP;
-	node->line = line;
-	node->u.intExp.val = val;
-	return node;
+	ref = newNode(ABSYN_INTEXP, line, NODE_SIZE(intExp));
+	ABSYN(ref)->u.intExp.val = val;
+	return ref;
 }
 
-Absyn *newSimpleVar(int line, Sym * name)
+AbsynRef newSimpleVar(int line, Sym * name)
 {
-	Absyn *node;
+	AbsynRef ref;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_SIMPLEVAR;
-	node->line = line;
-	node->u.simpleVar.name = name;
-	return node;
+	ref = newNode(ABSYN_SIMPLEVAR, line, NODE_SIZE(simpleVar));
+	ABSYN(ref)->u.simpleVar.name = name;
+	return ref;
 }
 
-Absyn *newArrayVar(int line, Absyn * var, Absyn * index)
+AbsynRef newArrayVar(int line, AbsynRef var, AbsynRef index)
 {
+	AbsynRef ref;
 	Absyn *node;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_ARRAYVAR;
-	node->line = line;
+	ref = newNode(ABSYN_ARRAYVAR, line, NODE_SIZE(arrayVar));
+	node = ABSYN(ref);
 	node->u.arrayVar.var = var;
 	node->u.arrayVar.index = index;
-	return node;
+	return ref;
 }
 
-Absyn *emptyDecList(void)
+AbsynRef emptyDecList(void)
 {
-	Absyn *node;
+	AbsynRef ref;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_DECLIST;
-	node->line = -1;
-	node->u.decList.isEmpty = TRUE;
-	return node;
+	ref = newNode(ABSYN_DECLIST, -1, LIST_SIZE(0));
+	ABSYN(ref)->u.decList.count = 0;
+	return ref;
 }
 
-Absyn *newDecList(Absyn * head, Absyn * tail)
+AbsynRef newDecList(AbsynRef head, AbsynRef tail)
 {
-	Absyn *node;
-
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_DECLIST;
-	node->line = -1;
-	node->u.decList.isEmpty = FALSE;
-	node->u.decList.head = head;
-	node->u.decList.tail = tail;
-	return node;
+	return newList(ABSYN_DECLIST, head, tail);
 }
 
-Absyn *emptyStmList(void)
+AbsynRef emptyStmList(void)
 {
-	Absyn *node;
+	AbsynRef ref;
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_STMLIST;
-	node->line = -1;
-	node->u.stmList.isEmpty = TRUE;
-	return node;
+	ref = newNode(ABSYN_STMLIST, -1, LIST_SIZE(0));
+	ABSYN(ref)->u.stmList.count = 0;
+	return ref;
 }
 
-Absyn *newStmList(Absyn * head, Absyn * tail)
+AbsynRef newStmList(AbsynRef head, AbsynRef tail)
 {
-	Absyn *node;
+	return newList(ABSYN_STMLIST, head, tail);
+}
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_STMLIST;
-	node->line = -1;
-	node->u.stmList.isEmpty = FALSE;
-	node->u.stmList.head = head;
-	node->u.stmList.tail = tail;
-	return node;
+AbsynRef emptyExpList(void)
+{
+	AbsynRef ref;
+
+	ref = newNode(ABSYN_EXPLIST, -1, LIST_SIZE(0));
+	ABSYN(ref)->u.expList.count = 0;
+	return ref;
 }
 
-Absyn *emptyExpList(void)
+AbsynRef newExpList(AbsynRef head, AbsynRef tail)
 {
-	Absyn *node;
+	return newList(ABSYN_EXPLIST, head, tail);
+}
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_EXPLIST;
-	node->line = -1;
-	node->u.expList.isEmpty = TRUE;
-	return node;
+/**************************************************************/
+
+/*
+ * Compaction copies the parsed nodes into one block, laid out in the
+ * preorder in which all later passes walk them. A list is followed by
+ * its items, each with its subtree, and gets the positions of all of
+ * them. The parsed lists are followed iteratively, so that long lists
+ * do not deepen the recursion.
+ */
+
+typedef struct {
+	char *from;		/* parsed nodes */
+	char *to;		/* compacted nodes */
+	size_t size;		/* bytes of compacted nodes so far */
+} Compactor;
+
+#define PARSED(c, ref)	((Absyn *) ((c)->from + (size_t) (ref) * ABSYN_UNIT))
+
+static boolean isList(Absyn * node)
+{
+	return node->type == ABSYN_DECLIST ||
+	       node->type == ABSYN_STMLIST ||
+	       node->type == ABSYN_EXPLIST;
 }
 
-Absyn *newExpList(Absyn * head, Absyn * tail)
+static int childSlots(Absyn * node, AbsynRef * slots[])
 {
+	switch (node->type) {
+	case ABSYN_ARRAYTY:
+		slots[0] = &node->u.arrayTy.ty;
+		return 1;
+	case ABSYN_TYPEDEC:
+		slots[0] = &node->u.typeDec.ty;
+		return 1;
+	case ABSYN_PROCDEC:
+		slots[0] = &node->u.procDec.params;
+		slots[1] = &node->u.procDec.decls;
+		slots[2] = &node->u.procDec.body;
+		return 3;
+	case ABSYN_PARDEC:
+		slots[0] = &node->u.parDec.ty;
+		return 1;
+	case ABSYN_VARDEC:
+		slots[0] = &node->u.varDec.ty;
+		return 1;
+	case ABSYN_COMPSTM:
+		slots[0] = &node->u.compStm.stms;
+		return 1;
+	case ABSYN_ASSIGNSTM:
+		slots[0] = &node->u.assignStm.var;
+		slots[1] = &node->u.assignStm.exp;
+		return 2;
+	case ABSYN_IFSTM:
+		slots[0] = &node->u.ifStm.test;
+		slots[1] = &node->u.ifStm.thenPart;
+		slots[2] = &node->u.ifStm.elsePart;
+		return 3;
+	case ABSYN_WHILESTM:
+		slots[0] = &node->u.whileStm.test;
+		slots[1] = &node->u.whileStm.body;
+		return 2;
+	case ABSYN_CALLSTM:
+		slots[0] = &node->u.callStm.args;
+		return 1;
+	case ABSYN_OPEXP:
+		slots[0] = &node->u.opExp.left;
+		slots[1] = &node->u.opExp.right;
+		return 2;
+	case ABSYN_VAREXP:
+		slots[0] = &node->u.varExp.var;
+		return 1;
+	case ABSYN_ARRAYVAR:
+		slots[0] = &node->u.arrayVar.var;
+		slots[1] = &node->u.arrayVar.index;
+		return 2;
+	}
+	return 0;
+}
+
+static size_t treeSize(Compactor * c, AbsynRef ref)
+{
+	AbsynRef *slots[3];
 	Absyn *node;
+	size_t size;
+	int i, n;
+
+	node = PARSED(c, ref);
+	if (isList(node)) {
+		size = ALIGNED(LIST_SIZE(node->u.decList.count));
+		while (node->u.decList.count != 0) {
+			size += treeSize(c, node->u.decList.items[0]);
+			node = PARSED(c, node->u.decList.items[1]);
+		}
+		return size;
+	}
+	size = ALIGNED(nodeSize(node));
+	n = childSlots(node, slots);
+	for (i = 0; i < n; i++) {
+		size += treeSize(c, *slots[i]);
+	}
+	return size;
+}
+
+static AbsynRef copyTree(Compactor * c, AbsynRef ref)
+{
+	AbsynRef *slots[3];
+	Absyn *node, *copy;
+	AbsynRef pos;
+	unsigned size;
+	int i, n;
+
+	node = PARSED(c, ref);
+	pos = c->size / ABSYN_UNIT;
+	copy = (Absyn *) (c->to + c->size);
+	if (isList(node)) {
+		n = node->u.decList.count;
+		size = LIST_SIZE(n);
+		memcpy(copy, node, offsetof(Absyn, u.decList.items));
+		c->size += ALIGNED(size);
+		for (i = 0; i < n; i++) {
+			copy->u.decList.items[i] =
+			    copyTree(c, node->u.decList.items[0]);
+			node = PARSED(c, node->u.decList.items[1]);
+		}
+		return pos;
+	}
+	size = nodeSize(node);
+	memcpy(copy, node, size);
+	c->size += ALIGNED(size);
+	n = childSlots(copy, slots);
+	for (i = 0; i < n; i++) {
+		*slots[i] = copyTree(c, *slots[i]);
+	}
+	return pos;
+}
+
+/**
+ * @brief Copy the parsed nodes into one block in preorder, which
+ * becomes the selected array
+ *
+ * @param root position of the parsed program
+ * @param arena the block is allocated in
+ * @return Absyn* - the program, first node of its array
+ **/
+Absyn *compactAbsyn(AbsynRef root, int arena)
+{
+	Compactor c;
+	size_t size;
+
+	c.from = absynNodes;
+	c.size = 0;
+	size = treeSize(&c, root);
+	if (size > MAX_NODES_SIZE) {
+		error("program too large");
+	}
+	c.to = (char *) allocateIn(arena, size);
+	copyTree(&c, root);
+	absynNodes = c.to;
+	return (Absyn *) c.to;
+}
 
-	node = (Absyn *) allocate(sizeof(Absyn));
-	node->type = ABSYN_EXPLIST;
-	node->line = -1;
-	node->u.expList.isEmpty = FALSE;
-	node->u.expList.head = head;
-	node->u.expList.tail = tail;
-	return node;
+/**
+ * @brief Let ABSYN() find the nodes of a program in the calling thread,
+ * e.g. in a worker that checks or translates a part of it
+ *
+ * @param program compacted abstract syntax, first of its array
+ * @return void
+ **/
+void selectAbsyn(Absyn * program)
+{
+	absynNodes = (char *) program;
 }
 
 /**************************************************************/
@@ -334,7 +567,7 @@ static void showArrayTy(Absyn * node, int n)
 	indent(n + 1);
 	sayInt(node->u.arrayTy.size);
 	say(",\n");
-	showNode(node->u.arrayTy.ty, n + 1);
+	showNode(ABSYN(node->u.arrayTy.ty), n + 1);
 	say(")");
 }
 
@@ -345,7 +578,7 @@ static void showTypeDec(Absyn * node, int n)
 	indent(n + 1);
 	say(symToString(node->u.typeDec.name));
 	say(",\n");
-	showNode(node->u.typeDec.ty, n + 1);
+	showNode(ABSYN(node->u.typeDec.ty), n + 1);
 	say(")");
 }
 
@@ -356,11 +589,11 @@ static void showProcDec(Absyn * node, int n)
 	indent(n + 1);
 	say(symToString(node->u.procDec.name));
 	say(",\n");
-	showNode(node->u.procDec.params, n + 1);
+	showNode(ABSYN(node->u.procDec.params), n + 1);
 	say(",\n");
-	showNode(node->u.procDec.decls, n + 1);
+	showNode(ABSYN(node->u.procDec.decls), n + 1);
 	say(",\n");
-	showNode(node->u.procDec.body, n + 1);
+	showNode(ABSYN(node->u.procDec.body), n + 1);
 	say(")");
 }
 
@@ -371,7 +604,7 @@ static void showParDec(Absyn * node, int n)
 	indent(n + 1);
 	say(symToString(node->u.parDec.name));
 	say(",\n");
-	showNode(node->u.parDec.ty, n + 1);
+	showNode(ABSYN(node->u.parDec.ty), n + 1);
 	say(",\n");
 	indent(n + 1);
 	sayBoolean(node->u.parDec.isRef);
@@ -385,7 +618,7 @@ static void showVarDec(Absyn * node, int n)
 	indent(n + 1);
 	say(symToString(node->u.varDec.name));
 	say(",\n");
-	showNode(node->u.varDec.ty, n + 1);
+	showNode(ABSYN(node->u.varDec.ty), n + 1);
 	say(")");
 }
 
@@ -399,7 +632,7 @@ static void showCompStm(Absyn * node, int n)
 {
 	indent(n);
 	say("CompStm(\n");
-	showNode(node->u.compStm.stms, n + 1);
+	showNode(ABSYN(node->u.compStm.stms), n + 1);
 	say(")");
 }
 
@@ -407,9 +640,9 @@ static void showAssignStm(Absyn * node, int n)
 {
 	indent(n);
 	say("AssignStm(\n");
-	showNode(node->u.assignStm.var, n + 1);
+	showNode(ABSYN(node->u.assignStm.var), n + 1);
 	say(",\n");
-	showNode(node->u.assignStm.exp, n + 1);
+	showNode(ABSYN(node->u.assignStm.exp), n + 1);
 	say(")");
 }
 
@@ -417,11 +650,11 @@ static void showIfStm(Absyn * node, int n)
 {
 	indent(n);
 	say("IfStm(\n");
-	showNode(node->u.ifStm.test, n + 1);
+	showNode(ABSYN(node->u.ifStm.test), n + 1);
 	say(",\n");
-	showNode(node->u.ifStm.thenPart, n + 1);
+	showNode(ABSYN(node->u.ifStm.thenPart), n + 1);
 	say(",\n");
-	showNode(node->u.ifStm.elsePart, n + 1);
+	showNode(ABSYN(node->u.ifStm.elsePart), n + 1);
 	say(")");
 }
 
@@ -429,9 +662,9 @@ static void showWhileStm(Absyn * node, int n)
 {
 	indent(n);
 	say("WhileStm(\n");
-	showNode(node->u.whileStm.test, n + 1);
+	showNode(ABSYN(node->u.whileStm.test), n + 1);
 	say(",\n");
-	showNode(node->u.whileStm.body, n + 1);
+	showNode(ABSYN(node->u.whileStm.body), n + 1);
 	say(")");
 }
 
@@ -442,7 +675,7 @@ static void showCallStm(Absyn * node, int n)
 	indent(n + 1);
 	say(symToString(node->u.callStm.name));
 	say(",\n");
-	showNode(node->u.callStm.args, n + 1);
+	showNode(ABSYN(node->u.callStm.args), n + 1);
 	say(")");
 }
 
@@ -466,9 +699,9 @@ static void showOpExp(Absyn * node, int n)
 		error("unknown operator %d in showOp", node->u.opExp.op);
 	}
 	say(",\n");
-	showNode(node->u.opExp.left, n + 1);
+	showNode(ABSYN(node->u.opExp.left), n + 1);
 	say(",\n");
-	showNode(node->u.opExp.right, n + 1);
+	showNode(ABSYN(node->u.opExp.right), n + 1);
 	say(")");
 }
 
@@ -476,7 +709,7 @@ static void showVarExp(Absyn * node, int n)
 {
 	indent(n);
 	say("VarExp(\n");
-	showNode(node->u.varExp.var, n + 1);
+	showNode(ABSYN(node->u.varExp.var), n + 1);
 	say(")");
 }
 
@@ -500,21 +733,22 @@ static void showArrayVar(Absyn * node, int n)
 {
 	indent(n);
 	say("ArrayVar(\n");
-	showNode(node->u.arrayVar.var, n + 1);
+	showNode(ABSYN(node->u.arrayVar.var), n + 1);
 	say(",\n");
-	showNode(node->u.arrayVar.index, n + 1);
+	showNode(ABSYN(node->u.arrayVar.index), n + 1);
 	say(")");
 }
 
 static void showDecList(Absyn * node, int n)
 {
+	int i;
+
 	indent(n);
 	say("DecList(");
-	while (!node->u.decList.isEmpty) {
+	for (i = 0; i < node->u.decList.count; i++) {
 		say("\n");
-		showNode(node->u.decList.head, n + 1);
-		node = node->u.decList.tail;
-		if (!node->u.decList.isEmpty) {
+		showNode(ABSYN(node->u.decList.items[i]), n + 1);
+		if (i < node->u.decList.count - 1) {
 			say(",");
 		}
 	}
@@ -523,13 +757,14 @@ static void showDecList(Absyn * node, int n)
 
 static void showStmList(Absyn * node, int n)
 {
+	int i;
+
 	indent(n);
 	say("StmList(");
-	while (!node->u.stmList.isEmpty) {
+	for (i = 0; i < node->u.stmList.count; i++) {
 		say("\n");
-		showNode(node->u.stmList.head, n + 1);
-		node = node->u.stmList.tail;
-		if (!node->u.stmList.isEmpty) {
+		showNode(ABSYN(node->u.stmList.items[i]), n + 1);
+		if (i < node->u.stmList.count - 1) {
 			say(",");
 		}
 	}
@@ -538,13 +773,14 @@ static void showStmList(Absyn * node, int n)
 
 static void showExpList(Absyn * node, int n)
 {
+	int i;
+
 	indent(n);
 	say("ExpList(");
-	while (!node->u.expList.isEmpty) {
+	for (i = 0; i < node->u.expList.count; i++) {
 		say("\n");
-		showNode(node->u.expList.head, n + 1);
-		node = node->u.expList.tail;
-		if (!node->u.expList.isEmpty) {
+		showNode(ABSYN(node->u.expList.items[i]), n + 1);
+		if (i < node->u.expList.count - 1) {
 			say(",");
 		}
 	}
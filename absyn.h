@@ -39,6 +39,23 @@
 
 #include "types.h"
 
+/*
+ * The nodes of a program lie in one array, each taking only the bytes
+ * its kind needs, and refer to their children by 32-bit positions in
+ * that array. A list holds the positions of all its items one after
+ * another. ABSYN() turns a position into a node of the array selected
+ * in the calling thread.
+ */
+
+#define ABSYN_UNIT		8	/* nodes start at multiples of this */
+
+typedef unsigned AbsynRef;	/* position of a node, in units */
+
+extern __thread char *absynNodes;	/* array of the selected program */
+
+#define ABSYN(ref)	((Absyn *) (absynNodes + (size_t) (ref) * ABSYN_UNIT))
+#define ABSYN_REF(node)	((AbsynRef) (((char *) (node) - absynNodes) / ABSYN_UNIT))
+
 typedef struct absyn {
 	int type;
 	int line;
@@ -49,57 +66,57 @@ typedef struct absyn {
 		} nameTy;
 		struct {
 			int size;
-			struct absyn *ty;
+			AbsynRef ty;
 		} arrayTy;
 		struct {
 			Sym *name;
-			struct absyn *ty;
+			AbsynRef ty;
 		} typeDec;
 		struct {
 			Sym *name;
-			struct absyn *params;
-			struct absyn *decls;
-			struct absyn *body;
+			AbsynRef params;
+			AbsynRef decls;
+			AbsynRef body;
 		} procDec;
 		struct {
 			Sym *name;
-			struct absyn *ty;
+			AbsynRef ty;
 			boolean isRef;
 		} parDec;
 		struct {
 			Sym *name;
-			struct absyn *ty;
+			AbsynRef ty;
 		} varDec;
 		struct {
 			int dummy;	/* empty struct not allowed in C */
 		} emptyStm;
 		struct {
-			struct absyn *stms;
+			AbsynRef stms;
 		} compStm;
 		struct {
-			struct absyn *var;
-			struct absyn *exp;
+			AbsynRef var;
+			AbsynRef exp;
 		} assignStm;
 		struct {
-			struct absyn *test;
-			struct absyn *thenPart;
-			struct absyn *elsePart;
+			AbsynRef test;
+			AbsynRef thenPart;
+			AbsynRef elsePart;
 		} ifStm;
 		struct {
-			struct absyn *test;
-			struct absyn *body;
+			AbsynRef test;
+			AbsynRef body;
 		} whileStm;
 		struct {
 			Sym *name;
-			struct absyn *args;
+			AbsynRef args;
 		} callStm;
 		struct {
 			int op;
-			struct absyn *left;
-			struct absyn *right;
+			AbsynRef left;
+			AbsynRef right;
 		} opExp;
 		struct {
-			struct absyn *var;
+			AbsynRef var;
 		} varExp;
 		struct {
 			int val;
@@ -108,63 +125,65 @@ typedef struct absyn {
 			Sym *name;
 		} simpleVar;
 		struct {
-			struct absyn *var;
-			struct absyn *index;
+			AbsynRef var;
+			AbsynRef index;
 		} arrayVar;
 		struct {
-			boolean isEmpty;
-			struct absyn *head;
-			struct absyn *tail;
+			int count;	/* number of items */
+			AbsynRef items[1];	/* the node ends after the last */
 		} decList;
 		struct {
-			boolean isEmpty;
-			struct absyn *head;
-			struct absyn *tail;
+			int count;
+			AbsynRef items[1];
 		} stmList;
 		struct {
-			boolean isEmpty;
-			struct absyn *head;
-			struct absyn *tail;
+			int count;
+			AbsynRef items[1];
 		} expList;
 	} u;
 } Absyn;
 
+void startAbsyn(void);
+
 /* Type constructors */
-Absyn *newNameTy(int line, Sym * name);
-Absyn *newArrayTy(int line, int size, Absyn * ty);
+AbsynRef newNameTy(int line, Sym * name);
+AbsynRef newArrayTy(int line, int size, AbsynRef ty);
 
 /* Type declaration constructors */
-Absyn *newTypeDec(int line, Sym * name, Absyn * ty);
-Absyn *newProcDec(int line, Sym * name, Absyn * params, Absyn * decls, Absyn * body);
+AbsynRef newTypeDec(int line, Sym * name, AbsynRef ty);
+AbsynRef newProcDec(int line, Sym * name, AbsynRef params, AbsynRef decls, AbsynRef body);
 
 /* Variable declaration constructors */
-Absyn *newParDec(int line, Sym * name, Absyn * ty, boolean isRef);
-Absyn *newVarDec(int line, Sym * name, Absyn * ty);
+AbsynRef newParDec(int line, Sym * name, AbsynRef ty, boolean isRef);
+AbsynRef newVarDec(int line, Sym * name, AbsynRef ty);
 
 /* Statement constructors */
-Absyn *newEmptyStm(int line);
-Absyn *newCompStm(int line, Absyn * stms);
-Absyn *newAssignStm(int line, Absyn * var, Absyn * exp);
-Absyn *newIfStm(int line, Absyn * test, Absyn * thenPart, Absyn * elsePart);
-Absyn *newWhileStm(int line, Absyn * test, Absyn * body);
-Absyn *newCallStm(int line, Sym * name, Absyn * args);
+AbsynRef newEmptyStm(int line);
+AbsynRef newCompStm(int line, AbsynRef stms);
+AbsynRef newAssignStm(int line, AbsynRef var, AbsynRef exp);
+AbsynRef newIfStm(int line, AbsynRef test, AbsynRef thenPart, AbsynRef elsePart);
+AbsynRef newWhileStm(int line, AbsynRef test, AbsynRef body);
+AbsynRef newCallStm(int line, Sym * name, AbsynRef args);
 
 /* Expression constructors */
-Absyn *newOpExp(int line, int op, Absyn * left, Absyn * right);
-Absyn *newVarExp(int line, Absyn * var);
-Absyn *newIntExp(int line, int val);
+AbsynRef newOpExp(int line, int op, AbsynRef left, AbsynRef right);
+AbsynRef newVarExp(int line, AbsynRef var);
+AbsynRef newIntExp(int line, int val);
 
 /* Variable constructors */
-Absyn *newSimpleVar(int line, Sym * name);
-Absyn *newArrayVar(int line, Absyn * var, Absyn * index);
+AbsynRef newSimpleVar(int line, Sym * name);
+AbsynRef newArrayVar(int line, AbsynRef var, AbsynRef index);
 
 /* List constructors */
-Absyn *emptyDecList(void);
-Absyn *newDecList(Absyn * head, Absyn * tail);
-Absyn *emptyStmList(void);
-Absyn *newStmList(Absyn * head, Absyn * tail);
-Absyn *emptyExpList(void);
-Absyn *newExpList(Absyn * head, Absyn * tail);
+AbsynRef emptyDecList(void);
+AbsynRef newDecList(AbsynRef head, AbsynRef tail);
+AbsynRef emptyStmList(void);
+AbsynRef newStmList(AbsynRef head, AbsynRef tail);
+AbsynRef emptyExpList(void);
+AbsynRef newExpList(AbsynRef head, AbsynRef tail);
+
+Absyn *compactAbsyn(AbsynRef root, int arena);
+void selectAbsyn(Absyn * program);
 
 void showAbsyn(Absyn * node);
 
@@ -0,0 +1,238 @@
+/*
+ * alias.c -- aliasing of ref parameters
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "alias.h"
+
+/*
+ * Two ref parameters of a procedure may alias if some call passes
+ * overlapping variables for them. The actual parameters of a call
+ * overlap if they are the same variable or elements of it, or if they
+ * are ref parameters of the caller that may alias in turn. A variable
+ * of the caller never overlaps a ref parameter of the caller, which
+ * points outside of its frame. The relation only grows, so the calls
+ * of all procedures are visited until nothing changes; recursive calls
+ * need no special treatment. A ref parameter that aliases no other
+ * one is the only way to its memory while the procedure runs.
+ */
+
+/* the procedure declared in the program, NULL for predefined ones */
+static ParamAliases *findProc(Aliases * aliases, Sym * name)
+{
+	Entry *entry;
+
+	entry = lookup(aliases->globalTable, name);
+	if (entry->u.procEntry.procDec == NULL) {
+		return NULL;
+	}
+	return &aliases->procs[entry->u.procEntry.number];
+}
+
+static int paramIndex(ParamAliases * info, Sym * name)
+{
+	Absyn *params;
+	int i;
+
+	params = ABSYN(info->procDec->u.procDec.params);
+	for (i = 0; i < params->u.decList.count; i++) {
+		if (ABSYN(params->u.decList.items[i])->u.parDec.name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* the variable an actual parameter is part of */
+static Sym *rootOf(Absyn * var)
+{
+	while (var->type == ABSYN_ARRAYVAR) {
+		var = ABSYN(var->u.arrayVar.var);
+	}
+	return var->u.simpleVar.name;
+}
+
+static boolean argsMayAlias(ParamAliases * caller, Absyn * x, Absyn * y)
+{
+	Sym *rx, *ry;
+	int px, py;
+
+	rx = rootOf(x);
+	ry = rootOf(y);
+	if (rx == ry) {
+		/* elements of the same array are not told apart */
+		return TRUE;
+	}
+	px = paramIndex(caller, rx);
+	py = paramIndex(caller, ry);
+	if (px < 0 || py < 0 || !caller->isRef[px] || !caller->isRef[py]) {
+		return FALSE;
+	}
+	return caller->mayAlias[px * caller->numParams + py];
+}
+
+/* record the pairs of overlapping ref arguments of a call */
+static boolean visitCall(Aliases * aliases, ParamAliases * caller,
+			 Absyn * node)
+{
+	ParamAliases *callee;
+	Absyn *args, *x, *y;
+	boolean changed;
+	int i, j, n;
+
+	callee = findProc(aliases, node->u.callStm.name);
+	if (callee == NULL) {
+		/* predefined procedures keep no addresses */
+		return FALSE;
+	}
+	changed = FALSE;
+	n = callee->numParams;
+	args = ABSYN(node->u.callStm.args);
+	for (i = 0; i < args->u.expList.count; i++) {
+		if (!callee->isRef[i]) {
+			continue;
+		}
+		x = ABSYN(args->u.expList.items[i]);
+		for (j = i + 1; j < args->u.expList.count; j++) {
+			y = ABSYN(args->u.expList.items[j]);
+			if (callee->isRef[j] && !callee->mayAlias[i * n + j] &&
+			    argsMayAlias(caller, ABSYN(x->u.varExp.var),
+					 ABSYN(y->u.varExp.var))) {
+				callee->mayAlias[i * n + j] = TRUE;
+				callee->mayAlias[j * n + i] = TRUE;
+				changed = TRUE;
+			}
+		}
+	}
+	return changed;
+}
+
+static boolean visitStm(Aliases * aliases, ParamAliases * caller,
+			Absyn * node)
+{
+	boolean changed;
+	int i;
+
+	changed = FALSE;
+	switch (node->type) {
+	case ABSYN_COMPSTM:
+		return visitStm(aliases, caller, ABSYN(node->u.compStm.stms));
+	case ABSYN_STMLIST:
+		for (i = 0; i < node->u.stmList.count; i++) {
+			changed |= visitStm(aliases, caller,
+					    ABSYN(node->u.stmList.items[i]));
+		}
+		break;
+	case ABSYN_IFSTM:
+		changed = visitStm(aliases, caller, ABSYN(node->u.ifStm.thenPart));
+		changed |= visitStm(aliases, caller, ABSYN(node->u.ifStm.elsePart));
+		break;
+	case ABSYN_WHILESTM:
+		return visitStm(aliases, caller, ABSYN(node->u.whileStm.body));
+	case ABSYN_CALLSTM:
+		return visitCall(aliases, caller, node);
+	}
+	return changed;
+}
+
+static void initProc(ParamAliases * info)
+{
+	ParamTypes *types;
+	int i, n;
+
+	n = ABSYN(info->procDec->u.procDec.params)->u.decList.count;
+	info->numParams = n;
+	info->isRef = (boolean *) allocateIn(ARENA_VARALLOC,
+					     (n + 1) * sizeof(boolean));
+	info->mayAlias = (boolean *) allocateIn(ARENA_VARALLOC,
+						(n * n + 1) * sizeof(boolean));
+	memset(info->mayAlias, 0, (n * n + 1) * sizeof(boolean));
+	i = 0;
+	for (types = info->entry->u.procEntry.paramTypes; !types->isEmpty;
+	     types = types->next) {
+		info->isRef[i++] = types->isRef;
+	}
+}
+
+/**
+ * @brief Find the pairs of ref parameters that may alias, from the
+ * arguments of all calls in the program
+ *
+ * @param program abstract syntax
+ * @param globalTable symbol table
+ * @return Aliases* - the relation, valid until variable allocation is
+ * released
+ **/
+Aliases *newAliases(Absyn * program, Table * globalTable)
+{
+	Aliases *aliases;
+	ParamAliases *info;
+	Entry *entry;
+	Absyn *node;
+	boolean changed;
+	int n, i;
+
+	aliases = (Aliases *) allocateIn(ARENA_VARALLOC, sizeof(Aliases));
+	aliases->globalTable = globalTable;
+	n = program->u.decList.count;
+	aliases->procs = (ParamAliases *) allocateIn(ARENA_VARALLOC,
+						     (n + 1) * sizeof(ParamAliases));
+	memset(aliases->procs, 0, (n + 1) * sizeof(ParamAliases));
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		if (node->type == ABSYN_PROCDEC) {
+			entry = lookup(globalTable, node->u.procDec.name);
+			info = &aliases->procs[entry->u.procEntry.number];
+			info->procDec = node;
+			info->entry = entry;
+			initProc(info);
+		}
+	}
+	do {
+		changed = FALSE;
+		for (i = 0; i < program->u.decList.count; i++) {
+			node = ABSYN(program->u.decList.items[i]);
+			if (node->type == ABSYN_PROCDEC) {
+				info = findProc(aliases, node->u.procDec.name);
+				changed |= visitStm(aliases, info,
+						    ABSYN(node->u.procDec.body));
+			}
+		}
+	} while (changed);
+	return aliases;
+}
+
+/**
+ * @brief Whether a ref parameter is the only way to its variable while
+ * the procedure runs
+ *
+ * @param aliases relation
+ * @param name procedure
+ * @param param index of the parameter
+ * @return boolean - TRUE if no other ref parameter may alias it
+ **/
+boolean isUnaliased(Aliases * aliases, Sym * name, int param)
+{
+	ParamAliases *info;
+	int j;
+
+	info = findProc(aliases, name);
+	if (info == NULL || !info->isRef[param]) {
+		return FALSE;
+	}
+	for (j = 0; j < info->numParams; j++) {
+		if (info->mayAlias[param * info->numParams + j]) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
@@ -0,0 +1,24 @@
+/*
+ * alias.h -- aliasing of ref parameters
+ */
+
+#ifndef _ALIAS_H_
+#define _ALIAS_H_
+
+typedef struct {
+	Absyn *procDec;
+	Entry *entry;
+	int numParams;
+	boolean *isRef;		/* kind of each parameter */
+	boolean *mayAlias;	/* numParams x numParams, ref parameter pairs */
+} ParamAliases;
+
+typedef struct {
+	Table *globalTable;
+	ParamAliases *procs;	/* by the number of the procedure */
+} Aliases;
+
+Aliases *newAliases(Absyn * program, Table * globalTable);
+boolean isUnaliased(Aliases * aliases, Sym * name, int param);
+
+#endif				/* _ALIAS_H_ */
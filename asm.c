@@ -0,0 +1,301 @@
+/*
+ * asm.c -- ECO32 assembly records and buffered writer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "asm.h"
+
+/*
+ * The code generator collects the instructions of a procedure as
+ * records and writes them in one go. Text is formatted by hand into a
+ * large buffer that goes to the output file with fwrite, so no format
+ * string is parsed per instruction.
+ */
+
+#define INITIAL_RECORDS	256	/* records of a procedure, doubled as needed */
+#define MAX_LINE_FIXED	80	/* line length without symbol and comment */
+
+static char *opNames[NUM_ASM_OPS] = {
+	NULL, NULL, "add", "sub", "mul", "div", "sll", "or", "ldhi",
+	"ldw", "stw", "beq", "bne", "blt", "ble", "bgt", "bge", "bgeu",
+	"j", "jal", "jr",
+};
+
+void initAsmCode(AsmCode * code)
+{
+	code->instrs = NULL;
+	code->count = 0;
+	code->max = 0;
+}
+
+/**
+ * @brief Append an instruction record in the current arena
+ *
+ * @param code instructions of a procedure
+ * @param op ASM_xxx operation
+ * @return AsmInstr* - the record, valid until the next append
+ **/
+AsmInstr *appendAsm(AsmCode * code, int op)
+{
+	AsmInstr *instrs, *instr;
+
+	if (code->count == code->max) {
+		code->max = code->max == 0 ? INITIAL_RECORDS : 2 * code->max;
+		instrs = (AsmInstr *) allocate(code->max * sizeof(AsmInstr));
+		if (code->count != 0) {
+			memcpy(instrs, code->instrs, code->count * sizeof(AsmInstr));
+		}
+		code->instrs = instrs;
+	}
+	instr = &code->instrs[code->count++];
+	memset(instr, 0, sizeof(AsmInstr));
+	instr->op = op;
+	instr->label = ASM_NO_LABEL;
+	return instr;
+}
+
+/**************************************************************/
+
+void initAsmWriter(AsmWriter * writer, FILE * outFile)
+{
+	writer->outFile = outFile;
+	writer->buffer = (char *) malloc(ASM_BUFFER_SIZE);
+	if (writer->buffer == NULL) {
+		error("out of memory");
+	}
+	writer->used = 0;
+	writer->labelBase = 0;
+}
+
+static void flush(AsmWriter * writer)
+{
+	if (writer->used != 0 &&
+	    fwrite(writer->buffer, 1, writer->used, writer->outFile) !=
+	    (size_t) writer->used) {
+		error("cannot write assembly");
+	}
+	writer->used = 0;
+}
+
+/* make room for n more bytes */
+static void reserve(AsmWriter * writer, int n)
+{
+	if (writer->used + n > ASM_BUFFER_SIZE) {
+		flush(writer);
+	}
+}
+
+static void putChar(AsmWriter * writer, char c)
+{
+	writer->buffer[writer->used++] = c;
+}
+
+static void putString(AsmWriter * writer, char *s)
+{
+	while (*s != '\0') {
+		writer->buffer[writer->used++] = *s++;
+	}
+}
+
+static void putInt(AsmWriter * writer, int value)
+{
+	char digits[12];
+	unsigned u;
+	int n;
+
+	u = value < 0 ? 0u - (unsigned) value : (unsigned) value;
+	n = 0;
+	do {
+		digits[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u != 0);
+	if (value < 0) {
+		putChar(writer, '-');
+	}
+	while (n > 0) {
+		putChar(writer, digits[--n]);
+	}
+}
+
+/* 0x followed by exactly n upper case hex digits */
+static void putHex(AsmWriter * writer, unsigned value, int n)
+{
+	putChar(writer, '0');
+	putChar(writer, 'x');
+	while (n-- > 0) {
+		putChar(writer, "0123456789ABCDEF"[(value >> (4 * n)) & 0xF]);
+	}
+}
+
+static void putReg(AsmWriter * writer, int reg)
+{
+	putChar(writer, '$');
+	putInt(writer, reg);
+}
+
+static void putLabel(AsmWriter * writer, int label)
+{
+	putChar(writer, 'L');
+	putInt(writer, writer->labelBase + label);
+}
+
+/**
+ * @brief Write a string that may be longer than the buffer
+ *
+ * @param writer output
+ * @param s text
+ * @return void
+ **/
+void writeAsmString(AsmWriter * writer, char *s)
+{
+	int n;
+
+	n = strlen(s);
+	if (n > ASM_BUFFER_SIZE) {
+		flush(writer);
+		if (fwrite(s, 1, n, writer->outFile) != (size_t) n) {
+			error("cannot write assembly");
+		}
+		return;
+	}
+	reserve(writer, n);
+	memcpy(writer->buffer + writer->used, s, n);
+	writer->used += n;
+}
+
+static void writeInstr(AsmWriter * writer, AsmInstr * instr)
+{
+	int operands;
+
+	switch (instr->op) {
+	case ASM_LABEL:
+		reserve(writer, MAX_LINE_FIXED);
+		putLabel(writer, instr->label);
+		putString(writer, ":\n");
+		return;
+	case ASM_PROC:
+		writeAsmString(writer, "\n\t.export ");
+		writeAsmString(writer, symToString(instr->sym));
+		writeAsmString(writer, "\n");
+		writeAsmString(writer, symToString(instr->sym));
+		writeAsmString(writer, ":\n");
+		return;
+	}
+	if (instr->sym != NULL) {
+		/* the name goes through the long string path */
+		reserve(writer, MAX_LINE_FIXED);
+		putChar(writer, '\t');
+		putString(writer, opNames[instr->op]);
+		putChar(writer, '\t');
+		if (instr->op != ASM_JAL) {
+			putReg(writer, instr->src1);
+			putChar(writer, ',');
+			putReg(writer, instr->src2);
+			putChar(writer, ',');
+		}
+		writeAsmString(writer, symToString(instr->sym));
+		writeAsmString(writer, "\n");
+		return;
+	}
+	reserve(writer, MAX_LINE_FIXED +
+		(instr->comment == NULL ? 0 : strlen(instr->comment)));
+	putChar(writer, '\t');
+	putString(writer, opNames[instr->op]);
+	putChar(writer, '\t');
+	operands = writer->used;
+	switch (instr->op) {
+	case ASM_ADD:
+	case ASM_SUB:
+	case ASM_MUL:
+	case ASM_DIV:
+	case ASM_SLL:
+	case ASM_OR:
+		putReg(writer, instr->dst);
+		putChar(writer, ',');
+		putReg(writer, instr->src1);
+		putChar(writer, ',');
+		if (instr->src2 != ASM_IMM) {
+			putReg(writer, instr->src2);
+		} else if (instr->op == ASM_OR) {
+			putHex(writer, (unsigned) instr->imm, 4);
+		} else {
+			putInt(writer, instr->imm);
+		}
+		break;
+	case ASM_LDHI:
+		putReg(writer, instr->dst);
+		putChar(writer, ',');
+		putHex(writer, (unsigned) instr->imm, 8);
+		break;
+	case ASM_LDW:
+		putReg(writer, instr->dst);
+		putChar(writer, ',');
+		putReg(writer, instr->src1);
+		putChar(writer, ',');
+		putInt(writer, instr->imm);
+		break;
+	case ASM_STW:
+		putReg(writer, instr->src2);
+		putChar(writer, ',');
+		putReg(writer, instr->src1);
+		putChar(writer, ',');
+		putInt(writer, instr->imm);
+		break;
+	case ASM_BEQ:
+	case ASM_BNE:
+	case ASM_BLT:
+	case ASM_BLE:
+	case ASM_BGT:
+	case ASM_BGE:
+	case ASM_BGEU:
+		putReg(writer, instr->src1);
+		putChar(writer, ',');
+		putReg(writer, instr->src2);
+		putChar(writer, ',');
+		putLabel(writer, instr->label);
+		break;
+	case ASM_J:
+		putLabel(writer, instr->label);
+		break;
+	case ASM_JR:
+		putReg(writer, instr->src1);
+		break;
+	default:
+		error("unknown instruction %d in writeInstr", instr->op);
+	}
+	if (instr->comment != NULL) {
+		/* comments line up as long as operands are shorter than 16 */
+		putString(writer, writer->used - operands < 8 ? "\t\t\t; " : "\t\t; ");
+		putString(writer, instr->comment);
+	}
+	putChar(writer, '\n');
+}
+
+/**
+ * @brief Format all records of a procedure into the output buffer
+ *
+ * @param writer output
+ * @param code instruction records
+ * @return void
+ **/
+void writeAsmCode(AsmWriter * writer, AsmCode * code)
+{
+	int i;
+
+	for (i = 0; i < code->count; i++) {
+		writeInstr(writer, &code->instrs[i]);
+	}
+}
+
+void closeAsmWriter(AsmWriter * writer)
+{
+	flush(writer);
+	free(writer->buffer);
+	writer->buffer = NULL;
+}
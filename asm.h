@@ -0,0 +1,68 @@
+/*
+ * asm.h -- ECO32 assembly records and buffered writer
+ */
+
+#ifndef _ASM_H_
+#define _ASM_H_
+
+#define ASM_LABEL	0	/* L<label>: */
+#define ASM_PROC	1	/* .export and entry label of sym */
+#define ASM_ADD		2	/* dst, src1, src2 or imm */
+#define ASM_SUB		3
+#define ASM_MUL		4
+#define ASM_DIV		5
+#define ASM_SLL		6
+#define ASM_OR		7	/* immediate written in hex */
+#define ASM_LDHI	8	/* dst, imm */
+#define ASM_LDW		9	/* dst, src1 = base, imm = offset */
+#define ASM_STW		10	/* src2 = value, src1 = base, imm = offset */
+#define ASM_BEQ		11	/* src1, src2, label or sym */
+#define ASM_BNE		12
+#define ASM_BLT		13
+#define ASM_BLE		14
+#define ASM_BGT		15
+#define ASM_BGE		16
+#define ASM_BGEU	17
+#define ASM_J		18	/* label */
+#define ASM_JAL		19	/* sym */
+#define ASM_JR		20	/* src1 */
+#define NUM_ASM_OPS	21
+
+#define ASM_IMM		(-1)	/* src2 of an instruction with immediate */
+#define ASM_NO_LABEL	(-1)
+
+#define ASM_BUFFER_SIZE	(64 * 1024)	/* bytes of output buffer */
+
+typedef struct {
+	int op;
+	int dst;
+	int src1;
+	int src2;
+	int imm;
+	int label;		/* branch target or label defined */
+	Sym *sym;		/* called procedure, export or branch target */
+	char *comment;		/* NULL if none */
+} AsmInstr;
+
+typedef struct {
+	AsmInstr *instrs;
+	int count;
+	int max;
+} AsmCode;
+
+typedef struct {
+	FILE *outFile;
+	char *buffer;
+	int used;
+	int labelBase;		/* added to the label numbers of a procedure */
+} AsmWriter;
+
+void initAsmCode(AsmCode * code);
+AsmInstr *appendAsm(AsmCode * code, int op);
+
+void initAsmWriter(AsmWriter * writer, FILE * outFile);
+void writeAsmString(AsmWriter * writer, char *s);
+void writeAsmCode(AsmWriter * writer, AsmCode * code);
+void closeAsmWriter(AsmWriter * writer);
+
+#endif				/* _ASM_H_ */
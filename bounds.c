@@ -0,0 +1,458 @@
+/*
+ * bounds.c -- elimination of array bounds checks
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "inliner.h"
+#include "alias.h"
+#include "ir.h"
+#include "bounds.h"
+
+/*
+ * Forward range analysis over the control flow graph. Every variable
+ * held in a virtual register gets an interval of possible values at
+ * the start of each block. Temporaries never live across blocks, they
+ * are only tracked inside a block. Branches narrow the ranges of their
+ * operands along each edge, so in
+ *
+ *     i := 0; while (i < 8) { row[i] := 0; i := i + 1; }
+ *
+ * i lies in [0, 7] in the loop body and the check of row[i] can go.
+ * Ranges that still grow in a loop are widened to the limits of int,
+ * which makes the analysis terminate.
+ */
+
+typedef struct {
+	int lo;
+	int hi;
+} Range;
+
+typedef struct {
+	boolean reached;	/* some path leads here */
+	Range *vars;		/* range of every variable at block entry */
+} BlockState;
+
+typedef struct {
+	IrProc *proc;
+	int numVars;
+	int *vars;		/* vregs of the variables */
+	BlockState *states;	/* indexed by block id */
+	Range *ranges;		/* current ranges of all vregs */
+	int *stamps;		/* ranges[v] is valid if stamps[v] == stamp */
+	int stamp;
+} Analysis;
+
+static Range fullRange(void)
+{
+	Range r;
+
+	r.lo = INT_MIN;
+	r.hi = INT_MAX;
+	return r;
+}
+
+static Range makeRange(long long lo, long long hi)
+{
+	Range r;
+
+	if (lo < INT_MIN || hi > INT_MAX) {
+		/* the result may wrap around */
+		return fullRange();
+	}
+	r.lo = (int) lo;
+	r.hi = (int) hi;
+	return r;
+}
+
+static long long min4(long long a, long long b, long long c, long long d)
+{
+	long long m;
+
+	m = a < b ? a : b;
+	m = m < c ? m : c;
+	return m < d ? m : d;
+}
+
+static long long max4(long long a, long long b, long long c, long long d)
+{
+	long long m;
+
+	m = a > b ? a : b;
+	m = m > c ? m : c;
+	return m > d ? m : d;
+}
+
+/**************************************************************/
+
+static Range getRange(Analysis * a, int vreg)
+{
+	Range r;
+
+	if (vreg == VREG_ZERO) {
+		r.lo = 0;
+		r.hi = 0;
+		return r;
+	}
+	if (vreg < VREG_FIRST || a->stamps[vreg] != a->stamp) {
+		return fullRange();
+	}
+	return a->ranges[vreg];
+}
+
+static void setRange(Analysis * a, int vreg, Range r)
+{
+	a->ranges[vreg] = r;
+	a->stamps[vreg] = a->stamp;
+}
+
+static Range operand2(Analysis * a, Instr * instr)
+{
+	if (instr->src2 == VREG_NONE) {
+		return makeRange(instr->imm, instr->imm);
+	}
+	return getRange(a, instr->src2);
+}
+
+/**
+ * @brief Range of the result of an arithmetic instruction
+ *
+ * @param a analysis
+ * @param instr IR_ADD, IR_SUB, IR_MUL, IR_DIV or IR_SLL
+ * @return Range - the interval, full if the result may overflow
+ **/
+static Range arithRange(Analysis * a, Instr * instr)
+{
+	Range x, y;
+	long long p, q, r, s;
+
+	x = getRange(a, instr->src1);
+	y = operand2(a, instr);
+	switch (instr->op) {
+	case IR_ADD:
+		return makeRange((long long) x.lo + y.lo, (long long) x.hi + y.hi);
+	case IR_SUB:
+		return makeRange((long long) x.lo - y.hi, (long long) x.hi - y.lo);
+	case IR_MUL:
+		p = (long long) x.lo * y.lo;
+		q = (long long) x.lo * y.hi;
+		r = (long long) x.hi * y.lo;
+		s = (long long) x.hi * y.hi;
+		return makeRange(min4(p, q, r, s), max4(p, q, r, s));
+	case IR_DIV:
+		if (y.lo == y.hi && y.lo > 0) {
+			/* truncating division by a positive constant is monotone */
+			return makeRange(x.lo / y.lo, x.hi / y.lo);
+		}
+		break;
+	case IR_SLL:
+		if (y.lo == y.hi && y.lo >= 0 && y.lo < 31) {
+			return makeRange((long long) x.lo << y.lo,
+					 (long long) x.hi << y.lo);
+		}
+		break;
+	}
+	return fullRange();
+}
+
+/**
+ * @brief Apply one instruction to the current ranges
+ *
+ * @param a analysis
+ * @param instr instruction
+ * @return boolean - TRUE if instr is a check that cannot fail
+ **/
+static boolean transfer(Analysis * a, Instr * instr)
+{
+	Range r;
+	boolean redundant;
+
+	switch (instr->op) {
+	case IR_LDC:
+		setRange(a, instr->dst, makeRange(instr->imm, instr->imm));
+		break;
+	case IR_MOV:
+		setRange(a, instr->dst, getRange(a, instr->src1));
+		break;
+	case IR_ADD:
+	case IR_SUB:
+	case IR_MUL:
+	case IR_DIV:
+	case IR_SLL:
+		setRange(a, instr->dst, arithRange(a, instr));
+		break;
+	case IR_LDW:
+		setRange(a, instr->dst, fullRange());
+		break;
+	case IR_CHK:
+		r = getRange(a, instr->src1);
+		redundant = r.lo >= 0 && r.hi < instr->imm;
+		/* past the check the index is known to be in range */
+		if (r.lo < 0 || r.lo >= instr->imm) {
+			r.lo = 0;
+		}
+		if (r.hi >= instr->imm || r.hi < 0) {
+			r.hi = instr->imm - 1;
+		}
+		if (instr->src1 >= VREG_FIRST) {
+			setRange(a, instr->src1, r);
+		}
+		return redundant;
+	}
+	return FALSE;
+}
+
+/**************************************************************/
+
+/* narrow x and y so that "x cond y" holds; FALSE if it cannot */
+static boolean narrow(int cond, Range * x, Range * y)
+{
+	switch (cond) {
+	case ABSYN_OP_EQU:
+		x->lo = y->lo = x->lo > y->lo ? x->lo : y->lo;
+		x->hi = y->hi = x->hi < y->hi ? x->hi : y->hi;
+		break;
+	case ABSYN_OP_NEQ:
+		if (x->lo == x->hi && y->lo == y->hi && x->lo == y->lo) {
+			return FALSE;
+		}
+		break;
+	case ABSYN_OP_LST:
+		if (y->hi == INT_MIN || x->lo == INT_MAX) {
+			return FALSE;
+		}
+		if (x->hi > y->hi - 1) {
+			x->hi = y->hi - 1;
+		}
+		if (y->lo < x->lo + 1) {
+			y->lo = x->lo + 1;
+		}
+		break;
+	case ABSYN_OP_LSE:
+		if (x->hi > y->hi) {
+			x->hi = y->hi;
+		}
+		if (y->lo < x->lo) {
+			y->lo = x->lo;
+		}
+		break;
+	case ABSYN_OP_GRT:
+		return narrow(ABSYN_OP_LST, y, x);
+	case ABSYN_OP_GRE:
+		return narrow(ABSYN_OP_LSE, y, x);
+	}
+	return x->lo <= x->hi && y->lo <= y->hi;
+}
+
+static int negate(int cond)
+{
+	switch (cond) {
+	case ABSYN_OP_EQU:	return ABSYN_OP_NEQ;
+	case ABSYN_OP_NEQ:	return ABSYN_OP_EQU;
+	case ABSYN_OP_LST:	return ABSYN_OP_GRE;
+	case ABSYN_OP_LSE:	return ABSYN_OP_GRT;
+	case ABSYN_OP_GRT:	return ABSYN_OP_LSE;
+	case ABSYN_OP_GRE:	return ABSYN_OP_LST;
+	}
+	return cond;
+}
+
+/*
+ * Ranges are widened at the blocks that end a loop iteration with a
+ * backward edge. For a loop with the test at the bottom, that is the
+ * block of the test, where the ranges have not been narrowed yet.
+ */
+static boolean endsIteration(Block * block)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (block->succ[i] != NULL && block->succ[i]->id <= block->id) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/**
+ * @brief Merge the current variable ranges into the entry state of
+ * a successor
+ *
+ * @param a analysis
+ * @param succ successor block
+ * @return boolean - TRUE if the entry state changed
+ **/
+static boolean propagate(Analysis * a, Block * succ)
+{
+	BlockState *state;
+	Range r, *old;
+	boolean first, changed, widen;
+	int i;
+
+	state = &a->states[succ->id];
+	first = !state->reached;
+	widen = !first && endsIteration(succ);
+	state->reached = TRUE;
+	changed = first;
+	for (i = 0; i < a->numVars; i++) {
+		r = getRange(a, a->vars[i]);
+		old = &state->vars[i];
+		if (first) {
+			*old = r;
+			continue;
+		}
+		if (r.lo < old->lo) {
+			old->lo = widen ? INT_MIN : r.lo;
+			changed = TRUE;
+		}
+		if (r.hi > old->hi) {
+			old->hi = widen ? INT_MAX : r.hi;
+			changed = TRUE;
+		}
+	}
+	return changed;
+}
+
+static void enterBlock(Analysis * a, Block * block)
+{
+	BlockState *state;
+	int i;
+
+	a->stamp++;
+	state = &a->states[block->id];
+	for (i = 0; i < a->numVars; i++) {
+		setRange(a, a->vars[i], state->vars[i]);
+	}
+}
+
+/* follow one edge of a branch, with the condition holding or not */
+static boolean followBranch(Analysis * a, Block * block, Block * succ,
+			    int cond)
+{
+	Instr *br;
+	Range x, y;
+	boolean changed;
+
+	br = block->last;
+	x = getRange(a, br->src1);
+	y = getRange(a, br->src2);
+	if (!narrow(cond, &x, &y)) {
+		/* the edge is never taken */
+		return FALSE;
+	}
+	if (br->src1 >= VREG_FIRST) {
+		setRange(a, br->src1, x);
+	}
+	if (br->src2 >= VREG_FIRST) {
+		setRange(a, br->src2, y);
+	}
+	changed = propagate(a, succ);
+	/* restore the ranges for the other edge */
+	enterBlock(a, block);
+	for (br = block->first; br != block->last; br = br->next) {
+		transfer(a, br);
+	}
+	return changed;
+}
+
+static boolean analyzeBlock(Analysis * a, Block * block)
+{
+	Instr *instr;
+	boolean changed;
+
+	enterBlock(a, block);
+	for (instr = block->first; instr != NULL; instr = instr->next) {
+		if (instr == block->last && instr->op == IR_BR) {
+			break;
+		}
+		transfer(a, instr);
+		if (instr == block->last) {
+			break;
+		}
+	}
+	if (instr != NULL && instr->op == IR_BR) {
+		changed = followBranch(a, block, block->succ[1], instr->cond);
+		if (block->succ[0] != NULL) {
+			changed |= followBranch(a, block, block->succ[0],
+						negate(instr->cond));
+		}
+		return changed;
+	}
+	return block->succ[0] != NULL && propagate(a, block->succ[0]);
+}
+
+/**
+ * @brief Remove the bounds checks of a procedure that can be shown
+ * never to fail
+ *
+ * @param proc procedure with control flow graph
+ * @return int - number of checks removed
+ **/
+int removeBoundsChecks(IrProc * proc)
+{
+	Analysis a;
+	Block *block;
+	Instr *instr, *next;
+	boolean changed;
+	int i, v, removed;
+
+	memset(&a, 0, sizeof(Analysis));
+	a.proc = proc;
+	a.vars = (int *) allocate(proc->numVregs * sizeof(int));
+	for (v = VREG_FIRST; v < proc->numVregs; v++) {
+		if (proc->vregs[v].name != NULL) {
+			a.vars[a.numVars++] = v;
+		}
+	}
+	if (a.numVars == 0) {
+		/* only temporaries: constant indexes are checked when built */
+		return 0;
+	}
+	a.ranges = (Range *) allocate(proc->numVregs * sizeof(Range));
+	a.stamps = (int *) allocate(proc->numVregs * sizeof(int));
+	memset(a.stamps, 0, proc->numVregs * sizeof(int));
+	a.states = (BlockState *) allocate(proc->numBlocks * sizeof(BlockState));
+	for (i = 0; i < proc->numBlocks; i++) {
+		a.states[i].reached = FALSE;
+		a.states[i].vars = (Range *) allocate(a.numVars * sizeof(Range));
+	}
+	/* parameters and uninitialized locals may hold anything */
+	a.states[0].reached = TRUE;
+	for (i = 0; i < a.numVars; i++) {
+		a.states[0].vars[i] = fullRange();
+	}
+
+	do {
+		changed = FALSE;
+		for (block = proc->blocks; block != NULL; block = block->next) {
+			if (a.states[block->id].reached) {
+				changed |= analyzeBlock(&a, block);
+			}
+		}
+	} while (changed);
+
+	removed = 0;
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		if (!a.states[block->id].reached) {
+			continue;
+		}
+		enterBlock(&a, block);
+		for (instr = block->first; instr != NULL; instr = next) {
+			next = instr == block->last ? NULL : instr->next;
+			if (transfer(&a, instr)) {
+				removeInstr(proc, instr);
+				removed++;
+			}
+		}
+	}
+	return removed;
+}
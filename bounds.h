@@ -0,0 +1,10 @@
+/*
+ * bounds.h -- elimination of array bounds checks
+ */
+
+#ifndef _BOUNDS_H_
+#define _BOUNDS_H_
+
+int removeBoundsChecks(IrProc * proc);
+
+#endif				/* _BOUNDS_H_ */
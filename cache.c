@@ -0,0 +1,504 @@
+/*
+ * cache.c -- cache of translated procedures
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "inliner.h"
+#include "alias.h"
+#include "asm.h"
+#include "cache.h"
+
+/*
+ * The code of a procedure is stored under a hash of everything it is
+ * made from: its abstract syntax after folding, the types of all its
+ * nodes, its frame layout and which of its ref parameters are
+ * unaliased. For every call the hash covers the signature and the
+ * parameter offsets of the callee, which of its ref parameters need an
+ * address, and the whole callee if it is inlined. Line numbers do not
+ * go into the code and are left out, so moving a procedure in the file
+ * keeps its entry. The compiler itself and its options are part of the
+ * hash as well; an entry written by a different build is never used.
+ * An entry holds the instruction records with labels numbered from 0,
+ * the number of labels and the statistics of the procedure.
+ */
+
+#define FNV_OFFSET	14695981039346656037ULL
+#define FNV_PRIME	1099511628211ULL
+
+#define MAX_LINE	256	/* longest comment of an instruction */
+
+/* temporary entry files are numbered, threads may write the same entry */
+static pthread_mutex_t tempLock = PTHREAD_MUTEX_INITIALIZER;
+static int numTemps;
+
+typedef struct {
+	Hash hash;
+	Table *globalTable;
+	Inliner *inliner;
+	Aliases *aliases;
+} Hasher;
+
+static void mixBytes(Hasher * h, void *p, int n)
+{
+	unsigned char *bytes;
+
+	bytes = (unsigned char *) p;
+	while (n-- > 0) {
+		h->hash = (h->hash ^ *bytes++) * FNV_PRIME;
+	}
+}
+
+static void mixInt(Hasher * h, int value)
+{
+	mixBytes(h, &value, sizeof(int));
+}
+
+/* symbol stamps differ from run to run, the strings do not */
+static void mixSym(Hasher * h, Sym * sym)
+{
+	char *s;
+
+	s = symToString(sym);
+	mixBytes(h, s, strlen(s) + 1);
+}
+
+static void mixType(Hasher * h, Type * type)
+{
+	while (type != NULL && type->kind == TYPE_KIND_ARRAY) {
+		mixInt(h, type->u.arrayType.size);
+		type = type->u.arrayType.baseType;
+	}
+	if (type == NULL) {
+		mixInt(h, -1);
+		return;
+	}
+	mixBytes(h, type->u.primitiveType.printName,
+		 strlen(type->u.primitiveType.printName) + 1);
+}
+
+static void mixNode(Hasher * h, Absyn * node);
+
+/* what a call depends on besides its arguments */
+static void mixCallee(Hasher * h, Sym * name)
+{
+	Entry *entry;
+	ParamTypes *types;
+	Absyn *procDec;
+	int i;
+
+	entry = lookup(h->globalTable, name);
+	mixInt(h, entry->u.procEntry.paramSize);
+	i = 0;
+	for (types = entry->u.procEntry.paramTypes; !types->isEmpty;
+	     types = types->next) {
+		mixType(h, types->type);
+		mixInt(h, types->isRef);
+		mixInt(h, types->offset);
+		mixInt(h, types->isRef && refEscapes(h->inliner, name, i));
+		i++;
+	}
+	procDec = inlineCandidate(h->inliner, name);
+	mixInt(h, procDec != NULL);
+	if (procDec != NULL) {
+		/* inlined procedures are not recursive */
+		mixNode(h, procDec);
+	}
+}
+
+static void mixProc(Hasher * h, Absyn * node)
+{
+	Entry *entry;
+	Absyn *params;
+	int i;
+
+	mixSym(h, node->u.procDec.name);
+	entry = lookup(h->globalTable, node->u.procDec.name);
+	mixInt(h, entry->u.procEntry.paramSize);
+	mixInt(h, entry->u.procEntry.argSize);
+	mixInt(h, entry->u.procEntry.localVarSize);
+	mixNode(h, ABSYN(node->u.procDec.params));
+	params = ABSYN(node->u.procDec.params);
+	for (i = 0; i < params->u.decList.count; i++) {
+		mixInt(h, isUnaliased(h->aliases, node->u.procDec.name, i));
+	}
+}
+
+static void mixNode(Hasher * h, Absyn * node)
+{
+	Entry *entry;
+	int i;
+
+	mixInt(h, node->type);
+	mixType(h, node->typeGraph);
+	switch (node->type) {
+	case ABSYN_NAMETY:
+		mixSym(h, node->u.nameTy.name);
+		entry = lookup(h->globalTable, node->u.nameTy.name);
+		mixType(h, entry->u.typeEntry.type);
+		break;
+	case ABSYN_ARRAYTY:
+		mixInt(h, node->u.arrayTy.size);
+		mixNode(h, ABSYN(node->u.arrayTy.ty));
+		break;
+	case ABSYN_PROCDEC:
+		mixProc(h, node);
+		mixNode(h, ABSYN(node->u.procDec.decls));
+		mixNode(h, ABSYN(node->u.procDec.body));
+		break;
+	case ABSYN_PARDEC:
+		mixSym(h, node->u.parDec.name);
+		mixInt(h, node->u.parDec.isRef);
+		mixNode(h, ABSYN(node->u.parDec.ty));
+		break;
+	case ABSYN_VARDEC:
+		mixSym(h, node->u.varDec.name);
+		mixNode(h, ABSYN(node->u.varDec.ty));
+		break;
+	case ABSYN_COMPSTM:
+		mixNode(h, ABSYN(node->u.compStm.stms));
+		break;
+	case ABSYN_ASSIGNSTM:
+		mixNode(h, ABSYN(node->u.assignStm.var));
+		mixNode(h, ABSYN(node->u.assignStm.exp));
+		break;
+	case ABSYN_IFSTM:
+		mixNode(h, ABSYN(node->u.ifStm.test));
+		mixNode(h, ABSYN(node->u.ifStm.thenPart));
+		mixNode(h, ABSYN(node->u.ifStm.elsePart));
+		break;
+	case ABSYN_WHILESTM:
+		mixNode(h, ABSYN(node->u.whileStm.test));
+		mixNode(h, ABSYN(node->u.whileStm.body));
+		break;
+	case ABSYN_CALLSTM:
+		mixSym(h, node->u.callStm.name);
+		mixCallee(h, node->u.callStm.name);
+		mixNode(h, ABSYN(node->u.callStm.args));
+		break;
+	case ABSYN_OPEXP:
+		mixInt(h, node->u.opExp.op);
+		mixNode(h, ABSYN(node->u.opExp.left));
+		mixNode(h, ABSYN(node->u.opExp.right));
+		break;
+	case ABSYN_VAREXP:
+		mixNode(h, ABSYN(node->u.varExp.var));
+		break;
+	case ABSYN_INTEXP:
+		mixInt(h, node->u.intExp.val);
+		break;
+	case ABSYN_SIMPLEVAR:
+		mixSym(h, node->u.simpleVar.name);
+		break;
+	case ABSYN_ARRAYVAR:
+		mixNode(h, ABSYN(node->u.arrayVar.var));
+		mixNode(h, ABSYN(node->u.arrayVar.index));
+		break;
+	case ABSYN_DECLIST:
+		for (i = 0; i < node->u.decList.count; i++) {
+			mixNode(h, ABSYN(node->u.decList.items[i]));
+		}
+		mixInt(h, -1);
+		break;
+	case ABSYN_STMLIST:
+		for (i = 0; i < node->u.stmList.count; i++) {
+			mixNode(h, ABSYN(node->u.stmList.items[i]));
+		}
+		mixInt(h, -1);
+		break;
+	case ABSYN_EXPLIST:
+		for (i = 0; i < node->u.expList.count; i++) {
+			mixNode(h, ABSYN(node->u.expList.items[i]));
+		}
+		mixInt(h, -1);
+		break;
+	}
+}
+
+/**
+ * @brief Open the cache in a directory, which is created if it does
+ * not exist
+ *
+ * @param dir directory
+ * @param inlineThreshold option that changes the code
+ * @return Cache* - the cache, valid until variable allocation is
+ * released
+ **/
+Cache *newCache(char *dir, int inlineThreshold)
+{
+	Cache *cache;
+	Hasher h;
+	struct stat compiler;
+
+	if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+		error("cannot create cache directory '%s'", dir);
+	}
+	cache = (Cache *) allocateIn(ARENA_VARALLOC, sizeof(Cache));
+	cache->dir = dir;
+	h.hash = FNV_OFFSET;
+	mixBytes(&h, CACHE_FORMAT, strlen(CACHE_FORMAT));
+	/* a rebuilt compiler may translate differently */
+	if (stat("/proc/self/exe", &compiler) == 0) {
+		mixBytes(&h, &compiler.st_mtime, sizeof(compiler.st_mtime));
+		mixBytes(&h, &compiler.st_size, sizeof(compiler.st_size));
+	}
+	mixInt(&h, inlineThreshold);
+	cache->base = h.hash;
+	return cache;
+}
+
+/**
+ * @brief Compute the key of a procedure
+ *
+ * @param cache cache
+ * @param procDec procedure, checked, folded and with its variables
+ * allocated
+ * @param globalTable symbol table
+ * @param inliner procedures whose calls are replaced by their body
+ * @param aliases unaliased ref parameters
+ * @return Hash - the key
+ **/
+Hash hashProc(Cache * cache, Absyn * procDec, Table * globalTable,
+	      Inliner * inliner, Aliases * aliases)
+{
+	Hasher h;
+
+	h.hash = cache->base;
+	h.globalTable = globalTable;
+	h.inliner = inliner;
+	h.aliases = aliases;
+	mixNode(&h, procDec);
+	return h.hash;
+}
+
+static void entryPath(Cache * cache, Hash key, char *suffix, char *path,
+		      int size)
+{
+	snprintf(path, size, "%s/%016llx%s", cache->dir, key, suffix);
+}
+
+/* the text of an entry, read at once */
+typedef struct {
+	char *next;
+	char *end;
+} Reader;
+
+static boolean readInt(Reader * r, int *value)
+{
+	char *end;
+	long l;
+
+	while (r->next < r->end && *r->next == ' ') {
+		r->next++;
+	}
+	l = strtol(r->next, &end, 10);
+	if (end == r->next || end > r->end) {
+		return FALSE;
+	}
+	*value = (int) l;
+	r->next = end;
+	return TRUE;
+}
+
+/* the rest of the line, terminated in place */
+static char *readRest(Reader * r)
+{
+	char *start;
+
+	start = r->next;
+	while (r->next < r->end && *r->next != '\n') {
+		r->next++;
+	}
+	if (r->next == r->end) {
+		return NULL;
+	}
+	*r->next++ = '\0';
+	return start;
+}
+
+static boolean readInstr(Reader * r, AsmInstr * instr)
+{
+	char *sym, *comment;
+
+	if (!readInt(r, &instr->op) || !readInt(r, &instr->dst) ||
+	    !readInt(r, &instr->src1) || !readInt(r, &instr->src2) ||
+	    !readInt(r, &instr->imm) || !readInt(r, &instr->label) ||
+	    instr->op < 0 || instr->op >= NUM_ASM_OPS ||
+	    r->next == r->end || *r->next++ != ' ') {
+		return FALSE;
+	}
+	sym = r->next;
+	while (r->next < r->end && *r->next != ' ' && *r->next != '\n') {
+		r->next++;
+	}
+	if (r->next == r->end) {
+		return FALSE;
+	}
+	if (*r->next == '\n') {
+		comment = NULL;
+		*r->next++ = '\0';
+	} else {
+		*r->next++ = '\0';
+		comment = readRest(r);
+		if (comment == NULL) {
+			return FALSE;
+		}
+	}
+	instr->sym = strcmp(sym, "-") == 0 ? NULL : newSym(sym);
+	/* the comments are few and outlive the code as symbols */
+	instr->comment = comment == NULL ? NULL : symToString(newSym(comment));
+	return TRUE;
+}
+
+static boolean readEntry(Reader * r, Sym * name, AsmCode * code,
+			 int *numLabels, int *counts, int *numCounts)
+{
+	char *line;
+	int n, i;
+
+	line = readRest(r);
+	if (line == NULL || strncmp(line, CACHE_FORMAT " ",
+				    strlen(CACHE_FORMAT) + 1) != 0 ||
+	    strcmp(line + strlen(CACHE_FORMAT) + 1, symToString(name)) != 0 ||
+	    !readInt(r, numLabels) || !readInt(r, &n) || n != *numCounts) {
+		return FALSE;
+	}
+	for (i = 0; i < n; i++) {
+		if (!readInt(r, &counts[i])) {
+			return FALSE;
+		}
+	}
+	if (!readInt(r, &n) || n < 0 || readRest(r) == NULL) {
+		return FALSE;
+	}
+	code->instrs = (AsmInstr *) malloc((n + 1) * sizeof(AsmInstr));
+	if (code->instrs == NULL) {
+		error("out of memory");
+	}
+	code->count = n;
+	code->max = n;
+	for (i = 0; i < n; i++) {
+		if (!readInstr(r, &code->instrs[i])) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * @brief Look up the code of a procedure
+ *
+ * @param cache cache
+ * @param key hash of the procedure
+ * @param name procedure
+ * @param code filled with the instructions, malloc'ed, if found
+ * @param numLabels filled with the number of labels
+ * @param counts filled with the statistics
+ * @param numCounts number of statistics
+ * @return boolean - TRUE if the entry was found
+ **/
+boolean readCachedProc(Cache * cache, Hash key, Sym * name, AsmCode * code,
+		       int *numLabels, int *counts, int numCounts)
+{
+	char path[FILENAME_MAX];
+	FILE *file;
+	struct stat info;
+	Reader r;
+	char *text;
+	boolean found;
+
+	entryPath(cache, key, ".proc", path, sizeof(path));
+	file = fopen(path, "r");
+	if (file == NULL) {
+		return FALSE;
+	}
+	if (fstat(fileno(file), &info) != 0) {
+		fclose(file);
+		return FALSE;
+	}
+	text = (char *) malloc(info.st_size + 1);
+	if (text == NULL) {
+		error("out of memory");
+	}
+	r.next = text;
+	r.end = text + fread(text, 1, info.st_size, file);
+	*r.end = '\0';
+	fclose(file);
+	code->instrs = NULL;
+	found = readEntry(&r, name, code, numLabels, counts, &numCounts);
+	free(text);
+	if (!found) {
+		/* damaged, compile again and replace it */
+		free(code->instrs);
+		code->instrs = NULL;
+	}
+	return found;
+}
+
+/**
+ * @brief Store the code of a procedure; the entry appears at once
+ * or not at all, so compilers sharing the directory never read half
+ * of one
+ *
+ * @param cache cache
+ * @param key hash of the procedure
+ * @param name procedure
+ * @param code instructions, labels numbered from 0
+ * @param numLabels number of labels
+ * @param counts statistics
+ * @param numCounts number of statistics
+ * @return void
+ **/
+void writeCachedProc(Cache * cache, Hash key, Sym * name, AsmCode * code,
+		     int numLabels, int *counts, int numCounts)
+{
+	char path[FILENAME_MAX];
+	char temp[FILENAME_MAX];
+	char suffix[32];
+	FILE *file;
+	AsmInstr *instr;
+	int i, n;
+
+	pthread_mutex_lock(&tempLock);
+	n = numTemps++;
+	pthread_mutex_unlock(&tempLock);
+	snprintf(suffix, sizeof(suffix), ".%d.%d.tmp", (int) getpid(), n);
+	entryPath(cache, key, suffix, temp, sizeof(temp));
+	entryPath(cache, key, ".proc", path, sizeof(path));
+	file = fopen(temp, "w");
+	if (file == NULL) {
+		/* the cache only saves time, compiling goes on without it */
+		return;
+	}
+	fprintf(file, "%s %s\n", CACHE_FORMAT, symToString(name));
+	fprintf(file, "%d %d", numLabels, numCounts);
+	for (i = 0; i < numCounts; i++) {
+		fprintf(file, " %d", counts[i]);
+	}
+	fprintf(file, "\n%d\n", code->count);
+	for (i = 0; i < code->count; i++) {
+		instr = &code->instrs[i];
+		fprintf(file, "%d %d %d %d %d %d %s", instr->op, instr->dst,
+			instr->src1, instr->src2, instr->imm, instr->label,
+			instr->sym == NULL ? "-" : symToString(instr->sym));
+		if (instr->comment != NULL) {
+			fprintf(file, " %s", instr->comment);
+		}
+		fprintf(file, "\n");
+	}
+	if (fclose(file) != 0 || rename(temp, path) != 0) {
+		remove(temp);
+	}
+}
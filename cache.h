@@ -0,0 +1,25 @@
+/*
+ * cache.h -- cache of translated procedures
+ */
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#define CACHE_FORMAT	"spl-cache 1"	/* first line of every entry */
+
+typedef unsigned long long Hash;
+
+typedef struct {
+	char *dir;		/* one file per entry */
+	Hash base;		/* compiler and options */
+} Cache;
+
+Cache *newCache(char *dir, int inlineThreshold);
+Hash hashProc(Cache * cache, Absyn * procDec, Table * globalTable,
+	      Inliner * inliner, Aliases * aliases);
+boolean readCachedProc(Cache * cache, Hash key, Sym * name, AsmCode * code,
+		       int *numLabels, int *counts, int numCounts);
+void writeCachedProc(Cache * cache, Hash key, Sym * name, AsmCode * code,
+		     int numLabels, int *counts, int numCounts);
+
+#endif				/* _CACHE_H_ */
@@ -13,425 +13,795 @@
 #include "absyn.h"
 #include "table.h"
 #include "varalloc.h"
+#include "inliner.h"
+#include "alias.h"
+#include "ir.h"
+#include "bounds.h"
+#include "cse.h"
+#include "loop.h"
+#include "regalloc.h"
+#include "asm.h"
+#include "peephole.h"
+#include "cache.h"
 #include "codegen.h"
+#include "pool.h"
+
+#define FITS_IMM(i)	((i) >= -32768 && (i) <= 32767)
+
+typedef struct {
+	AsmCode code;		/* instructions of the current procedure */
+	IrProc *proc;
+	int spillBase;		/* offset of the spill area from sp */
+	boolean leaf;		/* no calls, fp is not set up */
+	int frameSize;		/* fp - sp */
+	Sym *indexError;	/* runtime procedure called by bounds checks */
+} Emitter;
+
+typedef struct procStats {
+	Sym *name;
+	int instrsSaved;	/* by the peephole optimization */
+	struct procStats *next;
+} ProcStats;
+
+typedef struct {
+	int checks;		/* bounds checks generated */
+	int checksRemoved;	/* bounds checks shown to be redundant */
+	int callsInlined;
+	int tailCalls;
+	int commonSubexprs;	/* instructions reusing an earlier value */
+	int hoisted;		/* loop invariants */
+	int reduced;		/* array accesses through induction pointers */
+	int instrsSaved;
+	ProcStats *procs;	/* in the order of the program */
+	ProcStats **lastProc;
+} Stats;
+
+#define NUM_COUNTS	8	/* counters of Stats kept in the cache */
+
+typedef struct {
+	Absyn *procDec;
+	AsmCode code;		/* optimized instructions, malloc'ed */
+	int numLabels;		/* labels are numbered from 0 in code */
+	Stats stats;		/* of this procedure alone */
+} Job;
 
-int temp, nextReg, backupReg;
-boolean verbose = FALSE;
+/*
+ * Once variables are allocated the procedures are independent of each
+ * other: the global table, the inliner and the aliases are only read.
+ * Every procedure is a job of a pool. Workers take the next job that
+ * is not yet taken, so a thread that is done with a small procedure
+ * moves on to the next one while others are busy with big ones. The
+ * code of a job is written in the order of the program as soon as all
+ * jobs before it are done, and labels are numbered only then, so that
+ * the output does not depend on the number of threads.
+ */
+typedef struct {
+	Absyn *program;		/* selected by the workers */
+	Table *globalTable;
+	Inliner *inliner;
+	Aliases *aliases;
+	CodegenOptions *options;
+	Cache *cache;		/* NULL if code is not cached */
+	Sym *indexError;
+	Job *jobs;		/* in the order of the program */
+	int numJobs;
+} Compiler;
 
 /**
  * @brief Write assembler header impor instructions and default code alignment
  *
- * @param outFile assembly
+ * @param writer assembly
  * @return void
  **/
-void assemblerProlog(FILE * outFile)
+static void assemblerProlog(AsmWriter * writer)
+{
+	writeAsmString(writer,
+		       "\t.import\tprinti\n"
+		       "\t.import\tprintc\n"
+		       "\t.import\treadi\n"
+		       "\t.import\treadc\n"
+		       "\t.import\texit\n"
+		       "\t.import\ttime\n"
+		       "\t.import\tclearAll\n"
+		       "\t.import\tsetPixel\n"
+		       "\t.import\tdrawLine\n"
+		       "\t.import\tdrawCircle\n"
+		       "\t.import\t_indexError\n"
+		       "\n"
+		       "\t.code\n"
+		       "\t.align\t4\n");
+}
+
+static AsmInstr *emitAsm(Emitter * e, int op, int dst, int src1, int src2)
+{
+	AsmInstr *instr;
+
+	instr = appendAsm(&e->code, op);
+	instr->dst = dst;
+	instr->src1 = src1;
+	instr->src2 = src2;
+	return instr;
+}
+
+/* "op dst,src1,imm" */
+static AsmInstr *emitImm(Emitter * e, int op, int dst, int src1, int imm)
+{
+	AsmInstr *instr;
+
+	instr = emitAsm(e, op, dst, src1, ASM_IMM);
+	instr->imm = imm;
+	return instr;
+}
+
+static void emitLabel(Emitter * e, int op, int label)
 {
-	fprintf(outFile, "\t.import\tprinti\n");
-	fprintf(outFile, "\t.import\tprintc\n");
-	fprintf(outFile, "\t.import\treadi\n");
-	fprintf(outFile, "\t.import\treadc\n");
-	fprintf(outFile, "\t.import\texit\n");
-	fprintf(outFile, "\t.import\ttime\n");
-	fprintf(outFile, "\t.import\tclearAll\n");
-	fprintf(outFile, "\t.import\tsetPixel\n");
-	fprintf(outFile, "\t.import\tdrawLine\n");
-	fprintf(outFile, "\t.import\tdrawCircle\n");
-	fprintf(outFile, "\t.import\t_indexError\n");
-	fprintf(outFile, "\n");
-	fprintf(outFile, "\t.code\n");
-	fprintf(outFile, "\t.align\t4\n");
+	emitAsm(e, op, 0, 0, 0)->label = label;
 }
 
 /**
- * @brief Label chunks in assembly code with incrementing labels
+ * @brief Load a constant into a register, using ldhi/or if it does
+ * not fit into the 16 bit immediate of an add
  *
- * @param  void
- * @return int
+ * @param e emitter
+ * @param reg target register
+ * @param value constant
+ * @return void
  **/
-int getLabelNum(void)
+static void emitConst(Emitter * e, int reg, int value)
 {
-	static int labelnum = 0;
-	return (labelnum++);
+	if (FITS_IMM(value)) {
+		emitImm(e, ASM_ADD, reg, REG_ZERO, value);
+	} else {
+		emitImm(e, ASM_LDHI, reg, 0, value);
+		emitImm(e, ASM_OR, reg, reg, value & 0xFFFF);
+	}
 }
 
 /**
- * @brief Create assembly file by walking through abstract syntax
- *
- * @param program abstract syntax
- * @param globalTable symbol table
- * @param outFile assembly
- * @return void
+ * @brief Emit "op dst,src,value" for frame setup, with the constant in
+ * a scratch register if it is out of range
  **/
-void genCode(Absyn * program, Table * globalTable, FILE * outFile)
+static void emitFrameOp(Emitter * e, int op, int dst, int src, int value,
+			char *comment)
 {
-	Absyn *node;
-	assemblerProlog(outFile);
-	node = program;
-	absynTreeWalker(node, globalTable, outFile, MIN_REGISTER);
+	if (FITS_IMM(value)) {
+		emitImm(e, op, dst, src, value)->comment = comment;
+	} else {
+		emitConst(e, REG_SCRATCH2, value);
+		emitAsm(e, op, dst, src, REG_SCRATCH2)->comment = comment;
+	}
+}
+
+/* save a register in the frame */
+static void emitSave(Emitter * e, int reg, int offset, char *comment)
+{
+	AsmInstr *instr;
 
+	instr = emitAsm(e, ASM_STW, 0, REG_SP, reg);
+	instr->imm = offset;
+	instr->comment = comment;
 }
 
+static void emitRestore(Emitter * e, int reg, int offset, char *comment)
+{
+	emitImm(e, ASM_LDW, reg, REG_SP, offset)->comment = comment;
+}
 
 /**
- * @brief Mark ABSYN node for debugging. To enable set verbose to true
- *
- * @param outFile assembly
- * @param comment abstract syntax leaf
- * @return void
+ * @brief Base register and offset of the frame slot of a virtual register.
+ * Variables live at their own offset from fp, temporaries and the
+ * variables of inlined procedures in the spill area above the outgoing
+ * arguments. A leaf addresses its variables
+ * from sp, which does not move while it runs.
  **/
-void fComment(FILE * outFile, char *comment)
+static int homeOf(Emitter * e, int vreg, int *offset)
 {
-	if (verbose) {
-		fprintf(outFile, "\t;%s\n", comment);
+	Vreg *v;
+
+	v = &e->proc->vregs[vreg];
+	if (!v->inFrame) {
+		*offset = e->spillBase + v->home;
+		return REG_SP;
+	}
+	if (e->leaf) {
+		*offset = e->frameSize + v->home;
+		return REG_SP;
 	}
+	*offset = v->home;
+	return REG_FP;
 }
 
+static void loadHome(Emitter * e, int reg, int vreg)
+{
+	int base, offset;
+
+	base = homeOf(e, vreg, &offset);
+	if (FITS_IMM(offset)) {
+		emitImm(e, ASM_LDW, reg, base, offset);
+	} else {
+		emitConst(e, reg, offset);
+		emitAsm(e, ASM_ADD, reg, reg, base);
+		emitImm(e, ASM_LDW, reg, reg, 0);
+	}
+}
+
+static void storeHome(Emitter * e, int reg, int vreg)
+{
+	int base, offset;
+
+	base = homeOf(e, vreg, &offset);
+	if (FITS_IMM(offset)) {
+		emitAsm(e, ASM_STW, 0, base, reg)->imm = offset;
+	} else {
+		emitConst(e, REG_SCRATCH2, offset);
+		emitAsm(e, ASM_ADD, REG_SCRATCH2, REG_SCRATCH2, base);
+		emitAsm(e, ASM_STW, 0, REG_SCRATCH2, reg);
+	}
+}
 
 /**
- * @brief Create code so that node displays the value of "target"
- *
- * @param node abstract syntax
- * @param dst target value
- * @return void
+ * @brief Register holding a source operand; spilled operands are
+ * reloaded into the given scratch register
  **/
-void genCodeOpExp(Absyn * node, Table * symTab, FILE * outFile, int dst, int label, boolean arithmetic)
+static int srcReg(Emitter * e, int vreg, int scratch)
 {
-	absynTreeWalker(node->u.opExp.left, symTab, outFile, dst);
-	nextReg = dst + 1;
-
-	if (nextReg > MAX_REGISTER) {
-		error("expression too complicated, running out of registers.");
-	}
-	absynTreeWalker(node->u.opExp.right, symTab, outFile, nextReg);
-
-	/* Arithmethic Expressions */
-	if (arithmetic) {
-		switch (node->u.opExp.op) {
-		case ABSYN_OP_ADD:
-			{
-				fComment(outFile, "add");
-				fprintf(outFile, "\tadd\t$%i,$%i,$%i\n",
-					dst, dst, nextReg);
-				break;
-			}
-		case ABSYN_OP_SUB:
-			{
-				fComment(outFile, "sub");
-				fprintf(outFile, "\tsub\t$%i,$%i,$%i\n",
-					dst, dst, nextReg);
-				break;
-			}
-		case ABSYN_OP_MUL:
-			{
-				fComment(outFile, "mul");
-				fprintf(outFile, "\tmul\t$%i,$%i,$%i\n",
-					dst, dst, nextReg);
-				break;
-			}
-		case ABSYN_OP_DIV:
-			{
-				fComment(outFile, "div");
-				fprintf(outFile, "\tdiv\t$%i,$%i,$%i\n",
-					dst, dst, nextReg);
-				break;
-			}
+	switch (vreg) {
+	case VREG_ZERO:
+		return REG_ZERO;
+	case VREG_FP:
+		if (!e->leaf) {
+			return REG_FP;
 		}
-	}
-	/* Boolean Comparison Expressions */
-	else {
-		switch (node->u.opExp.op) {
-		case ABSYN_OP_EQU:
-			fprintf(outFile, "\tbne\t$%i,$%i,L%i\n", dst, dst + 1, label);
-			break;
-		case ABSYN_OP_NEQ:
-			fprintf(outFile, "\tbeq\t$%i,$%i,L%i\n", dst, dst + 1, label);
-			break;
-		case ABSYN_OP_LST:
-			fprintf(outFile, "\tbge\t$%i,$%i,L%i\n", dst, dst + 1, label);
-			break;
-		case ABSYN_OP_LSE:
-			fprintf(outFile, "\tbgt\t$%i,$%i,L%i\n", dst, dst + 1, label);
-			break;
-		case ABSYN_OP_GRT:
-			fprintf(outFile, "\tble\t$%i,$%i,L%i\n", dst, dst + 1, label);
-			break;
-		case ABSYN_OP_GRE:
-			fprintf(outFile, "\tblt\t$%i,$%i,L%i\n", dst, dst + 1, label);
-			break;
+		if (e->frameSize == 0) {
+			return REG_SP;
 		}
+		emitFrameOp(e, ASM_ADD, scratch, REG_SP, e->frameSize, NULL);
+		return scratch;
+	case VREG_SP:
+		return REG_SP;
 	}
-
+	if (e->proc->vregs[vreg].reg != 0) {
+		return e->proc->vregs[vreg].reg;
+	}
+	loadHome(e, scratch, vreg);
+	return scratch;
 }
 
+/**
+ * @brief Like srcReg for the base of an address with displacement;
+ * in a leaf the distance between fp and sp goes into the displacement
+ **/
+static int baseReg(Emitter * e, int vreg, int scratch, int *offset)
+{
+	if (vreg == VREG_FP && e->leaf && FITS_IMM(*offset + e->frameSize)) {
+		*offset += e->frameSize;
+		return REG_SP;
+	}
+	return srcReg(e, vreg, scratch);
+}
 
-// global vars for absynTreeWalker
-int oldTarget;
-ParamTypes *params = NULL;
+static int dstReg(Emitter * e, int vreg)
+{
+	if (e->proc->vregs[vreg].reg != 0) {
+		return e->proc->vregs[vreg].reg;
+	}
+	return REG_SCRATCH1;
+}
 
+static void writeBack(Emitter * e, int vreg)
+{
+	if (e->proc->vregs[vreg].reg == 0) {
+		storeHome(e, REG_SCRATCH1, vreg);
+	}
+}
 
-void absynTreeWalker(Absyn * node, Table * symTab, FILE * outFile, int dst)
+static int branchOp(int cond)
 {
-	Entry *entry = NULL;
-	Absyn *simpleVar;
-	Type *nodeLeaf;
-
-	// hold variable for assignment
-	int var;
-
-	int oldFp;
-	int frameSize;
-	int setLabelA = getLabelNum();
-	int setLabelB = getLabelNum();
-
-	static int args = 0;
-
-	switch (node->type) {
-	case ABSYN_PROCDEC:
-		{
-			/* Framegroesse berechnen */
-			entry = lookup(symTab, node->u.procDec.name);
-			if (entry->u.procEntry.argSize == -1) {
-				frameSize = entry->u.procEntry.localVarSize + INT_BYTE_SIZE;
-				oldFp = 0;
-			} else {
-				frameSize =
-				    entry->u.procEntry.localVarSize + 8 +
-				    entry->u.procEntry.argSize;
-				    oldFp = entry->u.procEntry.argSize + INT_BYTE_SIZE;
-			}
-			/* Prozedur-Prolog ausgeben */
-			fprintf(outFile, "\n\t.export %s\n%s:\n",
-				symToString(node->u.procDec.name),
-				symToString(node->u.procDec.name));
-			/* Code fuer Prozedurkoerper erzeugen */
-			fprintf(outFile, "\tsub\t$29,$29,%i\t\t; allocate frame\n"
-					 "\tstw\t$25,$29,%i\t\t; save old frame pointer\n"
-					 "\tadd\t$25,$29,%i\t\t; setup new frame pointer\n",
-					frameSize, oldFp, frameSize);
-
-			if (entry->u.procEntry.argSize != -1) {
-				fprintf(outFile,
-					"\tstw\t$31,$25,%i\t\t; save return register\n",
-					-(entry->u.procEntry.localVarSize + 8) );
-			}
-			/* Prozedur-Epilog ausgeben */
-			absynTreeWalker(node->u.procDec.body,
-					entry->u.procEntry.localTable, outFile, dst);
-
-			if (entry->u.procEntry.argSize != -1) {
-				fprintf(outFile,
-					"\tldw\t$31,$25,%i\t\t; restore return register\n",
-					-(entry->u.procEntry.localVarSize + 8) );
-			}
-			fprintf(outFile, "\tldw\t$25,$29,%i\t\t; restore old frame pointer\n",
-				oldFp);
-			fprintf(outFile, "\tadd\t$29,$29,%i\t\t; release frame\n", frameSize);
-			fprintf(outFile, "\tjr\t$31\t\t\t; return\n");
-			break;
-		}
+	switch (cond) {
+	case ABSYN_OP_EQU:	return ASM_BEQ;
+	case ABSYN_OP_NEQ:	return ASM_BNE;
+	case ABSYN_OP_LST:	return ASM_BLT;
+	case ABSYN_OP_LSE:	return ASM_BLE;
+	case ABSYN_OP_GRT:	return ASM_BGT;
+	case ABSYN_OP_GRE:	return ASM_BGE;
+	}
+	error("unknown relation %d in branchOp", cond);
+	return 0;
+}
 
-	case ABSYN_STMLIST:
-		{
-			if (!node->u.stmList.isEmpty) {
-				fComment(outFile, "stmList");
-				absynTreeWalker(node->u.stmList.head,
-						symTab, outFile, dst);
-				absynTreeWalker(node->u.stmList.tail,
-						symTab, outFile, dst);
-			}
-			break;
-		}
+static int arithOp(int op)
+{
+	switch (op) {
+	case IR_ADD:	return ASM_ADD;
+	case IR_SUB:	return ASM_SUB;
+	case IR_MUL:	return ASM_MUL;
+	case IR_DIV:	return ASM_DIV;
+	case IR_SLL:	return ASM_SLL;
+	}
+	error("unknown operation %d in arithOp", op);
+	return 0;
+}
 
-	case ABSYN_INTEXP:
-		{
-			fComment(outFile, "intExp");
-			fprintf(outFile, "\tadd\t$%i,$0,%i\n", dst, node->u.intExp.val);
-			break;
+/**
+ * @brief Emit the ECO32 instructions for one IR instruction
+ *
+ * @param e emitter
+ * @param instr IR instruction
+ * @return void
+ **/
+static void lowerInstr(Emitter * e, Instr * instr)
+{
+	Vreg *dst;
+	int d, a, b, imm;
+
+	switch (instr->op) {
+	case IR_LABEL:
+		emitLabel(e, ASM_LABEL, instr->label);
+		break;
+	case IR_LDC:
+		d = dstReg(e, instr->dst);
+		emitConst(e, d, instr->imm);
+		writeBack(e, instr->dst);
+		break;
+	case IR_MOV:
+		a = srcReg(e, instr->src1, REG_SCRATCH1);
+		d = dstReg(e, instr->dst);
+		if (d != a) {
+			emitAsm(e, ASM_ADD, d, a, REG_ZERO);
 		}
-
-	case ABSYN_OPEXP:
-		{
-			fComment(outFile, "opExp");
-			genCodeOpExp(node, symTab, outFile, dst, 0, TRUE);
-			break;
+		writeBack(e, instr->dst);
+		break;
+	case IR_ADD:
+	case IR_SUB:
+	case IR_MUL:
+	case IR_DIV:
+	case IR_SLL:
+		imm = instr->imm;
+		if (instr->op == IR_ADD && instr->src2 == VREG_NONE) {
+			a = baseReg(e, instr->src1, REG_SCRATCH1, &imm);
+		} else {
+			a = srcReg(e, instr->src1, REG_SCRATCH1);
 		}
-
-	case ABSYN_SIMPLEVAR:
-		{
-			fComment(outFile, "simpleVar");
-			entry = lookup(symTab, node->u.simpleVar.name);
-			fprintf(outFile, "\tadd\t$%i,$25,%i\n", dst,
-				entry->u.varEntry.offset);
-
-			if (entry->u.varEntry.isRef) {
-				fprintf(outFile, "\tldw\t$%i,$%i,0\n", dst, dst);
-			}
-			break;
+		d = dstReg(e, instr->dst);
+		if (instr->src2 == VREG_NONE) {
+			emitImm(e, arithOp(instr->op), d, a, imm);
+		} else {
+			b = srcReg(e, instr->src2, REG_SCRATCH2);
+			emitAsm(e, arithOp(instr->op), d, a, b);
 		}
-
-	case ABSYN_VAREXP:
-		{
-			fComment(outFile, "varExp");
-			absynTreeWalker(node->u.varExp.var, symTab, outFile, dst);
-			fprintf(outFile, "\tldw\t$%i,$%i,0\n", dst, dst);
+		writeBack(e, instr->dst);
+		break;
+	case IR_LDW:
+		dst = &e->proc->vregs[instr->dst];
+		if (instr->src1 == VREG_FP && dst->reg == 0 &&
+		    dst->inFrame && dst->home == instr->imm) {
+			/* spilled parameter stays in its argument slot */
 			break;
 		}
+		imm = instr->imm;
+		a = baseReg(e, instr->src1, REG_SCRATCH1, &imm);
+		d = dstReg(e, instr->dst);
+		emitImm(e, ASM_LDW, d, a, imm);
+		writeBack(e, instr->dst);
+		break;
+	case IR_STW:
+		imm = instr->imm;
+		a = baseReg(e, instr->src1, REG_SCRATCH1, &imm);
+		b = srcReg(e, instr->src2, REG_SCRATCH2);
+		emitAsm(e, ASM_STW, 0, a, b)->imm = imm;
+		break;
+	case IR_BR:
+		a = srcReg(e, instr->src1, REG_SCRATCH1);
+		b = srcReg(e, instr->src2, REG_SCRATCH2);
+		emitAsm(e, branchOp(instr->cond), 0, a, b)->label = instr->label;
+		break;
+	case IR_JMP:
+		emitLabel(e, ASM_J, instr->label);
+		break;
+	case IR_CHK:
+		a = srcReg(e, instr->src1, REG_SCRATCH1);
+		emitConst(e, REG_SCRATCH2, instr->imm);
+		emitAsm(e, ASM_BGEU, 0, a, REG_SCRATCH2)->sym = e->indexError;
+		break;
+	case IR_CALL:
+		emitAsm(e, ASM_JAL, 0, 0, 0)->sym = instr->sym;
+		break;
+	default:
+		error("unknown instruction %d in lowerInstr", instr->op);
+	}
+}
 
-	case ABSYN_ASSIGNSTM:
-		{
-			var = dst;
-			absynTreeWalker(node->u.assignStm.var, symTab, outFile, dst);
-			dst++;
-			absynTreeWalker(node->u.assignStm.exp, symTab, outFile, dst);
-			fprintf(outFile, "\tstw\t$%i,$%i,0\n", dst, var);
-			dst = 8;
-			break;
+/**
+ * @brief Whether the procedure touches its local variables in memory.
+ * If all of them live in registers, the frame needs no room for them;
+ * parameters are found above fp and do not count.
+ **/
+static boolean usesLocalArea(IrProc * proc)
+{
+	Block *block;
+	Instr *instr;
+	int i;
+
+	for (i = VREG_FIRST; i < proc->numVregs; i++) {
+		if (proc->vregs[i].inFrame && proc->vregs[i].reg == 0 &&
+		    proc->vregs[i].home < 0) {
+			return TRUE;
 		}
-
-	case ABSYN_ARRAYVAR:
-		{
-			/*absynTreeWalker(node->u.arrayVar.var, symTab, outFile, dst);
-
-			nextReg = (dst + 1);
-			if (nextReg > MAX_REGISTER) {
-				error
-				    ("expression too complicated, running out of registers.");
+	}
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		for (instr = block->first; instr != NULL; instr = instr->next) {
+			if (instr->src2 == VREG_FP ||
+			    (instr->src1 == VREG_FP && instr->imm < 0) ||
+			    (instr->src1 == VREG_FP && instr->op != IR_LDW &&
+			     instr->op != IR_STW)) {
+				return TRUE;
 			}
-
-			absynTreeWalker(node->u.arrayVar.var, symTab, outFile, nextReg);
-
-			backupReg = (nextReg + 1);
-			if (backupReg > MAX_REGISTER) {
-				error
-				    ("expression too complicated, running out of registers.");
+			if (instr == block->last) {
+				break;
 			}
-			nodeLeaf = node->typeGraph;
-			fprintf(outFile, "\tadd\t$%i,$0,%i\n", backupReg, nodeLeaf->u.arrayType.size);
-			fprintf(outFile, "\tbgeu\t$%i,$%i,_indexError\n",
-				nextReg, backupReg);
-			fprintf(outFile, "\tmul\t$%i,$%i,%i\n",
-				nextReg, nextReg, nodeLeaf->u.arrayType.baseType->byte_size);
-			fprintf(outFile, "\tadd\t$%i,$%i,$%i\n", dst, dst, nextReg);*/
-
-
-			backupReg = dst;
-
-			absynTreeWalker(node->u.arrayVar.var, symTab, outFile, dst);
-			dst++;
-			absynTreeWalker(node->u.arrayVar.var, symTab, outFile, dst);
-			dst++;
-
-
-			nodeLeaf = node->typeGraph;
-			fprintf(outFile,"\tadd\t$%d,$0,%d \n",dst,nodeLeaf->u.arrayType.size);
-			fprintf(outFile,"\tbgeu\t$%d,$%d,_indexError\n",dst-1,dst);
-			fprintf(outFile,"\tmul\t$%d,$%d,%d\n",dst-1,dst-1,nodeLeaf->u.arrayType.baseType->byte_size);
-			fprintf(outFile,"\tadd\t$%d,$%d,$%d\n",oldTarget,oldTarget,dst-1);
-
-			break;
 		}
+	}
+	return FALSE;
+}
 
-	case ABSYN_WHILESTM:
-		{
-			fComment(outFile, "whileStm");
-			setLabelA = getLabelNum();
-			setLabelB = getLabelNum();
-
-			fprintf(outFile, "L%i:\n", setLabelA);
-
-			genCodeOpExp(node->u.whileStm.test, symTab, outFile, dst, setLabelB, FALSE);
-			absynTreeWalker(node->u.whileStm.body, symTab, outFile, dst);
-
-			fprintf(outFile, "\tj\tL%i\n", setLabelA);
-			fprintf(outFile, "L%i:\n", setLabelB);
-			break;
+/**
+ * @brief Emit a procedure with prolog and epilog. From sp upwards the
+ * frame holds the outgoing arguments, the return address and old frame
+ * pointer, the saved callee-saved registers, the spill area and the
+ * local variables. A leaf keeps neither return address nor frame
+ * pointer in its frame and gets no frame at all if it has nothing to
+ * store there.
+ *
+ * @param e emitter
+ * @return void
+ **/
+static void emitProc(Emitter * e)
+{
+	IrProc *proc;
+	Block *block;
+	Instr *instr;
+	int argSize, localVarSize, saveSize, oldFp, saveBase;
+	int reg, offset;
+
+	proc = e->proc;
+	initAsmCode(&e->code);
+	argSize = proc->argSize;
+	localVarSize = proc->entry->u.procEntry.localVarSize;
+	if (!usesLocalArea(proc)) {
+		localVarSize = 0;
+	}
+	saveSize = 0;
+	for (reg = REG_CALLEE_MIN; reg <= REG_CALLEE_MAX; reg++) {
+		if (proc->savedRegs & (1u << reg)) {
+			saveSize += INT_BYTE_SIZE;
 		}
+	}
+	e->leaf = argSize == -1;
+	oldFp = argSize + INT_BYTE_SIZE;
+	saveBase = e->leaf ? 0 : argSize + 8;
+	e->spillBase = saveBase + saveSize;
+	e->frameSize = e->spillBase + proc->spillSize + localVarSize;
+
+	emitAsm(e, ASM_PROC, 0, 0, 0)->sym = proc->name;
+	if (e->frameSize != 0) {
+		emitFrameOp(e, ASM_SUB, REG_SP, REG_SP, e->frameSize,
+			    "allocate frame");
+	}
+	if (!e->leaf) {
+		emitSave(e, REG_FP, oldFp, "save old frame pointer");
+		emitFrameOp(e, ASM_ADD, REG_FP, REG_SP, e->frameSize,
+			    "setup new frame pointer");
+		emitSave(e, REG_RA, argSize, "save return register");
+	}
+	offset = saveBase;
+	for (reg = REG_CALLEE_MIN; reg <= REG_CALLEE_MAX; reg++) {
+		if (proc->savedRegs & (1u << reg)) {
+			emitSave(e, reg, offset, "save register");
+			offset += INT_BYTE_SIZE;
+		}
+	}
 
-	case ABSYN_IFSTM:
-		{
-			fComment(outFile, "ifStm");
-			setLabelA = getLabelNum();
-			setLabelB = getLabelNum();
-
-			if (node->u.ifStm.elsePart->type == ABSYN_EMPTYSTM) {
-				genCodeOpExp(node->u.ifStm.test, symTab, outFile, dst, setLabelA, FALSE);
-				absynTreeWalker(node->u.ifStm.thenPart, symTab, outFile, dst);
-				fprintf(outFile, "L%i:\n", setLabelA);
-
-			} else {
-				genCodeOpExp(node->u.ifStm.test, symTab, outFile, dst, setLabelA, FALSE);
-				absynTreeWalker(node->u.ifStm.thenPart, symTab, outFile, dst);
-				fprintf(outFile, "\tj\tL%i\n", setLabelB);
-
-				fprintf(outFile, "L%i:\n", setLabelA);
-				absynTreeWalker(node->u.ifStm.elsePart, symTab, outFile, dst);
-
-				fprintf(outFile, "L%i:\n", setLabelB);
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		for (instr = block->first; instr != NULL; instr = instr->next) {
+			lowerInstr(e, instr);
+			if (instr == block->last) {
+				break;
 			}
-			break;
 		}
+	}
 
-	case ABSYN_CALLSTM:
-		{
-			entry = lookup(symTab, node->u.callStm.name);
-
-			oldFp = entry->u.procEntry.localVarSize + 8;
-
-			params = entry->u.procEntry.paramTypes;
+	offset = saveBase;
+	for (reg = REG_CALLEE_MIN; reg <= REG_CALLEE_MAX; reg++) {
+		if (proc->savedRegs & (1u << reg)) {
+			emitRestore(e, reg, offset, "restore register");
+			offset += INT_BYTE_SIZE;
+		}
+	}
+	if (!e->leaf) {
+		emitRestore(e, REG_RA, argSize, "restore return register");
+		emitRestore(e, REG_FP, oldFp, "restore old frame pointer");
+	}
+	if (e->frameSize != 0) {
+		emitFrameOp(e, ASM_ADD, REG_SP, REG_SP, e->frameSize,
+			    "release frame");
+	}
+	emitAsm(e, ASM_JR, 0, REG_RA, 0)->comment = "return";
+}
 
-			absynTreeWalker(node->u.callStm.args, symTab, outFile, dst);
+static int countInstrs(IrProc * proc, int op)
+{
+	Instr *instr;
+	int n;
 
-			args = 0;
-			fprintf(outFile, "\tjal\t%s\n", symToString(node->u.callStm.name));
+	n = 0;
+	for (instr = proc->first; instr != NULL; instr = instr->next) {
+		n += instr->op == op;
+	}
+	return n;
+}
 
-			break;
-		}
+/* the statistics outlive the code of the procedure */
+static void addProcStats(Stats * stats, Sym * name, int instrsSaved)
+{
+	ProcStats *procStats;
+
+	procStats = (ProcStats *) allocateIn(ARENA_SEMANT, sizeof(ProcStats));
+	procStats->name = name;
+	procStats->instrsSaved = instrsSaved;
+	procStats->next = NULL;
+	*stats->lastProc = procStats;
+	stats->lastProc = &procStats->next;
+	stats->instrsSaved += instrsSaved;
+}
 
-	case ABSYN_DECLIST:
-		{
-			if (!node->u.decList.isEmpty) {
-				fComment(outFile, "decList");
-				absynTreeWalker(node->u.decList.head, symTab, outFile, dst);
-				absynTreeWalker(node->u.decList.tail, symTab, outFile, dst);
-			}
-			break;
-		}
+static void showStats(Stats * stats)
+{
+	ProcStats *procStats;
+
+	printf("\nOptimization statistics\n");
+	printf("bounds checks removed: %d of %d\n",
+	       stats->checksRemoved, stats->checks);
+	printf("calls inlined: %d\n", stats->callsInlined);
+	printf("tail calls: %d\n", stats->tailCalls);
+	printf("common subexpressions eliminated: %d\n",
+	       stats->commonSubexprs);
+	printf("loop invariants hoisted: %d\n", stats->hoisted);
+	printf("array accesses strength-reduced: %d\n", stats->reduced);
+	printf("instructions saved by peephole optimization: %d\n",
+	       stats->instrsSaved);
+	for (procStats = stats->procs; procStats != NULL;
+	     procStats = procStats->next) {
+		printf("  %-20s %d\n", symToString(procStats->name),
+		       procStats->instrsSaved);
+	}
+}
 
-	case ABSYN_COMPSTM:
-		{
-			fComment(outFile, "ABSYN_COMPSTM");
-			absynTreeWalker(node->u.compStm.stms, symTab, outFile, dst);
-			break;
-		}
+static void translateProc(Compiler * c, Job * job)
+{
+	Emitter emitter;
+	Stats *stats;
+	IrProc *proc;
+
+	stats = &job->stats;
+	proc = buildIr(job->procDec, c->globalTable, c->inliner, c->aliases);
+	stats->callsInlined = proc->numInlined;
+	stats->tailCalls = proc->numTailCalls;
+	buildCfg(proc);
+	stats->checks = countInstrs(proc, IR_CHK);
+	stats->checksRemoved = removeBoundsChecks(proc);
+	stats->commonSubexprs = eliminateCommonSubexprs(proc);
+	optimizeLoops(proc);
+	stats->hoisted = proc->numHoisted;
+	stats->reduced = proc->numReduced;
+	if (c->options->showIr) {
+		showIr(proc);
+	}
+	allocRegs(proc);
+	emitter.proc = proc;
+	emitter.indexError = c->indexError;
+	emitProc(&emitter);
+	stats->instrsSaved = optimizePeephole(&emitter.code);
+	job->numLabels = proc->numLabels;
+	/* the code outlives the arena of the thread */
+	job->code.count = emitter.code.count;
+	job->code.max = emitter.code.count;
+	job->code.instrs = (AsmInstr *) malloc((emitter.code.count + 1) *
+					      sizeof(AsmInstr));
+	if (job->code.instrs == NULL) {
+		error("out of memory");
+	}
+	memcpy(job->code.instrs, emitter.code.instrs,
+	       emitter.code.count * sizeof(AsmInstr));
+	/* the intermediate code is not needed any more */
+	releaseArena(ARENA_CODEGEN);
+}
 
-	case ABSYN_EXPLIST:
-		{
-			if (!node->u.expList.isEmpty) {
+static void getCounts(Stats * stats, int *counts)
+{
+	counts[0] = stats->checks;
+	counts[1] = stats->checksRemoved;
+	counts[2] = stats->callsInlined;
+	counts[3] = stats->tailCalls;
+	counts[4] = stats->commonSubexprs;
+	counts[5] = stats->hoisted;
+	counts[6] = stats->reduced;
+	counts[7] = stats->instrsSaved;
+}
 
-				if (params->isRef) {
+static void setCounts(Stats * stats, int *counts)
+{
+	stats->checks = counts[0];
+	stats->checksRemoved = counts[1];
+	stats->callsInlined = counts[2];
+	stats->tailCalls = counts[3];
+	stats->commonSubexprs = counts[4];
+	stats->hoisted = counts[5];
+	stats->reduced = counts[6];
+	stats->instrsSaved = counts[7];
+}
 
-					simpleVar = node->u.expList.head->u.varExp.var;
+/**
+ * @brief Translate one procedure, everything but writing the code,
+ * unless the cache has its code
+ *
+ * @param c compiler
+ * @param job procedure, gets the code and the statistics
+ * @return void
+ **/
+static void compileProc(Compiler * c, Job * job)
+{
+	Sym *name;
+	Hash key;
+	int counts[NUM_COUNTS];
 
-					absynTreeWalker(simpleVar, symTab, outFile, dst);
-				} else {
-					absynTreeWalker(node->u.expList.head,
-							symTab, outFile, dst);
+	if (c->cache == NULL) {
+		translateProc(c, job);
+		return;
+	}
+	name = job->procDec->u.procDec.name;
+	key = hashProc(c->cache, job->procDec, c->globalTable, c->inliner,
+		       c->aliases);
+	if (readCachedProc(c->cache, key, name, &job->code, &job->numLabels,
+			   counts, NUM_COUNTS)) {
+		setCounts(&job->stats, counts);
+		return;
+	}
+	translateProc(c, job);
+	getCounts(&job->stats, counts);
+	writeCachedProc(c->cache, key, name, &job->code, job->numLabels,
+			counts, NUM_COUNTS);
+}
 
-				}
+static void runJob(void *context, int job)
+{
+	Compiler *c;
 
-				fprintf(outFile,
-					"\tstw\t$%i,$29,%i\t\t; store arg #%i\n",
-					dst, params->offset,
-					(params->offset != 0)? (params->offset/INT_BYTE_SIZE) : params->offset);
+	c = (Compiler *) context;
+	selectAbsyn(c->program);
+	selectArena(ARENA_CODEGEN);
+	compileProc(c, &c->jobs[job]);
+}
 
-				params = params->next;
+/* write the code of a job and add its statistics */
+static void writeJob(AsmWriter * writer, Stats * stats, Job * job)
+{
+	stats->checks += job->stats.checks;
+	stats->checksRemoved += job->stats.checksRemoved;
+	stats->callsInlined += job->stats.callsInlined;
+	stats->tailCalls += job->stats.tailCalls;
+	stats->commonSubexprs += job->stats.commonSubexprs;
+	stats->hoisted += job->stats.hoisted;
+	stats->reduced += job->stats.reduced;
+	addProcStats(stats, job->procDec->u.procDec.name,
+		     job->stats.instrsSaved);
+	writeAsmCode(writer, &job->code);
+	writer->labelBase += job->numLabels;
+	free(job->code.instrs);
+	job->code.instrs = NULL;
+}
 
-				absynTreeWalker(node->u.expList.tail, symTab,
-						outFile, dst);
+/**
+ * @brief Write a job that is done while the workers of the pool may
+ * still be running: an error must not leave genCode before they have
+ * ended, so it lets the job fail instead
+ *
+ * @param pool pool of the jobs
+ * @param i number of the job
+ * @param writer assembly
+ * @param stats gets the statistics of the job
+ * @param job the job
+ * @return boolean - TRUE if the job was written
+ **/
+static boolean writeDoneJob(Pool * pool, int i, AsmWriter * writer,
+			    Stats * stats, Job * job)
+{
+	jmp_buf handler;
+	jmp_buf *previous;
+	boolean written;
+
+	previous = catchErrors(&handler);
+	if (setjmp(handler) == 0) {
+		writeJob(writer, stats, job);
+		written = TRUE;
+	} else {
+		failJob(pool, i, errorMessage());
+		written = FALSE;
+	}
+	catchErrors(previous);
+	return written;
+}
 
-			}
+/**
+ * @brief Create assembly file: every procedure is translated into the
+ * intermediate representation, optimized, gets its registers allocated
+ * and is then lowered to ECO32 instructions block by block. With more
+ * than one thread the procedures are translated concurrently; with a
+ * cache directory the code of procedures that did not change is taken
+ * from there.
+ *
+ * @param program abstract syntax
+ * @param globalTable symbol table
+ * @param outFile assembly
+ * @param options what to show besides the assembly
+ * @return void
+ **/
+void genCode(Absyn * program, Table * globalTable, FILE * outFile,
+	     CodegenOptions * options)
+{
+	Compiler c;
+	AsmWriter writer;
+	Stats stats;
+	Absyn *node;
+	Pool pool;
+	int i;
+
+	c.program = program;
+	c.globalTable = globalTable;
+	c.inliner = newInliner(program, globalTable, options->inlineThreshold);
+	c.aliases = newAliases(program, globalTable);
+	c.options = options;
+	c.cache = NULL;
+	if (options->cacheDir != NULL && !options->showIr) {
+		c.cache = newCache(options->cacheDir, options->inlineThreshold);
+	}
+	c.indexError = newSym("_indexError");
+	c.numJobs = 0;
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		c.numJobs += node->type == ABSYN_PROCDEC;
+	}
+	c.jobs = (Job *) allocateIn(ARENA_VARALLOC,
+				    (c.numJobs + 1) * sizeof(Job));
+	memset(c.jobs, 0, (c.numJobs + 1) * sizeof(Job));
+	c.numJobs = 0;
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		if (node->type == ABSYN_PROCDEC) {
+			c.jobs[c.numJobs++].procDec = node;
 		}
-
 	}
-
+	initAsmWriter(&writer, outFile);
+	assemblerProlog(&writer);
+	memset(&stats, 0, sizeof(Stats));
+	stats.lastProc = &stats.procs;
+	/* the intermediate code is shown procedure by procedure */
+	startPool(&pool, options->showIr ? 1 : options->numThreads, c.numJobs,
+		  runJob, &c);
+	i = 0;
+	while (i < c.numJobs && waitForJob(&pool, i) &&
+	       writeDoneJob(&pool, i, &writer, &stats, &c.jobs[i])) {
+		i++;
+	}
+	finishPool(&pool);
+	if (pool.failedJob < c.numJobs) {
+		/* the code of the jobs not written */
+		for (i = 0; i < c.numJobs; i++) {
+			free(c.jobs[i].code.instrs);
+		}
+		error("%s", pool.message);
+	}
+	closeAsmWriter(&writer);
+	if (options->showStats) {
+		showStats(&stats);
+	}
 }
@@ -0,0 +1,391 @@
+/*
+ * cse.c -- elimination of common subexpressions in basic blocks
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "inliner.h"
+#include "alias.h"
+#include "ir.h"
+#include "cse.h"
+
+/*
+ * Local value numbering. Inside a basic block every value computed
+ * gets a number, equal operations on equal numbers give the same
+ * value. A temporary computing a value that another register still
+ * holds is replaced by that register, so in
+ *
+ *     if (diag1[r + c] = 0) { ... diag1[r + c] := 1; ... }
+ *
+ * the sum, its check, the scaled index and the element address are
+ * computed once. Loads are numbered by their address, an address being
+ * a value plus a constant offset. A store forgets the loads it may
+ * overwrite and remembers the value stored. Two addresses with the
+ * same base value and different offsets never overlap; otherwise the
+ * region a base can point to decides: the own frame is not reachable
+ * through a ref parameter, and ref parameters may only alias each other
+ * if the alias analysis cannot rule it out.
+ * Nothing is kept over a call, which may write any memory and would
+ * force the values into callee-saved registers.
+ */
+
+#define NO_VALUE	(-1)
+
+typedef struct {
+	int base;		/* the value is base + offset */
+	int offset;
+	int region;		/* what the value can point to */
+} Value;
+
+typedef struct {
+	int stamp;		/* the entry is valid if stamp == generation */
+	int op;			/* key: operation and operand values */
+	int a;
+	int b;
+	int imm;
+	int value;		/* value number of the result */
+	int holder;		/* vreg the value was computed into */
+	boolean killed;		/* a load overwritten by a store */
+} Expr;
+
+typedef struct {
+	IrProc *proc;
+	Block *block;		/* block being numbered */
+	int *uses;		/* uses of each vreg */
+	int *values;		/* value number of each vreg */
+	int *stamps;		/* values[v] is valid if stamps[v] == stamp */
+	int stamp;
+	Value *numbered;	/* the values of the block */
+	int numValues;
+	Expr *exprs;		/* computations, open addressing */
+	int exprMask;
+	int generation;		/* advanced at calls and blocks */
+	int *loads;		/* entries of loads and stores */
+	int numLoads;
+	int eliminated;
+} Numbering;
+
+static int newValue(Numbering * n, int region)
+{
+	Value *value;
+
+	value = &n->numbered[n->numValues];
+	value->base = n->numValues;
+	value->offset = 0;
+	value->region = region;
+	return n->numValues++;
+}
+
+/* the fixed registers are their own value numbers */
+static int valueOf(Numbering * n, int vreg)
+{
+	if (vreg < VREG_FIRST) {
+		return vreg;
+	}
+	if (n->stamps[vreg] != n->stamp) {
+		n->values[vreg] = newValue(n, n->proc->vregs[vreg].region);
+		n->stamps[vreg] = n->stamp;
+	}
+	return n->values[vreg];
+}
+
+static void setValue(Numbering * n, int vreg, int value)
+{
+	n->values[vreg] = value;
+	n->stamps[vreg] = n->stamp;
+}
+
+static void startBlock(Numbering * n, Block * block)
+{
+	n->block = block;
+	n->stamp++;
+	n->generation++;
+	n->numLoads = 0;
+	n->numValues = 0;
+	newValue(n, REGION_NONE);	/* VREG_ZERO */
+	newValue(n, REGION_FRAME);	/* VREG_FP */
+	newValue(n, REGION_FRAME);	/* VREG_SP */
+}
+
+/* the entry for the key, a free one if there is none */
+static Expr *lookupExpr(Numbering * n, int op, int a, int b, int imm)
+{
+	Expr *expr;
+	unsigned i;
+
+	i = (((op * 31u + a) * 31u + b) * 31u + imm) & n->exprMask;
+	for (;;) {
+		expr = &n->exprs[i];
+		if (expr->stamp != n->generation) {
+			expr->stamp = n->generation;
+			expr->op = op;
+			expr->a = a;
+			expr->b = b;
+			expr->imm = imm;
+			expr->value = NO_VALUE;
+			expr->holder = VREG_NONE;
+			expr->killed = FALSE;
+			return expr;
+		}
+		if (expr->op == op && expr->a == a && expr->b == b &&
+		    expr->imm == imm) {
+			return expr;
+		}
+		i = (i + 1) & n->exprMask;
+	}
+}
+
+/* the entry gives a register that still holds its value */
+static boolean isAvailable(Numbering * n, Expr * expr)
+{
+	int holder;
+
+	if (expr->value == NO_VALUE || expr->killed) {
+		return FALSE;
+	}
+	holder = expr->holder;
+	return holder < VREG_FIRST ||
+	    (n->stamps[holder] == n->stamp && n->values[holder] == expr->value);
+}
+
+static void record(Numbering * n, Expr * expr, int value, int holder)
+{
+	expr->value = value;
+	expr->holder = holder;
+	expr->killed = FALSE;
+	if (expr->op == IR_LDW) {
+		n->loads[n->numLoads++] = expr - n->exprs;
+	}
+}
+
+/**************************************************************/
+
+/* the result of a computation seen for the first time */
+static int computedValue(Numbering * n, Instr * instr, int a, int b)
+{
+	Value *va;
+	int value;
+
+	if (instr->op == IR_LDC) {
+		return newValue(n, REGION_NONE);
+	}
+	va = &n->numbered[a];
+	if ((instr->op == IR_ADD || instr->op == IR_SUB) && b == NO_VALUE) {
+		value = newValue(n, va->region);
+		n->numbered[value].base = va->base;
+		n->numbered[value].offset = instr->op == IR_ADD ?
+		    va->offset + instr->imm : va->offset - instr->imm;
+		return value;
+	}
+	return newValue(n, resultRegion(n->proc, instr, va->region,
+					b == NO_VALUE ? REGION_NONE :
+					n->numbered[b].region));
+}
+
+/* instructions up to the next definition of holder read it instead */
+static void renameUses(Numbering * n, Instr * instr, int holder)
+{
+	Instr *next;
+	int temp;
+
+	temp = instr->dst;
+	next = instr;
+	while (next != n->block->last) {
+		next = next->next;
+		if (next->src1 == temp) {
+			next->src1 = holder;
+			n->uses[temp]--;
+			n->uses[holder]++;
+		}
+		if (next->src2 == temp) {
+			next->src2 = holder;
+			n->uses[temp]--;
+			n->uses[holder]++;
+		}
+		if (holder >= VREG_FIRST && definesVreg(next) && next->dst == holder) {
+			break;
+		}
+	}
+}
+
+/* the value of instr is already held by holder */
+static void reuseValue(Numbering * n, Instr * instr, int holder)
+{
+	if (n->proc->vregs[instr->dst].name == NULL) {
+		renameUses(n, instr, holder);
+		if (n->uses[instr->dst] == 0) {
+			removeInstr(n->proc, instr);
+			n->eliminated++;
+			return;
+		}
+	} else if (instr->op != IR_LDW) {
+		/* a copy would cost as much as the computation */
+		return;
+	}
+	if (holder == instr->dst) {
+		removeInstr(n->proc, instr);
+	} else {
+		instr->op = IR_MOV;
+		instr->src1 = holder;
+		instr->src2 = VREG_NONE;
+		instr->imm = 0;
+	}
+	n->eliminated++;
+}
+
+static void numberComputation(Numbering * n, Instr * instr)
+{
+	Expr *expr;
+	int a, b, t, dst;
+
+	dst = instr->dst;
+	if (instr->op == IR_MOV) {
+		setValue(n, dst, valueOf(n, instr->src1));
+		return;
+	}
+	if (instr->op == IR_LDC) {
+		a = NO_VALUE;
+		b = NO_VALUE;
+		expr = lookupExpr(n, IR_LDC, a, b, instr->imm);
+	} else if (instr->op == IR_LDW) {
+		a = valueOf(n, instr->src1);
+		b = NO_VALUE;
+		expr = lookupExpr(n, IR_LDW, n->numbered[a].base, b,
+				  n->numbered[a].offset + instr->imm);
+	} else {
+		a = valueOf(n, instr->src1);
+		b = instr->src2 == VREG_NONE ? NO_VALUE : valueOf(n, instr->src2);
+		if ((instr->op == IR_ADD || instr->op == IR_MUL) && b < a &&
+		    b != NO_VALUE) {
+			t = a;
+			a = b;
+			b = t;
+		}
+		expr = lookupExpr(n, instr->op, a, b,
+				  b == NO_VALUE ? instr->imm : 0);
+	}
+	if (isAvailable(n, expr)) {
+		setValue(n, dst, expr->value);
+		reuseValue(n, instr, expr->holder);
+		return;
+	}
+	record(n, expr, computedValue(n, instr, a, b), dst);
+	setValue(n, dst, expr->value);
+}
+
+static void numberStore(Numbering * n, Instr * instr)
+{
+	Expr *expr;
+	int address, base, offset, region, i;
+
+	address = valueOf(n, instr->src1);
+	base = n->numbered[address].base;
+	offset = n->numbered[address].offset + instr->imm;
+	region = n->numbered[address].region;
+	for (i = 0; i < n->numLoads; i++) {
+		expr = &n->exprs[n->loads[i]];
+		if (expr->stamp != n->generation || expr->killed) {
+			continue;
+		}
+		if (expr->a == base ? expr->imm == offset :
+		    regionsOverlap(region, n->numbered[expr->a].region)) {
+			expr->killed = TRUE;
+		}
+	}
+	/* a later load gets the value stored */
+	expr = lookupExpr(n, IR_LDW, base, NO_VALUE, offset);
+	record(n, expr, valueOf(n, instr->src2), instr->src2);
+}
+
+static void numberCheck(Numbering * n, Instr * instr)
+{
+	Expr *expr;
+
+	expr = lookupExpr(n, IR_CHK, valueOf(n, instr->src1), NO_VALUE,
+			  instr->imm);
+	if (expr->value != NO_VALUE) {
+		removeInstr(n->proc, instr);
+		n->eliminated++;
+		return;
+	}
+	expr->value = 0;
+}
+
+/**
+ * @brief Replace computations of values that are still held in a
+ * register by that register, block by block
+ *
+ * @param proc procedure with control flow graph
+ * @return int - number of instructions removed or turned into copies
+ **/
+int eliminateCommonSubexprs(IrProc * proc)
+{
+	Numbering n;
+	Block *block;
+	Instr *instr, *next;
+	int used[2];
+	int numInstrs, size, i, k;
+
+	memset(&n, 0, sizeof(Numbering));
+	n.proc = proc;
+	n.uses = (int *) allocate(proc->numVregs * sizeof(int));
+	n.values = (int *) allocate(proc->numVregs * sizeof(int));
+	n.stamps = (int *) allocate(proc->numVregs * sizeof(int));
+	memset(n.uses, 0, proc->numVregs * sizeof(int));
+	memset(n.stamps, 0, proc->numVregs * sizeof(int));
+	numInstrs = 0;
+	for (instr = proc->first; instr != NULL; instr = instr->next) {
+		k = usedVregs(instr, used);
+		for (i = 0; i < k; i++) {
+			n.uses[used[i]]++;
+		}
+		numInstrs++;
+	}
+	/* every instruction makes at most three values and one entry */
+	n.numbered = (Value *) allocate((3 * numInstrs + 3) * sizeof(Value));
+	n.loads = (int *) allocate((numInstrs + 1) * sizeof(int));
+	size = 8;
+	while (size < 2 * numInstrs) {
+		size *= 2;
+	}
+	n.exprs = (Expr *) allocate(size * sizeof(Expr));
+	memset(n.exprs, 0, size * sizeof(Expr));
+	n.exprMask = size - 1;
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		startBlock(&n, block);
+		for (instr = block->first; instr != NULL; instr = next) {
+			next = instr == block->last ? NULL : instr->next;
+			switch (instr->op) {
+			case IR_LDC:
+			case IR_MOV:
+			case IR_ADD:
+			case IR_SUB:
+			case IR_MUL:
+			case IR_DIV:
+			case IR_SLL:
+			case IR_LDW:
+				numberComputation(&n, instr);
+				break;
+			case IR_STW:
+				numberStore(&n, instr);
+				break;
+			case IR_CHK:
+				numberCheck(&n, instr);
+				break;
+			case IR_CALL:
+				n.generation++;
+				n.numLoads = 0;
+				break;
+			}
+		}
+	}
+	return n.eliminated;
+}
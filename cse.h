@@ -0,0 +1,10 @@
+/*
+ * cse.h -- elimination of common subexpressions in basic blocks
+ */
+
+#ifndef _CSE_H_
+#define _CSE_H_
+
+int eliminateCommonSubexprs(IrProc * proc);
+
+#endif				/* _CSE_H_ */
@@ -0,0 +1,287 @@
+/*
+ * fold.c -- constant folding
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "fold.h"
+
+/*
+ * The tree is rewritten in place after semantic analysis. A folded
+ * node is either replaced by one of its children or turned into a
+ * smaller node (IntExp, EmptyStm) in the memory it already occupies.
+ * Expressions have no side effects apart from stopping the program
+ * with an index error or a division by zero, so a subtree may only be
+ * dropped if it cannot trap.
+ */
+
+static boolean isConst(Absyn * node, int val)
+{
+	return node->type == ABSYN_INTEXP && node->u.intExp.val == val;
+}
+
+/**
+ * @brief Whether evaluating an expression may stop the program
+ *
+ * @param node expression
+ * @return boolean - TRUE if it contains an array access or a division
+ **/
+static boolean canTrap(Absyn * node)
+{
+	switch (node->type) {
+	case ABSYN_INTEXP:
+		return FALSE;
+	case ABSYN_VAREXP:
+		return ABSYN(node->u.varExp.var)->type == ABSYN_ARRAYVAR;
+	case ABSYN_OPEXP:
+		if (node->u.opExp.op == ABSYN_OP_DIV &&
+		    (ABSYN(node->u.opExp.right)->type != ABSYN_INTEXP ||
+		     isConst(ABSYN(node->u.opExp.right), 0))) {
+			return TRUE;
+		}
+		return canTrap(ABSYN(node->u.opExp.left)) || canTrap(ABSYN(node->u.opExp.right));
+	}
+	return TRUE;
+}
+
+static void makeIntExp(Absyn * node, int val)
+{
+	node->type = ABSYN_INTEXP;
+	node->u.intExp.val = val;
+}
+
+/**
+ * @brief Evaluate an operator on two constants with the 32 bit
+ * wrap-around of the target machine
+ *
+ * @param op operator
+ * @param x left operand
+ * @param y right operand, not 0 for division
+ * @return int - result, 0 or 1 for comparisons
+ **/
+static int evalOp(int op, int x, int y)
+{
+	switch (op) {
+	case ABSYN_OP_EQU:	return x == y;
+	case ABSYN_OP_NEQ:	return x != y;
+	case ABSYN_OP_LST:	return x < y;
+	case ABSYN_OP_LSE:	return x <= y;
+	case ABSYN_OP_GRT:	return x > y;
+	case ABSYN_OP_GRE:	return x >= y;
+	case ABSYN_OP_ADD:	return (int) ((unsigned) x + (unsigned) y);
+	case ABSYN_OP_SUB:	return (int) ((unsigned) x - (unsigned) y);
+	case ABSYN_OP_MUL:	return (int) ((unsigned) x * (unsigned) y);
+	case ABSYN_OP_DIV:	return x / y;
+	}
+	error("unknown operator %d in evalOp", op);
+	return 0;
+}
+
+static Absyn *foldVar(Absyn * node);
+
+/**
+ * @brief Fold an expression
+ *
+ * @param node expression
+ * @return Absyn* - the folded expression, may be a child of node
+ **/
+static Absyn *foldExp(Absyn * node)
+{
+	Absyn *left, *right;
+	int op;
+
+	switch (node->type) {
+	case ABSYN_VAREXP:
+		node->u.varExp.var = ABSYN_REF(foldVar(ABSYN(node->u.varExp.var)));
+		return node;
+	case ABSYN_OPEXP:
+		break;
+	default:
+		return node;
+	}
+	left = foldExp(ABSYN(node->u.opExp.left));
+	right = foldExp(ABSYN(node->u.opExp.right));
+	node->u.opExp.left = ABSYN_REF(left);
+	node->u.opExp.right = ABSYN_REF(right);
+	op = node->u.opExp.op;
+
+	if (left->type == ABSYN_INTEXP && right->type == ABSYN_INTEXP) {
+		/* 0x80000000 / -1 overflows, x / 0 must trap at runtime */
+		if (op != ABSYN_OP_DIV ||
+		    (right->u.intExp.val != 0 &&
+		     !(right->u.intExp.val == -1 &&
+		       left->u.intExp.val == (int) 0x80000000))) {
+			makeIntExp(node, evalOp(op, left->u.intExp.val,
+						right->u.intExp.val));
+		}
+		return node;
+	}
+
+	switch (op) {
+	case ABSYN_OP_ADD:
+		if (isConst(left, 0)) {
+			return right;
+		}
+		if (isConst(right, 0)) {
+			return left;
+		}
+		break;
+	case ABSYN_OP_SUB:
+		if (isConst(right, 0)) {
+			return left;
+		}
+		/* double unary minus */
+		if (isConst(left, 0) && right->type == ABSYN_OPEXP &&
+		    right->u.opExp.op == ABSYN_OP_SUB &&
+		    isConst(ABSYN(right->u.opExp.left), 0)) {
+			return ABSYN(right->u.opExp.right);
+		}
+		break;
+	case ABSYN_OP_MUL:
+		if (isConst(left, 1)) {
+			return right;
+		}
+		if (isConst(right, 1)) {
+			return left;
+		}
+		if ((isConst(left, 0) && !canTrap(right)) ||
+		    (isConst(right, 0) && !canTrap(left))) {
+			makeIntExp(node, 0);
+		}
+		break;
+	case ABSYN_OP_DIV:
+		if (isConst(right, 1)) {
+			return left;
+		}
+		break;
+	}
+	return node;
+}
+
+static Absyn *foldVar(Absyn * node)
+{
+	if (node->type == ABSYN_ARRAYVAR) {
+		node->u.arrayVar.var = ABSYN_REF(foldVar(ABSYN(node->u.arrayVar.var)));
+		node->u.arrayVar.index = ABSYN_REF(foldExp(ABSYN(node->u.arrayVar.index)));
+	}
+	return node;
+}
+
+static Absyn *foldStm(Absyn * node);
+
+/* the statement never completes, every path calls exit() */
+static boolean alwaysExits(Absyn * node)
+{
+	Absyn *list;
+	int i;
+
+	switch (node->type) {
+	case ABSYN_COMPSTM:
+		list = ABSYN(node->u.compStm.stms);
+		for (i = 0; i < list->u.stmList.count; i++) {
+			if (alwaysExits(ABSYN(list->u.stmList.items[i]))) {
+				return TRUE;
+			}
+		}
+		return FALSE;
+	case ABSYN_IFSTM:
+		return alwaysExits(ABSYN(node->u.ifStm.thenPart)) &&
+		    alwaysExits(ABSYN(node->u.ifStm.elsePart));
+	case ABSYN_CALLSTM:
+		return strcmp(symToString(node->u.callStm.name), "exit") == 0;
+	}
+	return FALSE;
+}
+
+/* statements after one that always exits are dropped */
+static void foldStmList(Absyn * list)
+{
+	Absyn *stm;
+	int i;
+
+	for (i = 0; i < list->u.stmList.count; i++) {
+		stm = foldStm(ABSYN(list->u.stmList.items[i]));
+		list->u.stmList.items[i] = ABSYN_REF(stm);
+		if (alwaysExits(stm)) {
+			list->u.stmList.count = i + 1;
+		}
+	}
+}
+
+/**
+ * @brief Fold the expressions of a statement. Statements whose test
+ * folds to a constant are replaced by the branch that is taken.
+ *
+ * @param node statement
+ * @return Absyn* - the folded statement
+ **/
+static Absyn *foldStm(Absyn * node)
+{
+	Absyn *args, *test;
+	int i;
+
+	switch (node->type) {
+	case ABSYN_COMPSTM:
+		foldStmList(ABSYN(node->u.compStm.stms));
+		break;
+	case ABSYN_ASSIGNSTM:
+		node->u.assignStm.var = ABSYN_REF(foldVar(ABSYN(node->u.assignStm.var)));
+		node->u.assignStm.exp = ABSYN_REF(foldExp(ABSYN(node->u.assignStm.exp)));
+		break;
+	case ABSYN_IFSTM:
+		test = foldExp(ABSYN(node->u.ifStm.test));
+		node->u.ifStm.test = ABSYN_REF(test);
+		node->u.ifStm.thenPart = ABSYN_REF(foldStm(ABSYN(node->u.ifStm.thenPart)));
+		node->u.ifStm.elsePart = ABSYN_REF(foldStm(ABSYN(node->u.ifStm.elsePart)));
+		if (test->type == ABSYN_INTEXP) {
+			return test->u.intExp.val ? ABSYN(node->u.ifStm.thenPart)
+			    : ABSYN(node->u.ifStm.elsePart);
+		}
+		break;
+	case ABSYN_WHILESTM:
+		test = foldExp(ABSYN(node->u.whileStm.test));
+		node->u.whileStm.test = ABSYN_REF(test);
+		node->u.whileStm.body = ABSYN_REF(foldStm(ABSYN(node->u.whileStm.body)));
+		if (test->type == ABSYN_INTEXP && test->u.intExp.val == 0) {
+			node->type = ABSYN_EMPTYSTM;
+		}
+		break;
+	case ABSYN_CALLSTM:
+		args = ABSYN(node->u.callStm.args);
+		for (i = 0; i < args->u.expList.count; i++) {
+			args->u.expList.items[i] =
+			    ABSYN_REF(foldExp(ABSYN(args->u.expList.items[i])));
+		}
+		break;
+	}
+	return node;
+}
+
+/**
+ * @brief Fold constant subexpressions and simplify identities like
+ * x + 0, x * 1 and x * 0 in all procedure bodies. A division by zero
+ * is never folded, it has to happen at runtime. Statements that
+ * cannot be reached after a call of exit() are removed.
+ *
+ * @param program checked abstract syntax
+ * @return void
+ **/
+void foldConstants(Absyn * program)
+{
+	Absyn *node;
+	int i;
+
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		if (node->type == ABSYN_PROCDEC) {
+			foldStmList(ABSYN(node->u.procDec.body));
+		}
+	}
+}
@@ -0,0 +1,10 @@
+/*
+ * fold.h -- constant folding
+ */
+
+#ifndef _FOLD_H_
+#define _FOLD_H_
+
+void foldConstants(Absyn * program);
+
+#endif				/* _FOLD_H_ */
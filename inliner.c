@@ -0,0 +1,341 @@
+/*
+ * inliner.c -- selection of procedures to inline
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "inliner.h"
+
+/*
+ * The call graph is searched depth first from every procedure of the
+ * program. A call to a procedure still on the search stack closes a
+ * cycle, everything on the stack from there on is recursive and never
+ * inlined. When the search leaves a procedure, all its callees are
+ * decided, so its size with inlined calls expanded is known. The body
+ * of an inlined procedure becomes part of the caller's intermediate
+ * code, its variables become virtual registers of the caller. This
+ * requires that none of them has to live in memory: no arrays, and no
+ * scalars whose address is passed on to a call that is not inlined.
+ */
+
+#define STATE_NEW	0
+#define STATE_ACTIVE	1
+#define STATE_DONE	2
+
+/* the procedure declared in the program, NULL for predefined ones */
+static ProcInfo *calledProc(Inliner * inliner, Sym * name)
+{
+	Entry *entry;
+
+	entry = lookup(inliner->globalTable, name);
+	if (entry->u.procEntry.procDec == NULL) {
+		return NULL;
+	}
+	return &inliner->procs[entry->u.procEntry.number];
+}
+
+static boolean argEscapes(ProcInfo * callee, int param)
+{
+	return callee == NULL || !callee->inlinable || callee->refEscapes[param];
+}
+
+static int sizeOfExp(Absyn * node);
+
+static int sizeOfVar(Absyn * node)
+{
+	if (node->type == ABSYN_SIMPLEVAR) {
+		return 1;
+	}
+	return 1 + sizeOfVar(ABSYN(node->u.arrayVar.var)) +
+	    sizeOfExp(ABSYN(node->u.arrayVar.index));
+}
+
+static int sizeOfExp(Absyn * node)
+{
+	switch (node->type) {
+	case ABSYN_VAREXP:
+		return sizeOfVar(ABSYN(node->u.varExp.var));
+	case ABSYN_OPEXP:
+		return 1 + sizeOfExp(ABSYN(node->u.opExp.left)) +
+		    sizeOfExp(ABSYN(node->u.opExp.right));
+	}
+	return 1;
+}
+
+/* number of nodes, calls to inlined procedures count their body */
+static int sizeOfStm(Inliner * inliner, Absyn * node)
+{
+	ProcInfo *callee;
+	Absyn *args;
+	int size, i;
+
+	switch (node->type) {
+	case ABSYN_COMPSTM:
+		return sizeOfStm(inliner, ABSYN(node->u.compStm.stms));
+	case ABSYN_STMLIST:
+		size = 0;
+		for (i = 0; i < node->u.stmList.count; i++) {
+			size += sizeOfStm(inliner, ABSYN(node->u.stmList.items[i]));
+		}
+		return size;
+	case ABSYN_ASSIGNSTM:
+		return 1 + sizeOfVar(ABSYN(node->u.assignStm.var)) +
+		    sizeOfExp(ABSYN(node->u.assignStm.exp));
+	case ABSYN_IFSTM:
+		return 1 + sizeOfExp(ABSYN(node->u.ifStm.test)) +
+		    sizeOfStm(inliner, ABSYN(node->u.ifStm.thenPart)) +
+		    sizeOfStm(inliner, ABSYN(node->u.ifStm.elsePart));
+	case ABSYN_WHILESTM:
+		return 1 + sizeOfExp(ABSYN(node->u.whileStm.test)) +
+		    sizeOfStm(inliner, ABSYN(node->u.whileStm.body));
+	case ABSYN_CALLSTM:
+		callee = calledProc(inliner, node->u.callStm.name);
+		size = callee != NULL && callee->inlinable ? callee->size : 1;
+		args = ABSYN(node->u.callStm.args);
+		for (i = 0; i < args->u.expList.count; i++) {
+			size += sizeOfExp(ABSYN(args->u.expList.items[i]));
+		}
+		return size;
+	}
+	return 0;
+}
+
+static void visitProc(Inliner * inliner, ProcInfo * info);
+
+/* search the callees of the statements */
+static void visitCalls(Inliner * inliner, Absyn * node)
+{
+	ProcInfo *callee;
+	int i;
+
+	switch (node->type) {
+	case ABSYN_COMPSTM:
+		visitCalls(inliner, ABSYN(node->u.compStm.stms));
+		break;
+	case ABSYN_STMLIST:
+		for (i = 0; i < node->u.stmList.count; i++) {
+			visitCalls(inliner, ABSYN(node->u.stmList.items[i]));
+		}
+		break;
+	case ABSYN_IFSTM:
+		visitCalls(inliner, ABSYN(node->u.ifStm.thenPart));
+		visitCalls(inliner, ABSYN(node->u.ifStm.elsePart));
+		break;
+	case ABSYN_WHILESTM:
+		visitCalls(inliner, ABSYN(node->u.whileStm.body));
+		break;
+	case ABSYN_CALLSTM:
+		callee = calledProc(inliner, node->u.callStm.name);
+		if (callee == NULL) {
+			break;
+		}
+		if (callee->state == STATE_NEW) {
+			visitProc(inliner, callee);
+		} else if (callee->state == STATE_ACTIVE) {
+			i = inliner->depth;
+			do {
+				inliner->stack[--i]->recursive = TRUE;
+			} while (inliner->stack[i] != callee);
+		}
+		break;
+	}
+}
+
+static int paramIndex(Absyn * procDec, Sym * name)
+{
+	Absyn *params;
+	int i;
+
+	params = ABSYN(procDec->u.procDec.params);
+	for (i = 0; i < params->u.decList.count; i++) {
+		if (ABSYN(params->u.decList.items[i])->u.parDec.name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Find the variables of a procedure whose address is passed to
+ * a call that needs it. For a ref parameter the caller has to supply
+ * an address, any other such variable has to stay in memory.
+ *
+ * @return boolean - TRUE if a variable other than a ref parameter
+ * has to live in memory
+ **/
+static boolean findEscapes(Inliner * inliner, ProcInfo * info, Absyn * node)
+{
+	ProcInfo *callee;
+	ParamTypes *params;
+	Absyn *args, *var;
+	boolean inMemory;
+	int i;
+
+	inMemory = FALSE;
+	switch (node->type) {
+	case ABSYN_COMPSTM:
+		return findEscapes(inliner, info, ABSYN(node->u.compStm.stms));
+	case ABSYN_STMLIST:
+		for (i = 0; i < node->u.stmList.count; i++) {
+			inMemory |= findEscapes(inliner, info,
+						ABSYN(node->u.stmList.items[i]));
+		}
+		break;
+	case ABSYN_IFSTM:
+		inMemory = findEscapes(inliner, info, ABSYN(node->u.ifStm.thenPart));
+		inMemory |= findEscapes(inliner, info, ABSYN(node->u.ifStm.elsePart));
+		break;
+	case ABSYN_WHILESTM:
+		return findEscapes(inliner, info, ABSYN(node->u.whileStm.body));
+	case ABSYN_CALLSTM:
+		callee = calledProc(inliner, node->u.callStm.name);
+		params = lookup(inliner->globalTable,
+				node->u.callStm.name)->u.procEntry.paramTypes;
+		args = ABSYN(node->u.callStm.args);
+		for (i = 0; !params->isEmpty; i++) {
+			if (params->isRef && argEscapes(callee, i)) {
+				var = ABSYN(ABSYN(args->u.expList.items[i])->u.varExp.var);
+				if (var->type != ABSYN_SIMPLEVAR) {
+					/* the address of an element is computed */
+				} else if (lookup(info->entry->u.procEntry.localTable,
+						  var->u.simpleVar.name)->u.varEntry.isRef) {
+					info->refEscapes[paramIndex(info->procDec,
+					    var->u.simpleVar.name)] = TRUE;
+				} else {
+					inMemory = TRUE;
+				}
+			}
+			params = params->next;
+		}
+		break;
+	}
+	return inMemory;
+}
+
+/* all callees are decided */
+static void decideProc(Inliner * inliner, ProcInfo * info)
+{
+	Absyn *decs;
+	Entry *entry;
+	boolean inMemory;
+	int n, i;
+
+	n = ABSYN(info->procDec->u.procDec.params)->u.decList.count;
+	info->refEscapes = (boolean *) allocateIn(ARENA_VARALLOC,
+						  (n + 1) * sizeof(boolean));
+	memset(info->refEscapes, 0, (n + 1) * sizeof(boolean));
+	inMemory = findEscapes(inliner, info, ABSYN(info->procDec->u.procDec.body));
+	decs = ABSYN(info->procDec->u.procDec.decls);
+	for (i = 0; i < decs->u.decList.count; i++) {
+		entry = lookup(info->entry->u.procEntry.localTable,
+			       ABSYN(decs->u.decList.items[i])->u.varDec.name);
+		if (entry->u.varEntry.type->kind != TYPE_KIND_PRIMITIVE) {
+			inMemory = TRUE;
+		}
+	}
+	info->size = sizeOfStm(inliner, ABSYN(info->procDec->u.procDec.body));
+	info->inlinable = inliner->threshold > 0 && !info->recursive &&
+	    !inMemory && info->size <= inliner->threshold;
+}
+
+static void visitProc(Inliner * inliner, ProcInfo * info)
+{
+	info->state = STATE_ACTIVE;
+	inliner->stack[inliner->depth++] = info;
+	visitCalls(inliner, ABSYN(info->procDec->u.procDec.body));
+	inliner->depth--;
+	decideProc(inliner, info);
+	info->state = STATE_DONE;
+}
+
+/**
+ * @brief Build the call graph of the program and decide which
+ * procedures are inlined at their call sites
+ *
+ * @param program abstract syntax
+ * @param globalTable symbol table
+ * @param threshold largest size of a procedure body to inline
+ * @return Inliner* - the decisions, valid until variable allocation
+ * is released
+ **/
+Inliner *newInliner(Absyn * program, Table * globalTable, int threshold)
+{
+	Inliner *inliner;
+	ProcInfo *info;
+	Entry *entry;
+	Absyn *node;
+	int n, i;
+
+	inliner = (Inliner *) allocateIn(ARENA_VARALLOC, sizeof(Inliner));
+	inliner->globalTable = globalTable;
+	inliner->threshold = threshold;
+	n = program->u.decList.count;
+	inliner->procs = (ProcInfo *) allocateIn(ARENA_VARALLOC,
+						 (n + 1) * sizeof(ProcInfo));
+	memset(inliner->procs, 0, (n + 1) * sizeof(ProcInfo));
+	inliner->stack = (ProcInfo **) allocateIn(ARENA_VARALLOC,
+						  (n + 1) * sizeof(ProcInfo *));
+	inliner->depth = 0;
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		if (node->type == ABSYN_PROCDEC) {
+			entry = lookup(globalTable, node->u.procDec.name);
+			info = &inliner->procs[entry->u.procEntry.number];
+			info->procDec = node;
+			info->entry = entry;
+		}
+	}
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		if (node->type == ABSYN_PROCDEC) {
+			info = calledProc(inliner, node->u.procDec.name);
+			if (info->state == STATE_NEW) {
+				visitProc(inliner, info);
+			}
+		}
+	}
+	return inliner;
+}
+
+/**
+ * @brief The declaration of a procedure whose calls are replaced by
+ * its body
+ *
+ * @param inliner decisions
+ * @param name called procedure
+ * @return Absyn* - procedure declaration, NULL if not inlined
+ **/
+Absyn *inlineCandidate(Inliner * inliner, Sym * name)
+{
+	ProcInfo *info;
+
+	info = calledProc(inliner, name);
+	if (info == NULL || !info->inlinable) {
+		return NULL;
+	}
+	return info->procDec;
+}
+
+/**
+ * @brief Whether a call needs the address of the variable passed to a
+ * ref parameter. An inlined procedure works on the caller's variable
+ * directly unless it passes the parameter on to another call that
+ * needs the address.
+ *
+ * @param inliner decisions
+ * @param name called procedure
+ * @param param index of the parameter
+ * @return boolean - TRUE if the variable has to be in memory
+ **/
+boolean refEscapes(Inliner * inliner, Sym * name, int param)
+{
+	return argEscapes(calledProc(inliner, name), param);
+}
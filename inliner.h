@@ -0,0 +1,32 @@
+/*
+ * inliner.h -- selection of procedures to inline
+ */
+
+#ifndef _INLINER_H_
+#define _INLINER_H_
+
+#define DEFAULT_INLINE_THRESHOLD	24	/* nodes of an inlined body */
+
+typedef struct {
+	Absyn *procDec;
+	Entry *entry;
+	int state;		/* of the depth-first search */
+	boolean recursive;	/* on a cycle of the call graph */
+	boolean inlinable;
+	int size;		/* nodes of the body, inlined calls expanded */
+	boolean *refEscapes;	/* address of a ref parameter needed */
+} ProcInfo;
+
+typedef struct {
+	Table *globalTable;
+	int threshold;		/* largest size inlined, 0 turns inlining off */
+	ProcInfo *procs;	/* by the number of the procedure */
+	ProcInfo **stack;	/* procedures being searched */
+	int depth;
+} Inliner;
+
+Inliner *newInliner(Absyn * program, Table * globalTable, int threshold);
+Absyn *inlineCandidate(Inliner * inliner, Sym * name);
+boolean refEscapes(Inliner * inliner, Sym * name, int param);
+
+#endif				/* _INLINER_H_ */
@@ -0,0 +1,772 @@
+/*
+ * interp.c -- bytecode interpreter
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "varalloc.h"
+#include "interp.h"
+
+/*
+ * The checked program is translated into code for a stack machine.
+ * Data memory is an array of words and addresses are word indices.
+ * A procedure finds its variables at the offsets computed by allocVars,
+ * scaled to words: parameters above fp in the outgoing area of the
+ * caller, locals below fp, its own outgoing area at sp. Return
+ * addresses live on a separate call stack. Expressions are evaluated
+ * on an operand stack that is empty between statements, so a call
+ * never has to save it.
+ */
+
+#define MEMORY_WORDS	(1024 * 1024)	/* words of data memory */
+#define CALL_DEPTH	(256 * 1024)	/* maximum number of active calls */
+#define INITIAL_CODE	1024		/* code words, doubled as needed */
+
+/* opcodes, the operands follow in the next code words */
+#define OP_CONST	0	/* k: push k */
+#define OP_LOCAL	1	/* off: push mem[fp + off] */
+#define OP_ADDR		2	/* off: push fp + off */
+#define OP_LOADREF	3	/* off: push mem[mem[fp + off]] */
+#define OP_LOAD		4	/* replace an address by its contents */
+#define OP_SETLOCAL	5	/* off: pop into mem[fp + off] */
+#define OP_STORE	6	/* pop value and address, store */
+#define OP_INDEX	7	/* size scale: pop index, check it, add to address */
+#define OP_ADD		8
+#define OP_SUB		9
+#define OP_MUL		10
+#define OP_DIV		11
+#define OP_ADDI		12	/* k: add k to the top */
+#define OP_JMP		13	/* target */
+#define OP_JEQ		14	/* target: pop two and compare, same order */
+#define OP_JNE		15	/* as the ABSYN_OP_xxx relations */
+#define OP_JLT		16
+#define OP_JLE		17
+#define OP_JGT		18
+#define OP_JGE		19
+#define OP_ARG		20	/* off: pop into mem[sp + off] */
+#define OP_CALL		21	/* target */
+#define OP_ENTER	22	/* words: allocate the frame */
+#define OP_RET		23
+#define OP_PRINTI	24	/* pop value */
+#define OP_PRINTC	25	/* pop value */
+#define OP_READI	26	/* pop address */
+#define OP_READC	27	/* pop address */
+#define OP_TIME		28	/* pop address */
+#define OP_EXIT		29
+#define OP_HALT		30
+#define NUM_OPS		31
+
+static struct {
+	int operands;		/* number of operand words */
+	int effect;		/* change of the operand stack depth */
+	boolean jumps;		/* first operand is a code position */
+} opInfo[NUM_OPS] = {
+	{ 1,  1, FALSE },	/* CONST */
+	{ 1,  1, FALSE },	/* LOCAL */
+	{ 1,  1, FALSE },	/* ADDR */
+	{ 1,  1, FALSE },	/* LOADREF */
+	{ 0,  0, FALSE },	/* LOAD */
+	{ 1, -1, FALSE },	/* SETLOCAL */
+	{ 0, -2, FALSE },	/* STORE */
+	{ 2, -1, FALSE },	/* INDEX */
+	{ 0, -1, FALSE },	/* ADD */
+	{ 0, -1, FALSE },	/* SUB */
+	{ 0, -1, FALSE },	/* MUL */
+	{ 0, -1, FALSE },	/* DIV */
+	{ 1,  0, FALSE },	/* ADDI */
+	{ 1,  0, TRUE  },	/* JMP */
+	{ 1, -2, TRUE  },	/* JEQ */
+	{ 1, -2, TRUE  },	/* JNE */
+	{ 1, -2, TRUE  },	/* JLT */
+	{ 1, -2, TRUE  },	/* JLE */
+	{ 1, -2, TRUE  },	/* JGT */
+	{ 1, -2, TRUE  },	/* JGE */
+	{ 1, -1, FALSE },	/* ARG */
+	{ 1,  0, TRUE  },	/* CALL */
+	{ 1,  0, FALSE },	/* ENTER */
+	{ 0,  0, FALSE },	/* RET */
+	{ 0, -1, FALSE },	/* PRINTI */
+	{ 0, -1, FALSE },	/* PRINTC */
+	{ 0, -1, FALSE },	/* READI */
+	{ 0, -1, FALSE },	/* READC */
+	{ 0, -1, FALSE },	/* TIME */
+	{ 0,  0, FALSE },	/* EXIT */
+	{ 0,  0, FALSE },	/* HALT */
+};
+
+/* predefined procedures, -1 if they cannot be run */
+static struct {
+	char *name;
+	int op;
+} builtins[] = {
+	{ "printi",	OP_PRINTI },
+	{ "printc",	OP_PRINTC },
+	{ "readi",	OP_READI },
+	{ "readc",	OP_READC },
+	{ "exit",	OP_EXIT },
+	{ "time",	OP_TIME },
+	{ "clearAll",	-1 },
+	{ "setPixel",	-1 },
+	{ "drawLine",	-1 },
+	{ "drawCircle",	-1 },
+};
+
+#define NUM_BUILTINS	(sizeof(builtins) / sizeof(builtins[0]))
+
+typedef struct procStart {
+	Sym *name;
+	int pos;		/* code position of the first instruction */
+	struct procStart *next;
+} ProcStart;
+
+typedef struct callSite {
+	Sym *name;
+	int pos;		/* code position of the target operand */
+	struct callSite *next;
+} CallSite;
+
+typedef struct {
+	int *code;
+	int size;		/* code words in use */
+	int maxSize;		/* code words allocated */
+	int depth;		/* operand stack depth at the current position */
+	int maxDepth;		/* deepest operand stack */
+	Table *globalTable;
+	Table *localTable;
+	Sym *builtinSyms[NUM_BUILTINS];
+	ProcStart *procs;
+	CallSite *calls;
+} Compiler;
+
+/* a code word after threading */
+typedef union cell {
+	const void *label;	/* address of the code executing the opcode */
+	int op;			/* opcode, if there are no label addresses */
+	int arg;		/* operand */
+	union cell *target;	/* resolved code position */
+} Cell;
+
+typedef struct {
+	Cell *ret;
+	int fp;
+	int sp;
+} Frame;
+
+/**************************************************************/
+
+/* compiler */
+
+/**
+ * @brief Append an instruction with up to two operands
+ *
+ * @param c compiler
+ * @param op opcode
+ * @param a first operand, ignored if op has none
+ * @param b second operand, ignored if op has less than two
+ * @return int - code position of the first operand
+ **/
+static int emitOp(Compiler * c, int op, int a, int b)
+{
+	int *code;
+	int pos;
+
+	if (c->size + 3 > c->maxSize) {
+		code = (int *) allocate(2 * c->maxSize * sizeof(int));
+		memcpy(code, c->code, c->size * sizeof(int));
+		c->code = code;
+		c->maxSize *= 2;
+	}
+	c->code[c->size++] = op;
+	pos = c->size;
+	if (opInfo[op].operands > 0) {
+		c->code[c->size++] = a;
+	}
+	if (opInfo[op].operands > 1) {
+		c->code[c->size++] = b;
+	}
+	c->depth += opInfo[op].effect;
+	if (c->depth > c->maxDepth) {
+		c->maxDepth = c->depth;
+	}
+	return pos;
+}
+
+static void patch(Compiler * c, int pos, int target)
+{
+	if (pos >= 0) {
+		c->code[pos] = target;
+	}
+}
+
+static void emitCall(Compiler * c, Sym * name)
+{
+	CallSite *call;
+
+	call = (CallSite *) allocate(sizeof(CallSite));
+	call->name = name;
+	call->pos = emitOp(c, OP_CALL, 0, 0);
+	call->next = c->calls;
+	c->calls = call;
+}
+
+static Entry *varEntry(Compiler * c, Absyn * var)
+{
+	return lookup(c->localTable, var->u.simpleVar.name);
+}
+
+static void genExp(Compiler * c, Absyn * node);
+
+/* push the address of a variable */
+static void genAddr(Compiler * c, Absyn * node)
+{
+	Entry *entry;
+	Type *arrayType;
+	Absyn *index;
+	int scale;
+
+	if (node->type == ABSYN_SIMPLEVAR) {
+		entry = varEntry(c, node);
+		emitOp(c, entry->u.varEntry.isRef ? OP_LOCAL : OP_ADDR,
+		       entry->u.varEntry.offset / INT_BYTE_SIZE, 0);
+		return;
+	}
+	genAddr(c, ABSYN(node->u.arrayVar.var));
+	arrayType = node->typeGraph;
+	index = ABSYN(node->u.arrayVar.index);
+	scale = arrayType->u.arrayType.baseType->byte_size / INT_BYTE_SIZE;
+	if (index->type == ABSYN_INTEXP &&
+	    index->u.intExp.val >= 0 &&
+	    index->u.intExp.val < arrayType->u.arrayType.size) {
+		if (index->u.intExp.val != 0) {
+			emitOp(c, OP_ADDI, index->u.intExp.val * scale, 0);
+		}
+		return;
+	}
+	genExp(c, index);
+	emitOp(c, OP_INDEX, arrayType->u.arrayType.size, scale);
+}
+
+static void genExp(Compiler * c, Absyn * node)
+{
+	Entry *entry;
+	Absyn *var, *right;
+	int k;
+
+	switch (node->type) {
+	case ABSYN_INTEXP:
+		emitOp(c, OP_CONST, node->u.intExp.val, 0);
+		return;
+	case ABSYN_VAREXP:
+		var = ABSYN(node->u.varExp.var);
+		if (var->type == ABSYN_SIMPLEVAR) {
+			entry = varEntry(c, var);
+			emitOp(c, entry->u.varEntry.isRef ? OP_LOADREF : OP_LOCAL,
+			       entry->u.varEntry.offset / INT_BYTE_SIZE, 0);
+		} else {
+			genAddr(c, var);
+			emitOp(c, OP_LOAD, 0, 0);
+		}
+		return;
+	case ABSYN_OPEXP:
+		genExp(c, ABSYN(node->u.opExp.left));
+		right = ABSYN(node->u.opExp.right);
+		if (right->type == ABSYN_INTEXP &&
+		    (node->u.opExp.op == ABSYN_OP_ADD ||
+		     node->u.opExp.op == ABSYN_OP_SUB)) {
+			k = right->u.intExp.val;
+			if (node->u.opExp.op == ABSYN_OP_SUB) {
+				k = (int) (0u - (unsigned) k);
+			}
+			emitOp(c, OP_ADDI, k, 0);
+			return;
+		}
+		genExp(c, right);
+		switch (node->u.opExp.op) {
+		case ABSYN_OP_ADD:	emitOp(c, OP_ADD, 0, 0); return;
+		case ABSYN_OP_SUB:	emitOp(c, OP_SUB, 0, 0); return;
+		case ABSYN_OP_MUL:	emitOp(c, OP_MUL, 0, 0); return;
+		case ABSYN_OP_DIV:	emitOp(c, OP_DIV, 0, 0); return;
+		}
+		error("comparison used as value in line %d", node->line);
+	}
+	error("unknown expression type %d in genExp", node->type);
+}
+
+static int negateCond(int cond)
+{
+	switch (cond) {
+	case ABSYN_OP_EQU:	return ABSYN_OP_NEQ;
+	case ABSYN_OP_NEQ:	return ABSYN_OP_EQU;
+	case ABSYN_OP_LST:	return ABSYN_OP_GRE;
+	case ABSYN_OP_LSE:	return ABSYN_OP_GRT;
+	case ABSYN_OP_GRT:	return ABSYN_OP_LSE;
+	case ABSYN_OP_GRE:	return ABSYN_OP_LST;
+	}
+	error("unknown relation %d in negateCond", cond);
+	return cond;
+}
+
+/**
+ * @brief Jump if a test evaluates to jumpIf, fall through otherwise
+ *
+ * @param c compiler
+ * @param test comparison or folded constant
+ * @param jumpIf truth value that jumps
+ * @return int - code position of the jump target to patch, -1 if
+ * the test never jumps
+ **/
+static int genCond(Compiler * c, Absyn * test, boolean jumpIf)
+{
+	int cond;
+
+	if (test->type == ABSYN_INTEXP) {
+		if ((test->u.intExp.val != 0) == jumpIf) {
+			return emitOp(c, OP_JMP, 0, 0);
+		}
+		return -1;
+	}
+	genExp(c, ABSYN(test->u.opExp.left));
+	genExp(c, ABSYN(test->u.opExp.right));
+	cond = jumpIf ? test->u.opExp.op : negateCond(test->u.opExp.op);
+	return emitOp(c, OP_JEQ + cond, 0, 0);
+}
+
+static void genCall(Compiler * c, Absyn * node)
+{
+	Entry *entry;
+	ParamTypes *params;
+	Absyn *args, *arg;
+	int builtin, i;
+
+	for (builtin = 0; builtin < NUM_BUILTINS; builtin++) {
+		if (c->builtinSyms[builtin] == node->u.callStm.name) {
+			break;
+		}
+	}
+	if (builtin < NUM_BUILTINS && builtins[builtin].op < 0) {
+		error("procedure '%s' cannot be run in line %d",
+		      builtins[builtin].name, node->line);
+	}
+	entry = lookup(c->globalTable, node->u.callStm.name);
+	params = entry->u.procEntry.paramTypes;
+	args = ABSYN(node->u.callStm.args);
+	for (i = 0; !params->isEmpty; i++) {
+		arg = ABSYN(args->u.expList.items[i]);
+		if (params->isRef) {
+			genAddr(c, ABSYN(arg->u.varExp.var));
+		} else {
+			genExp(c, arg);
+		}
+		/* predefined procedures take their argument from the stack */
+		if (builtin == NUM_BUILTINS) {
+			emitOp(c, OP_ARG, params->offset / INT_BYTE_SIZE, 0);
+		}
+		params = params->next;
+	}
+	if (builtin < NUM_BUILTINS) {
+		emitOp(c, builtins[builtin].op, 0, 0);
+	} else {
+		emitCall(c, node->u.callStm.name);
+	}
+}
+
+static void genStm(Compiler * c, Absyn * node)
+{
+	Entry *entry;
+	Absyn *var;
+	int pos1, pos2, start, i;
+
+	switch (node->type) {
+	case ABSYN_EMPTYSTM:
+		break;
+	case ABSYN_COMPSTM:
+		genStm(c, ABSYN(node->u.compStm.stms));
+		break;
+	case ABSYN_STMLIST:
+		for (i = 0; i < node->u.stmList.count; i++) {
+			genStm(c, ABSYN(node->u.stmList.items[i]));
+		}
+		break;
+	case ABSYN_ASSIGNSTM:
+		var = ABSYN(node->u.assignStm.var);
+		if (var->type == ABSYN_SIMPLEVAR &&
+		    !(entry = varEntry(c, var))->u.varEntry.isRef) {
+			genExp(c, ABSYN(node->u.assignStm.exp));
+			emitOp(c, OP_SETLOCAL,
+			       entry->u.varEntry.offset / INT_BYTE_SIZE, 0);
+		} else {
+			genAddr(c, var);
+			genExp(c, ABSYN(node->u.assignStm.exp));
+			emitOp(c, OP_STORE, 0, 0);
+		}
+		break;
+	case ABSYN_IFSTM:
+		pos1 = genCond(c, ABSYN(node->u.ifStm.test), FALSE);
+		genStm(c, ABSYN(node->u.ifStm.thenPart));
+		if (ABSYN(node->u.ifStm.elsePart)->type == ABSYN_EMPTYSTM) {
+			patch(c, pos1, c->size);
+		} else {
+			pos2 = emitOp(c, OP_JMP, 0, 0);
+			patch(c, pos1, c->size);
+			genStm(c, ABSYN(node->u.ifStm.elsePart));
+			patch(c, pos2, c->size);
+		}
+		break;
+	case ABSYN_WHILESTM:
+		/* test at the bottom: one jump per iteration */
+		pos1 = emitOp(c, OP_JMP, 0, 0);
+		start = c->size;
+		genStm(c, ABSYN(node->u.whileStm.body));
+		patch(c, pos1, c->size);
+		patch(c, genCond(c, ABSYN(node->u.whileStm.test), TRUE), start);
+		break;
+	case ABSYN_CALLSTM:
+		genCall(c, node);
+		break;
+	default:
+		error("unknown statement type %d in genStm", node->type);
+	}
+}
+
+static void genProc(Compiler * c, Absyn * procDec)
+{
+	ProcStart *proc;
+	Entry *entry;
+	int argSize;
+
+	entry = lookup(c->globalTable, procDec->u.procDec.name);
+	proc = (ProcStart *) allocate(sizeof(ProcStart));
+	proc->name = procDec->u.procDec.name;
+	proc->pos = c->size;
+	proc->next = c->procs;
+	c->procs = proc;
+	c->localTable = entry->u.procEntry.localTable;
+	argSize = entry->u.procEntry.argSize;
+	if (argSize < 0) {
+		argSize = 0;
+	}
+	emitOp(c, OP_ENTER,
+	       (entry->u.procEntry.localVarSize + argSize) / INT_BYTE_SIZE, 0);
+	genStm(c, ABSYN(procDec->u.procDec.body));
+	emitOp(c, OP_RET, 0, 0);
+}
+
+/**
+ * @brief Translate all procedures, the code starts with a call of main
+ *
+ * @param c compiler, filled in
+ * @param program checked abstract syntax with allocated variables
+ * @param globalTable symbol table
+ * @return void
+ **/
+static void compile(Compiler * c, Absyn * program, Table * globalTable)
+{
+	ProcStart *proc;
+	CallSite *call;
+	Absyn *node;
+	int i;
+
+	memset(c, 0, sizeof(Compiler));
+	c->maxSize = INITIAL_CODE;
+	c->code = (int *) allocate(c->maxSize * sizeof(int));
+	c->globalTable = globalTable;
+	for (i = 0; i < NUM_BUILTINS; i++) {
+		c->builtinSyms[i] = newSym(builtins[i].name);
+	}
+	emitCall(c, newSym("main"));
+	emitOp(c, OP_HALT, 0, 0);
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		if (node->type == ABSYN_PROCDEC) {
+			genProc(c, node);
+		}
+	}
+	for (call = c->calls; call != NULL; call = call->next) {
+		for (proc = c->procs; proc->name != call->name;
+		     proc = proc->next) ;
+		patch(c, call->pos, proc->pos);
+	}
+}
+
+/**************************************************************/
+
+/* interpreter */
+
+#ifdef __GNUC__
+#define THREADED		/* labels as values: direct threading */
+#endif
+
+#ifdef THREADED
+#define INSTR(op)	L_##op:
+#define NEXT		goto *(pc++)->label
+#else
+#define INSTR(op)	case op:
+#define NEXT		continue
+#endif
+
+/**
+ * @brief Replace opcodes by the address of the code that executes
+ * them and jump operands by pointers into the threaded code
+ *
+ * @param c compiled program
+ * @param labels code addresses indexed by opcode, NULL to keep opcodes
+ * @return Cell* - threaded code
+ **/
+static Cell *thread(Compiler * c, const void **labels)
+{
+	Cell *cells;
+	int pos, op;
+
+	cells = (Cell *) allocate(c->size * sizeof(Cell));
+	pos = 0;
+	while (pos < c->size) {
+		op = c->code[pos];
+		if (labels != NULL) {
+			cells[pos].label = labels[op];
+		} else {
+			cells[pos].op = op;
+		}
+		if (opInfo[op].operands > 0) {
+			if (opInfo[op].jumps) {
+				cells[pos + 1].target = cells + c->code[pos + 1];
+			} else {
+				cells[pos + 1].arg = c->code[pos + 1];
+			}
+		}
+		if (opInfo[op].operands > 1) {
+			cells[pos + 2].arg = c->code[pos + 2];
+		}
+		pos += 1 + opInfo[op].operands;
+	}
+	return cells;
+}
+
+/**
+ * @brief Execute a compiled program
+ *
+ * @param c compiled program
+ * @return int - exit status, 1 if the program failed
+ **/
+static int execute(Compiler * c)
+{
+#ifdef THREADED
+	static const void *labels[NUM_OPS] = {
+		&&L_OP_CONST, &&L_OP_LOCAL, &&L_OP_ADDR, &&L_OP_LOADREF,
+		&&L_OP_LOAD, &&L_OP_SETLOCAL, &&L_OP_STORE, &&L_OP_INDEX,
+		&&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, &&L_OP_DIV, &&L_OP_ADDI,
+		&&L_OP_JMP, &&L_OP_JEQ, &&L_OP_JNE, &&L_OP_JLT, &&L_OP_JLE,
+		&&L_OP_JGT, &&L_OP_JGE, &&L_OP_ARG, &&L_OP_CALL, &&L_OP_ENTER,
+		&&L_OP_RET, &&L_OP_PRINTI, &&L_OP_PRINTC, &&L_OP_READI,
+		&&L_OP_READC, &&L_OP_TIME, &&L_OP_EXIT, &&L_OP_HALT,
+	};
+#else
+	static const void **labels = NULL;
+#endif
+	Cell *pc;
+	Frame *frames, *frame, *lastFrame;
+	int *mem, *stack, *tos;
+	int fp, sp, i, status;
+	time_t startTime;
+
+	mem = (int *) calloc(MEMORY_WORDS, sizeof(int));
+	frames = (Frame *) malloc(CALL_DEPTH * sizeof(Frame));
+	stack = (int *) malloc((c->maxDepth + 1) * sizeof(int));
+	if (mem == NULL || frames == NULL || stack == NULL) {
+		error("out of memory");
+	}
+	frame = frames;
+	lastFrame = frames + CALL_DEPTH;
+	tos = stack;
+	fp = MEMORY_WORDS;
+	sp = MEMORY_WORDS;
+	startTime = time(NULL);
+	status = 0;
+	pc = thread(c, labels);
+
+#ifdef THREADED
+	NEXT;
+#else
+	for (;;) {
+		switch ((pc++)->op) {
+#endif
+	INSTR(OP_CONST)
+		*++tos = (pc++)->arg;
+		NEXT;
+	INSTR(OP_LOCAL)
+		*++tos = mem[fp + (pc++)->arg];
+		NEXT;
+	INSTR(OP_ADDR)
+		*++tos = fp + (pc++)->arg;
+		NEXT;
+	INSTR(OP_LOADREF)
+		*++tos = mem[mem[fp + (pc++)->arg]];
+		NEXT;
+	INSTR(OP_LOAD)
+		*tos = mem[*tos];
+		NEXT;
+	INSTR(OP_SETLOCAL)
+		mem[fp + (pc++)->arg] = *tos--;
+		NEXT;
+	INSTR(OP_STORE)
+		mem[tos[-1]] = tos[0];
+		tos -= 2;
+		NEXT;
+	INSTR(OP_INDEX)
+		i = *tos--;
+		if ((unsigned) i >= (unsigned) pc[0].arg) {
+			fflush(stdout);
+			fprintf(stderr, "Error: index out of bounds\n");
+			status = 1;
+			goto done;
+		}
+		*tos += i * pc[1].arg;
+		pc += 2;
+		NEXT;
+	INSTR(OP_ADD)
+		tos--;
+		tos[0] = (int) ((unsigned) tos[0] + (unsigned) tos[1]);
+		NEXT;
+	INSTR(OP_SUB)
+		tos--;
+		tos[0] = (int) ((unsigned) tos[0] - (unsigned) tos[1]);
+		NEXT;
+	INSTR(OP_MUL)
+		tos--;
+		tos[0] = (int) ((unsigned) tos[0] * (unsigned) tos[1]);
+		NEXT;
+	INSTR(OP_DIV)
+		tos--;
+		if (tos[1] == 0) {
+			fflush(stdout);
+			fprintf(stderr, "Error: division by zero\n");
+			status = 1;
+			goto done;
+		}
+		if (tos[1] == -1) {
+			/* 0x80000000 / -1 wraps around */
+			tos[0] = (int) (0u - (unsigned) tos[0]);
+		} else {
+			tos[0] /= tos[1];
+		}
+		NEXT;
+	INSTR(OP_ADDI)
+		*tos = (int) ((unsigned) *tos + (unsigned) (pc++)->arg);
+		NEXT;
+	INSTR(OP_JMP)
+		pc = pc->target;
+		NEXT;
+	INSTR(OP_JEQ)
+		tos -= 2;
+		pc = tos[1] == tos[2] ? pc->target : pc + 1;
+		NEXT;
+	INSTR(OP_JNE)
+		tos -= 2;
+		pc = tos[1] != tos[2] ? pc->target : pc + 1;
+		NEXT;
+	INSTR(OP_JLT)
+		tos -= 2;
+		pc = tos[1] < tos[2] ? pc->target : pc + 1;
+		NEXT;
+	INSTR(OP_JLE)
+		tos -= 2;
+		pc = tos[1] <= tos[2] ? pc->target : pc + 1;
+		NEXT;
+	INSTR(OP_JGT)
+		tos -= 2;
+		pc = tos[1] > tos[2] ? pc->target : pc + 1;
+		NEXT;
+	INSTR(OP_JGE)
+		tos -= 2;
+		pc = tos[1] >= tos[2] ? pc->target : pc + 1;
+		NEXT;
+	INSTR(OP_ARG)
+		mem[sp + (pc++)->arg] = *tos--;
+		NEXT;
+	INSTR(OP_CALL)
+		if (frame == lastFrame) {
+			goto overflow;
+		}
+		frame->ret = pc + 1;
+		frame->fp = fp;
+		frame->sp = sp;
+		frame++;
+		fp = sp;
+		pc = pc->target;
+		NEXT;
+	INSTR(OP_ENTER)
+		sp = fp - (pc++)->arg;
+		if (sp < 0) {
+			goto overflow;
+		}
+		NEXT;
+	INSTR(OP_RET)
+		frame--;
+		pc = frame->ret;
+		fp = frame->fp;
+		sp = frame->sp;
+		NEXT;
+	INSTR(OP_PRINTI)
+		printf("%d", *tos--);
+		NEXT;
+	INSTR(OP_PRINTC)
+		putchar(*tos--);
+		NEXT;
+	INSTR(OP_READI)
+		fflush(stdout);
+		if (scanf("%d", &i) != 1) {
+			error("readi: no integer on input");
+		}
+		mem[*tos--] = i;
+		NEXT;
+	INSTR(OP_READC)
+		fflush(stdout);
+		mem[*tos--] = getchar();
+		NEXT;
+	INSTR(OP_TIME)
+		mem[*tos--] = (int) (time(NULL) - startTime);
+		NEXT;
+	INSTR(OP_EXIT)
+		goto done;
+	INSTR(OP_HALT)
+		goto done;
+#ifndef THREADED
+		}
+	}
+#endif
+
+overflow:
+	fflush(stdout);
+	fprintf(stderr, "Error: stack overflow\n");
+	status = 1;
+done:
+	fflush(stdout);
+	free(stack);
+	free(frames);
+	free(mem);
+	return status;
+}
+
+/**
+ * @brief Run a program without generating assembly: the procedures
+ * are compiled to bytecode which is interpreted directly
+ *
+ * @param program checked abstract syntax with allocated variables
+ * @param globalTable symbol table
+ * @return int - exit status of the program
+ **/
+int runProgram(Absyn * program, Table * globalTable)
+{
+	Compiler compiler;
+
+	compile(&compiler, program, globalTable);
+	return execute(&compiler);
+}
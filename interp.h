@@ -0,0 +1,10 @@
+/*
+ * interp.h -- bytecode interpreter
+ */
+
+#ifndef _INTERP_H_
+#define _INTERP_H_
+
+int runProgram(Absyn * program, Table * globalTable);
+
+#endif				/* _INTERP_H_ */
@@ -0,0 +1,1242 @@
+/*
+ * ir.c -- intermediate representation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "inliner.h"
+#include "alias.h"
+#include "ir.h"
+
+#define LV_VREG		0	/* variable lives in a virtual register */
+#define LV_MEM		1	/* variable lives in memory at base + offset */
+
+#define FITS_IMM(i)	((i) >= -32768 && (i) <= 32767)
+
+typedef struct {
+	int kind;
+	int vreg;		/* the variable, or the base address */
+	int offset;		/* offset from base address */
+} LValue;
+
+typedef struct {
+	Sym *sym;
+	int vreg;		/* VREG_NONE if the variable stays in memory */
+	boolean isRef;		/* vreg holds the address of the variable */
+	boolean addrTaken;	/* variable is passed as ref argument */
+} VarSlot;
+
+typedef struct {
+	IrProc *proc;
+	Table *localTable;
+	Table *globalTable;
+	VarSlot *vars;		/* parameters and locals, open addressing */
+	int varMask;
+	Inliner *inliner;
+	Aliases *aliases;
+	Absyn *procDec;		/* procedure being built */
+	Instr *bodyStart;	/* last instruction before the body, or NULL */
+	int entryLabel;		/* target of tail calls, -1 if none yet */
+} Builder;
+
+/**************************************************************/
+
+int newVreg(IrProc * proc, int home, Sym * name)
+{
+	Vreg *vregs;
+
+	if (proc->numVregs == proc->maxVregs) {
+		proc->maxVregs = 2 * proc->maxVregs + 16;
+		vregs = (Vreg *) allocate(proc->maxVregs * sizeof(Vreg));
+		memcpy(vregs, proc->vregs, proc->numVregs * sizeof(Vreg));
+		proc->vregs = vregs;
+	}
+	proc->vregs[proc->numVregs].home = home;
+	proc->vregs[proc->numVregs].name = name;
+	proc->vregs[proc->numVregs].reg = 0;
+	/* variables of inlined procedures have no frame slot */
+	proc->vregs[proc->numVregs].inFrame = name != NULL && home != NO_HOME;
+	proc->vregs[proc->numVregs].region = REGION_NONE;
+	return proc->numVregs++;
+}
+
+int newLabel(IrProc * proc)
+{
+	return proc->numLabels++;
+}
+
+Instr *newInstr(int op, int dst, int src1, int src2, int imm)
+{
+	Instr *instr;
+
+	instr = (Instr *) allocate(sizeof(Instr));
+	instr->op = op;
+	instr->dst = dst;
+	instr->src1 = src1;
+	instr->src2 = src2;
+	instr->imm = imm;
+	instr->cond = 0;
+	instr->label = -1;
+	instr->sym = NULL;
+	instr->block = NULL;
+	instr->prev = NULL;
+	instr->next = NULL;
+	return instr;
+}
+
+void appendInstr(IrProc * proc, Instr * instr)
+{
+	instr->prev = proc->last;
+	instr->next = NULL;
+	if (proc->last == NULL) {
+		proc->first = instr;
+	} else {
+		proc->last->next = instr;
+	}
+	proc->last = instr;
+}
+
+void insertBefore(IrProc * proc, Instr * pos, Instr * instr)
+{
+	if (pos == NULL) {
+		appendInstr(proc, instr);
+		return;
+	}
+	instr->next = pos;
+	instr->prev = pos->prev;
+	instr->block = pos->block;
+	if (pos->block != NULL && pos->block->first == pos) {
+		pos->block->first = instr;
+	}
+	if (pos->prev == NULL) {
+		proc->first = instr;
+	} else {
+		pos->prev->next = instr;
+	}
+	pos->prev = instr;
+}
+
+/* the new instruction belongs to the block of pos */
+void insertAfter(IrProc * proc, Instr * pos, Instr * instr)
+{
+	instr->prev = pos;
+	instr->next = pos->next;
+	instr->block = pos->block;
+	if (pos->block != NULL && pos->block->last == pos) {
+		pos->block->last = instr;
+	}
+	if (pos->next == NULL) {
+		proc->last = instr;
+	} else {
+		pos->next->prev = instr;
+	}
+	pos->next = instr;
+}
+
+void removeInstr(IrProc * proc, Instr * instr)
+{
+	Block *block;
+
+	block = instr->block;
+	if (block != NULL) {
+		if (block->first == instr && block->last == instr) {
+			block->first = NULL;
+			block->last = NULL;
+		} else if (block->first == instr) {
+			block->first = instr->next;
+		} else if (block->last == instr) {
+			block->last = instr->prev;
+		}
+	}
+	if (instr->prev == NULL) {
+		proc->first = instr->next;
+	} else {
+		instr->prev->next = instr->next;
+	}
+	if (instr->next == NULL) {
+		proc->last = instr->prev;
+	} else {
+		instr->next->prev = instr->prev;
+	}
+}
+
+/**
+ * @brief The region the result of an instruction can point to
+ *
+ * @param proc procedure
+ * @param instr instruction defining a vreg
+ * @param r1 region of the first operand, REGION_NONE if there is none
+ * @param r2 region of the second operand, REGION_NONE if there is none
+ * @return int - region of the result
+ **/
+int resultRegion(IrProc * proc, Instr * instr, int r1, int r2)
+{
+	switch (instr->op) {
+	case IR_LDC:
+		return REGION_NONE;
+	case IR_MOV:
+		return r1;
+	case IR_LDW:
+		/* only parameter slots in the frame hold addresses */
+		if (proc->vregs[instr->dst].name != NULL) {
+			return proc->vregs[instr->dst].region;
+		}
+		return r1 == REGION_FRAME ? REGION_ANY : REGION_NONE;
+	case IR_ADD:
+		if (r2 == REGION_NONE) {
+			return r1;
+		}
+		return r1 == REGION_NONE ? r2 : REGION_ANY;
+	case IR_SUB:
+		return r2 == REGION_NONE ? r1 : REGION_ANY;
+	}
+	/* shifted or multiplied addresses are no addresses any more */
+	return r1 == REGION_NONE && r2 == REGION_NONE ? REGION_NONE : REGION_ANY;
+}
+
+/* accesses through addresses of the two regions may hit the same word */
+boolean regionsOverlap(int r1, int r2)
+{
+	if (r1 == REGION_NONE || r2 == REGION_NONE) {
+		/* not an address as far as known */
+		return TRUE;
+	}
+	return r1 == REGION_ANY || r2 == REGION_ANY || r1 == r2;
+}
+
+boolean definesVreg(Instr * instr)
+{
+	switch (instr->op) {
+	case IR_LDC:
+	case IR_MOV:
+	case IR_ADD:
+	case IR_SUB:
+	case IR_MUL:
+	case IR_DIV:
+	case IR_SLL:
+	case IR_LDW:
+		return TRUE;
+	}
+	return FALSE;
+}
+
+int usedVregs(Instr * instr, int used[2])
+{
+	int n;
+
+	n = 0;
+	switch (instr->op) {
+	case IR_MOV:
+	case IR_LDW:
+	case IR_CHK:
+		used[n++] = instr->src1;
+		break;
+	case IR_ADD:
+	case IR_SUB:
+	case IR_MUL:
+	case IR_DIV:
+	case IR_SLL:
+	case IR_STW:
+	case IR_BR:
+		used[n++] = instr->src1;
+		if (instr->src2 != VREG_NONE) {
+			used[n++] = instr->src2;
+		}
+		break;
+	}
+	return n;
+}
+
+/**************************************************************/
+
+static void emit(Builder * b, Instr * instr)
+{
+	appendInstr(b->proc, instr);
+}
+
+static int emitOp(Builder * b, int op, int src1, int src2, int imm)
+{
+	int dst;
+
+	dst = newVreg(b->proc, NO_HOME, NULL);
+	emit(b, newInstr(op, dst, src1, src2, imm));
+	return dst;
+}
+
+/* multiplications by powers of two become shifts */
+static int emitMulImm(Builder * b, int src, int imm)
+{
+	int shift;
+
+	for (shift = 1; shift < 31; shift++) {
+		if (imm == 1 << shift) {
+			return emitOp(b, IR_SLL, src, VREG_NONE, shift);
+		}
+	}
+	return emitOp(b, IR_MUL, src, VREG_NONE, imm);
+}
+
+static void emitBranch(Builder * b, int cond, int src1, int src2, int label)
+{
+	Instr *instr;
+
+	instr = newInstr(IR_BR, VREG_NONE, src1, src2, 0);
+	instr->cond = cond;
+	instr->label = label;
+	emit(b, instr);
+}
+
+static void emitJump(Builder * b, int label)
+{
+	Instr *instr;
+
+	instr = newInstr(IR_JMP, VREG_NONE, VREG_NONE, VREG_NONE, 0);
+	instr->label = label;
+	emit(b, instr);
+}
+
+static void emitLabel(Builder * b, int label)
+{
+	Instr *instr;
+
+	instr = newInstr(IR_LABEL, VREG_NONE, VREG_NONE, VREG_NONE, 0);
+	instr->label = label;
+	emit(b, instr);
+}
+
+/**************************************************************/
+
+static VarSlot *findVar(Builder * b, Sym * sym)
+{
+	unsigned i;
+
+	i = symToStamp(sym) & b->varMask;
+	while (b->vars[i].sym != NULL && b->vars[i].sym != sym) {
+		i = (i + 1) & b->varMask;
+	}
+	return &b->vars[i];
+}
+
+/*
+ * A scalar whose address is passed to a ref parameter has to stay
+ * in memory, every other int variable becomes a virtual register.
+ */
+static void findAddrTaken(Builder * b, Absyn * node)
+{
+	Entry *entry;
+	ParamTypes *params;
+	Absyn *args, *var;
+	VarSlot *slot;
+	int i;
+
+	switch (node->type) {
+	case ABSYN_COMPSTM:
+		findAddrTaken(b, ABSYN(node->u.compStm.stms));
+		break;
+	case ABSYN_IFSTM:
+		findAddrTaken(b, ABSYN(node->u.ifStm.thenPart));
+		findAddrTaken(b, ABSYN(node->u.ifStm.elsePart));
+		break;
+	case ABSYN_WHILESTM:
+		findAddrTaken(b, ABSYN(node->u.whileStm.body));
+		break;
+	case ABSYN_STMLIST:
+		for (i = 0; i < node->u.stmList.count; i++) {
+			findAddrTaken(b, ABSYN(node->u.stmList.items[i]));
+		}
+		break;
+	case ABSYN_CALLSTM:
+		entry = lookup(b->globalTable, node->u.callStm.name);
+		params = entry->u.procEntry.paramTypes;
+		args = ABSYN(node->u.callStm.args);
+		for (i = 0; !params->isEmpty; i++) {
+			var = ABSYN(ABSYN(args->u.expList.items[i])->u.varExp.var);
+			if (params->isRef && var->type == ABSYN_SIMPLEVAR &&
+			    refEscapes(b->inliner, node->u.callStm.name, i)) {
+				slot = findVar(b, var->u.simpleVar.name);
+				slot->sym = var->u.simpleVar.name;
+				slot->addrTaken = TRUE;
+			}
+			params = params->next;
+		}
+		break;
+	}
+}
+
+static void newVarMap(Builder * b, Absyn * procDec)
+{
+	int n, size;
+
+	n = ABSYN(procDec->u.procDec.params)->u.decList.count +
+	    ABSYN(procDec->u.procDec.decls)->u.decList.count;
+	size = 8;
+	while (size < 2 * n) {
+		size *= 2;
+	}
+	b->vars = (VarSlot *) allocate(size * sizeof(VarSlot));
+	memset(b->vars, 0, size * sizeof(VarSlot));
+	b->varMask = size - 1;
+}
+
+static void promoteVar(Builder * b, Sym * name, Entry * entry)
+{
+	VarSlot *slot;
+
+	slot = findVar(b, name);
+	slot->sym = name;
+	slot->isRef = entry->u.varEntry.isRef;
+	slot->vreg = VREG_NONE;
+	if (entry->u.varEntry.isRef ||
+	    (entry->u.varEntry.type->kind == TYPE_KIND_PRIMITIVE &&
+	     !slot->addrTaken)) {
+		slot->vreg = newVreg(b->proc, entry->u.varEntry.offset, name);
+	}
+}
+
+static void promoteVars(Builder * b, Absyn * procDec)
+{
+	Absyn *decs;
+	Entry *entry;
+	VarSlot *slot;
+	Sym *name;
+	int i;
+
+	/* parameters: ref addresses and unaliased ints are loaded on entry */
+	decs = ABSYN(procDec->u.procDec.params);
+	for (i = 0; i < decs->u.decList.count; i++) {
+		name = ABSYN(decs->u.decList.items[i])->u.parDec.name;
+		entry = lookup(b->localTable, name);
+		promoteVar(b, name, entry);
+		slot = findVar(b, name);
+		if (slot->isRef) {
+			b->proc->vregs[slot->vreg].region =
+			    isUnaliased(b->aliases, b->proc->name, i) ?
+			    REGION_PARAM(i) : REGION_CALLER;
+		}
+		if (slot->vreg != VREG_NONE) {
+			emit(b, newInstr(IR_LDW, slot->vreg, VREG_FP, VREG_NONE,
+					 entry->u.varEntry.offset));
+		}
+	}
+
+	/* local variables */
+	decs = ABSYN(procDec->u.procDec.decls);
+	for (i = 0; i < decs->u.decList.count; i++) {
+		name = ABSYN(decs->u.decList.items[i])->u.varDec.name;
+		entry = lookup(b->localTable, name);
+		promoteVar(b, name, entry);
+	}
+}
+
+/**************************************************************/
+
+/*
+ * Sethi-Ullman numbering: the number of registers needed to
+ * evaluate an expression without spilling.
+ */
+static int need(Builder * b, Absyn * node);
+
+static boolean isImmOperand(Absyn * node)
+{
+	return node->type == ABSYN_INTEXP && FITS_IMM(node->u.intExp.val);
+}
+
+static int needVar(Builder * b, Absyn * var)
+{
+	VarSlot *slot;
+	int n;
+
+	if (var->type == ABSYN_SIMPLEVAR) {
+		slot = findVar(b, var->u.simpleVar.name);
+		return (slot->vreg != VREG_NONE && !slot->isRef) ? 0 : 1;
+	}
+	n = need(b, ABSYN(var->u.arrayVar.index)) + 1;
+	return n > needVar(b, ABSYN(var->u.arrayVar.var)) ? n : needVar(b, ABSYN(var->u.arrayVar.var));
+}
+
+static int need(Builder * b, Absyn * node)
+{
+	int l, r;
+
+	switch (node->type) {
+	case ABSYN_INTEXP:
+		return node->u.intExp.val == 0 ? 0 : 1;
+	case ABSYN_VAREXP:
+		return needVar(b, ABSYN(node->u.varExp.var));
+	case ABSYN_OPEXP:
+		l = need(b, ABSYN(node->u.opExp.left));
+		if (isImmOperand(ABSYN(node->u.opExp.right))) {
+			return l > 0 ? l : 1;
+		}
+		r = need(b, ABSYN(node->u.opExp.right));
+		if (l == r) {
+			return l + 1;
+		}
+		return l > r ? l : r;
+	}
+	return 1;
+}
+
+/*
+ * Operands are only evaluated out of order if at most one of them can
+ * stop the program, so the same error is always reported first.
+ */
+static boolean canTrap(Absyn * node)
+{
+	Absyn *var, *index;
+
+	switch (node->type) {
+	case ABSYN_VAREXP:
+		var = ABSYN(node->u.varExp.var);
+		while (var->type == ABSYN_ARRAYVAR) {
+			/* genVar checks all but constant indices in range */
+			index = ABSYN(var->u.arrayVar.index);
+			if (index->type != ABSYN_INTEXP ||
+			    index->u.intExp.val < 0 ||
+			    index->u.intExp.val >=
+			    var->typeGraph->u.arrayType.size) {
+				return TRUE;
+			}
+			var = ABSYN(var->u.arrayVar.var);
+		}
+		return FALSE;
+	case ABSYN_OPEXP:
+		if (node->u.opExp.op == ABSYN_OP_DIV &&
+		    (ABSYN(node->u.opExp.right)->type != ABSYN_INTEXP ||
+		     ABSYN(node->u.opExp.right)->u.intExp.val == 0)) {
+			return TRUE;
+		}
+		return canTrap(ABSYN(node->u.opExp.left)) || canTrap(ABSYN(node->u.opExp.right));
+	}
+	return FALSE;
+}
+
+static int genExp(Builder * b, Absyn * node);
+
+static LValue genVar(Builder * b, Absyn * node)
+{
+	LValue lv, base;
+	VarSlot *slot;
+	Entry *entry;
+	Type *arrayType;
+	Absyn *index;
+	int i, scaled, elemSize;
+
+	if (node->type == ABSYN_SIMPLEVAR) {
+		slot = findVar(b, node->u.simpleVar.name);
+		if (slot->vreg != VREG_NONE) {
+			lv.kind = slot->isRef ? LV_MEM : LV_VREG;
+			lv.vreg = slot->vreg;
+			lv.offset = 0;
+		} else {
+			entry = lookup(b->localTable, node->u.simpleVar.name);
+			lv.kind = LV_MEM;
+			lv.vreg = VREG_FP;
+			lv.offset = entry->u.varEntry.offset;
+		}
+		return lv;
+	}
+
+	/* array element: base address, bounds check, scaled index */
+	base = genVar(b, ABSYN(node->u.arrayVar.var));
+	arrayType = node->typeGraph;
+	index = ABSYN(node->u.arrayVar.index);
+	lv = base;
+	if (index->type == ABSYN_INTEXP &&
+	    index->u.intExp.val >= 0 &&
+	    index->u.intExp.val < arrayType->u.arrayType.size) {
+		lv.offset += index->u.intExp.val *
+		    arrayType->u.arrayType.baseType->byte_size;
+		return lv;
+	}
+	i = genExp(b, index);
+	emit(b, newInstr(IR_CHK, VREG_NONE, i, VREG_NONE,
+			 arrayType->u.arrayType.size));
+	elemSize = arrayType->u.arrayType.baseType->byte_size;
+	if (FITS_IMM(elemSize)) {
+		scaled = emitMulImm(b, i, elemSize);
+	} else {
+		scaled = emitOp(b, IR_MUL, i,
+				emitOp(b, IR_LDC, VREG_NONE, VREG_NONE, elemSize), 0);
+	}
+	lv.vreg = emitOp(b, IR_ADD, base.vreg, scaled, 0);
+	return lv;
+}
+
+/* keep offsets within the 16 bit displacement of loads and stores */
+static LValue nearVar(Builder * b, Absyn * node)
+{
+	LValue lv;
+	int offset;
+
+	lv = genVar(b, node);
+	if (lv.kind == LV_MEM && !FITS_IMM(lv.offset)) {
+		offset = emitOp(b, IR_LDC, VREG_NONE, VREG_NONE, lv.offset);
+		lv.vreg = emitOp(b, IR_ADD, lv.vreg, offset, 0);
+		lv.offset = 0;
+	}
+	return lv;
+}
+
+static void genOperands(Builder * b, Absyn * left, Absyn * right,
+			int *l, int *r)
+{
+	if (isImmOperand(right)) {
+		*l = genExp(b, left);
+		*r = VREG_NONE;
+		return;
+	}
+	if (need(b, right) > need(b, left) &&
+	    !(canTrap(left) && canTrap(right))) {
+		*r = genExp(b, right);
+		*l = genExp(b, left);
+	} else {
+		*l = genExp(b, left);
+		*r = genExp(b, right);
+	}
+}
+
+static int genExp(Builder * b, Absyn * node)
+{
+	LValue lv;
+	Absyn *left, *right;
+	int l, r, op;
+
+	switch (node->type) {
+	case ABSYN_INTEXP:
+		if (node->u.intExp.val == 0) {
+			return VREG_ZERO;
+		}
+		return emitOp(b, IR_LDC, VREG_NONE, VREG_NONE, node->u.intExp.val);
+	case ABSYN_VAREXP:
+		lv = nearVar(b, ABSYN(node->u.varExp.var));
+		if (lv.kind == LV_VREG) {
+			return lv.vreg;
+		}
+		return emitOp(b, IR_LDW, lv.vreg, VREG_NONE, lv.offset);
+	case ABSYN_OPEXP:
+		left = ABSYN(node->u.opExp.left);
+		right = ABSYN(node->u.opExp.right);
+		switch (node->u.opExp.op) {
+		case ABSYN_OP_ADD:	op = IR_ADD; break;
+		case ABSYN_OP_SUB:	op = IR_SUB; break;
+		case ABSYN_OP_MUL:	op = IR_MUL; break;
+		case ABSYN_OP_DIV:	op = IR_DIV; break;
+		default:
+			error("comparison used as value in line %d", node->line);
+		}
+		/* commutative operators take a constant on the right */
+		if ((op == IR_ADD || op == IR_MUL) &&
+		    isImmOperand(left) && !isImmOperand(right)) {
+			left = ABSYN(node->u.opExp.right);
+			right = ABSYN(node->u.opExp.left);
+		}
+		genOperands(b, left, right, &l, &r);
+		if (r == VREG_NONE && op == IR_MUL) {
+			return emitMulImm(b, l, right->u.intExp.val);
+		}
+		return emitOp(b, op, l, r, r == VREG_NONE ? right->u.intExp.val : 0);
+	}
+	error("unknown expression type %d in genExp", node->type);
+	return VREG_NONE;
+}
+
+static int negateCond(int cond)
+{
+	switch (cond) {
+	case ABSYN_OP_EQU:	return ABSYN_OP_NEQ;
+	case ABSYN_OP_NEQ:	return ABSYN_OP_EQU;
+	case ABSYN_OP_LST:	return ABSYN_OP_GRE;
+	case ABSYN_OP_LSE:	return ABSYN_OP_GRT;
+	case ABSYN_OP_GRT:	return ABSYN_OP_LSE;
+	case ABSYN_OP_GRE:	return ABSYN_OP_LST;
+	}
+	error("unknown relation %d in negateCond", cond);
+	return cond;
+}
+
+/* jump to label if test evaluates to jumpIf, fall through otherwise */
+static void genCond(Builder * b, Absyn * test, int label, boolean jumpIf)
+{
+	int l, r;
+
+	if (test->type == ABSYN_INTEXP) {
+		/* folded comparison */
+		if ((test->u.intExp.val != 0) == jumpIf) {
+			emitJump(b, label);
+		}
+		return;
+	}
+	genOperands(b, ABSYN(test->u.opExp.left), ABSYN(test->u.opExp.right), &l, &r);
+	if (r == VREG_NONE) {
+		r = genExp(b, ABSYN(test->u.opExp.right));
+	}
+	emitBranch(b, jumpIf ? test->u.opExp.op : negateCond(test->u.opExp.op),
+		   l, r, label);
+}
+
+static void assignTo(Builder * b, int var, int value)
+{
+	Instr *last;
+
+	/* let the computation of a fresh temporary write the variable */
+	last = b->proc->last;
+	if (value >= VREG_FIRST && b->proc->vregs[value].name == NULL &&
+	    last != NULL && definesVreg(last) && last->dst == value) {
+		last->dst = var;
+		return;
+	}
+	emit(b, newInstr(IR_MOV, var, value, VREG_NONE, 0));
+}
+
+static int addressOf(Builder * b, LValue lv)
+{
+	if (lv.offset == 0) {
+		return lv.vreg;
+	}
+	return emitOp(b, IR_ADD, lv.vreg, VREG_NONE, lv.offset);
+}
+
+static void genStm(Builder * b, Absyn * node, boolean tail);
+
+/**
+ * @brief Generate the body of a called procedure in place of the call.
+ * Its parameters and variables become virtual registers of the caller;
+ * a ref parameter is the caller's variable itself if that lives in a
+ * virtual register, otherwise it holds the address.
+ **/
+static void genInline(Builder * b, Absyn * node, Absyn * procDec)
+{
+	Builder callee;
+	Absyn *decs, *args;
+	Entry *entry;
+	VarSlot *slot;
+	LValue lv;
+	Sym *name;
+	int i;
+
+	callee = *b;
+	callee.localTable =
+	    lookup(b->globalTable, procDec->u.procDec.name)->u.procEntry.localTable;
+	newVarMap(&callee, procDec);
+	args = ABSYN(node->u.callStm.args);
+	decs = ABSYN(procDec->u.procDec.params);
+	for (i = 0; i < decs->u.decList.count; i++) {
+		name = ABSYN(decs->u.decList.items[i])->u.parDec.name;
+		entry = lookup(callee.localTable, name);
+		slot = findVar(&callee, name);
+		slot->sym = name;
+		if (!entry->u.varEntry.isRef) {
+			slot->vreg = newVreg(b->proc, NO_HOME, name);
+			assignTo(b, slot->vreg,
+				 genExp(b, ABSYN(args->u.expList.items[i])));
+		} else {
+			lv = nearVar(b, ABSYN(ABSYN(args->u.expList.items[i])->
+					      u.varExp.var));
+			slot->isRef = lv.kind == LV_MEM;
+			if (lv.kind == LV_VREG ||
+			    (lv.offset == 0 && lv.vreg >= VREG_FIRST &&
+			     b->proc->vregs[lv.vreg].name != NULL)) {
+				slot->vreg = lv.vreg;
+			} else {
+				slot->vreg = newVreg(b->proc, NO_HOME, name);
+				/* a variable of the caller or what it points to */
+				b->proc->vregs[slot->vreg].region = REGION_ANY;
+				assignTo(b, slot->vreg, addressOf(b, lv));
+			}
+		}
+	}
+	decs = ABSYN(procDec->u.procDec.decls);
+	for (i = 0; i < decs->u.decList.count; i++) {
+		name = ABSYN(decs->u.decList.items[i])->u.varDec.name;
+		slot = findVar(&callee, name);
+		slot->sym = name;
+		slot->vreg = newVreg(b->proc, NO_HOME, name);
+	}
+	genStm(&callee, ABSYN(procDec->u.procDec.body), FALSE);
+	b->proc->numInlined++;
+}
+
+static void genCall(Builder * b, Absyn * node)
+{
+	Entry *entry;
+	ParamTypes *params;
+	Absyn *args, *arg, *procDec;
+	int value, i;
+
+	procDec = inlineCandidate(b->inliner, node->u.callStm.name);
+	if (procDec != NULL) {
+		genInline(b, node, procDec);
+		return;
+	}
+	entry = lookup(b->globalTable, node->u.callStm.name);
+	params = entry->u.procEntry.paramTypes;
+	args = ABSYN(node->u.callStm.args);
+	for (i = 0; !params->isEmpty; i++) {
+		arg = ABSYN(args->u.expList.items[i]);
+		if (params->isRef) {
+			value = addressOf(b, nearVar(b, ABSYN(arg->u.varExp.var)));
+		} else {
+			value = genExp(b, arg);
+		}
+		emit(b, newInstr(IR_STW, VREG_NONE, VREG_SP, value, params->offset));
+		params = params->next;
+	}
+	emit(b, newInstr(IR_CALL, VREG_NONE, VREG_NONE, VREG_NONE, 0));
+	b->proc->last->sym = node->u.callStm.name;
+	if (entry->u.procEntry.paramSize > b->proc->argSize) {
+		b->proc->argSize = entry->u.procEntry.paramSize;
+	}
+}
+
+/* a ref argument must not point into the frame that gets reused */
+static boolean isTailCall(Builder * b, Absyn * node)
+{
+	ParamTypes *params;
+	Absyn *args, *var;
+	int i;
+
+	if (node->u.callStm.name != b->proc->name) {
+		return FALSE;
+	}
+	params = b->proc->entry->u.procEntry.paramTypes;
+	args = ABSYN(node->u.callStm.args);
+	for (i = 0; !params->isEmpty; i++) {
+		if (params->isRef) {
+			var = ABSYN(ABSYN(args->u.expList.items[i])->u.varExp.var);
+			while (var->type == ABSYN_ARRAYVAR) {
+				var = ABSYN(var->u.arrayVar.var);
+			}
+			if (!findVar(b, var->u.simpleVar.name)->isRef) {
+				return FALSE;
+			}
+		}
+		params = params->next;
+	}
+	return TRUE;
+}
+
+/**
+ * @brief A call of the procedure to itself as its last action: the new
+ * arguments replace the parameters and the body starts over in the
+ * same frame. A parameter that is passed on unchanged is left alone,
+ * one that is overwritten before it is read as an argument is copied.
+ **/
+static void genTailCall(Builder * b, Absyn * node)
+{
+	ParamTypes *params;
+	Absyn *args, *arg, *decs;
+	VarSlot **slots;
+	Instr *label;
+	int *values;
+	int i, j, n;
+
+	decs = ABSYN(b->procDec->u.procDec.params);
+	n = decs->u.decList.count;
+	slots = (VarSlot **) allocate((n + 1) * sizeof(VarSlot *));
+	values = (int *) allocate((n + 1) * sizeof(int));
+	params = b->proc->entry->u.procEntry.paramTypes;
+	args = ABSYN(node->u.callStm.args);
+	for (i = 0; i < n; i++) {
+		slots[i] = findVar(b, ABSYN(decs->u.decList.items[i])->u.parDec.name);
+		arg = ABSYN(args->u.expList.items[i]);
+		if (params->isRef) {
+			values[i] = addressOf(b, nearVar(b, ABSYN(arg->u.varExp.var)));
+		} else {
+			values[i] = genExp(b, arg);
+		}
+		params = params->next;
+	}
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < i; j++) {
+			if (values[i] == slots[j]->vreg && values[j] != slots[j]->vreg) {
+				values[i] = emitOp(b, IR_MOV, values[i], VREG_NONE, 0);
+				break;
+			}
+		}
+	}
+	for (i = 0; i < n; i++) {
+		if (slots[i]->vreg == VREG_NONE) {
+			emit(b, newInstr(IR_STW, VREG_NONE, VREG_FP, values[i],
+					 lookup(b->localTable, slots[i]->sym)->
+					 u.varEntry.offset));
+		} else if (values[i] != slots[i]->vreg) {
+			emit(b, newInstr(IR_MOV, slots[i]->vreg, values[i],
+					 VREG_NONE, 0));
+		}
+	}
+	if (b->entryLabel < 0) {
+		b->entryLabel = newLabel(b->proc);
+		label = newInstr(IR_LABEL, VREG_NONE, VREG_NONE, VREG_NONE, 0);
+		label->label = b->entryLabel;
+		insertBefore(b->proc, b->bodyStart == NULL ?
+			     b->proc->first : b->bodyStart->next, label);
+	}
+	emitJump(b, b->entryLabel);
+	b->proc->numTailCalls++;
+}
+
+/* tail: the statement is the last one executed by the procedure */
+static void genStm(Builder * b, Absyn * node, boolean tail)
+{
+	LValue lv;
+	int value, label1, label2, i;
+
+	switch (node->type) {
+	case ABSYN_EMPTYSTM:
+		break;
+	case ABSYN_COMPSTM:
+		genStm(b, ABSYN(node->u.compStm.stms), tail);
+		break;
+	case ABSYN_STMLIST:
+		for (i = 0; i < node->u.stmList.count; i++) {
+			genStm(b, ABSYN(node->u.stmList.items[i]),
+			       tail && i == node->u.stmList.count - 1);
+		}
+		break;
+	case ABSYN_ASSIGNSTM:
+		lv = nearVar(b, ABSYN(node->u.assignStm.var));
+		value = genExp(b, ABSYN(node->u.assignStm.exp));
+		if (lv.kind == LV_VREG) {
+			assignTo(b, lv.vreg, value);
+		} else {
+			emit(b, newInstr(IR_STW, VREG_NONE, lv.vreg, value, lv.offset));
+		}
+		break;
+	case ABSYN_IFSTM:
+		label1 = newLabel(b->proc);
+		genCond(b, ABSYN(node->u.ifStm.test), label1, FALSE);
+		genStm(b, ABSYN(node->u.ifStm.thenPart), tail);
+		if (ABSYN(node->u.ifStm.elsePart)->type == ABSYN_EMPTYSTM) {
+			emitLabel(b, label1);
+		} else {
+			label2 = newLabel(b->proc);
+			emitJump(b, label2);
+			emitLabel(b, label1);
+			genStm(b, ABSYN(node->u.ifStm.elsePart), tail);
+			emitLabel(b, label2);
+		}
+		break;
+	case ABSYN_WHILESTM:
+		/* test at the bottom: one branch per iteration */
+		label1 = newLabel(b->proc);
+		label2 = newLabel(b->proc);
+		emitJump(b, label2);
+		emitLabel(b, label1);
+		genStm(b, ABSYN(node->u.whileStm.body), FALSE);
+		emitLabel(b, label2);
+		genCond(b, ABSYN(node->u.whileStm.test), label1, TRUE);
+		break;
+	case ABSYN_CALLSTM:
+		if (tail && isTailCall(b, node)) {
+			genTailCall(b, node);
+		} else {
+			genCall(b, node);
+		}
+		break;
+	default:
+		error("unknown statement type %d in genStm", node->type);
+	}
+}
+
+/**
+ * @brief Translate the body of a procedure into a linear list of
+ * three-address instructions over virtual registers
+ *
+ * @param procDec procedure declaration
+ * @param globalTable symbol table
+ * @param inliner procedures whose calls are replaced by their body
+ * @return IrProc* - instructions and virtual registers of the procedure
+ **/
+IrProc *buildIr(Absyn * procDec, Table * globalTable, Inliner * inliner,
+	       Aliases * aliases)
+{
+	Builder builder;
+	IrProc *proc;
+
+	proc = (IrProc *) allocate(sizeof(IrProc));
+	memset(proc, 0, sizeof(IrProc));
+	proc->name = procDec->u.procDec.name;
+	proc->entry = lookup(globalTable, proc->name);
+	proc->argSize = -1;
+	/* the fixed registers come first */
+	newVreg(proc, NO_HOME, NULL);
+	newVreg(proc, NO_HOME, NULL);
+	newVreg(proc, NO_HOME, NULL);
+
+	memset(&builder, 0, sizeof(Builder));
+	builder.proc = proc;
+	builder.globalTable = globalTable;
+	builder.localTable = proc->entry->u.procEntry.localTable;
+	builder.inliner = inliner;
+	builder.aliases = aliases;
+	builder.procDec = procDec;
+	builder.entryLabel = -1;
+	newVarMap(&builder, procDec);
+	findAddrTaken(&builder, ABSYN(procDec->u.procDec.body));
+	promoteVars(&builder, procDec);
+	builder.bodyStart = proc->last;
+	genStm(&builder, ABSYN(procDec->u.procDec.body), TRUE);
+	return proc;
+}
+
+/**************************************************************/
+
+static Block *newBlock(IrProc * proc, Block * last)
+{
+	Block *block;
+
+	block = (Block *) allocate(sizeof(Block));
+	memset(block, 0, sizeof(Block));
+	block->id = proc->numBlocks++;
+	if (last == NULL) {
+		proc->blocks = block;
+	} else {
+		last->next = block;
+	}
+	return block;
+}
+
+static boolean endsBlock(Instr * instr)
+{
+	return instr->op == IR_BR || instr->op == IR_JMP;
+}
+
+static void addEdge(Block * from, int index, Block * to)
+{
+	from->succ[index] = to;
+	to->numPreds++;
+}
+
+/**
+ * @brief Split the instruction list of a procedure into basic blocks
+ * and connect them. The entry block is the first block, it is empty
+ * if the procedure has no instructions.
+ *
+ * @param proc procedure
+ * @return void
+ **/
+void buildCfg(IrProc * proc)
+{
+	Block **labelBlocks;
+	Block *block, *succ;
+	Instr *instr;
+	int i;
+
+	labelBlocks = (Block **) allocate((proc->numLabels + 1) * sizeof(Block *));
+	proc->blocks = NULL;
+	proc->numBlocks = 0;
+	block = newBlock(proc, NULL);
+	for (instr = proc->first; instr != NULL; instr = instr->next) {
+		if (instr->op == IR_LABEL && block->first != NULL) {
+			block = newBlock(proc, block);
+		}
+		if (block->first == NULL) {
+			block->first = instr;
+		}
+		block->last = instr;
+		instr->block = block;
+		if (instr->op == IR_LABEL) {
+			labelBlocks[instr->label] = block;
+		}
+		if (endsBlock(instr) && instr->next != NULL) {
+			block = newBlock(proc, block);
+		}
+	}
+
+	/* edges, then the predecessor lists */
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		instr = block->last;
+		if (instr == NULL || instr->op != IR_JMP) {
+			if (block->next != NULL) {
+				addEdge(block, 0, block->next);
+			}
+		} else {
+			addEdge(block, 0, labelBlocks[instr->label]);
+		}
+		if (instr != NULL && instr->op == IR_BR) {
+			addEdge(block, 1, labelBlocks[instr->label]);
+		}
+	}
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		block->preds = (Block **) allocate(block->numPreds * sizeof(Block *));
+		block->numPreds = 0;
+	}
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		for (i = 0; i < 2; i++) {
+			succ = block->succ[i];
+			if (succ != NULL) {
+				succ->preds[succ->numPreds++] = block;
+			}
+		}
+	}
+}
+
+/**************************************************************/
+
+static void showVreg(IrProc * proc, int vreg)
+{
+	switch (vreg) {
+	case VREG_ZERO:
+		printf("0");
+		return;
+	case VREG_FP:
+		printf("fp");
+		return;
+	case VREG_SP:
+		printf("sp");
+		return;
+	}
+	if (proc->vregs[vreg].name != NULL) {
+		printf("%s", symToString(proc->vregs[vreg].name));
+	} else {
+		printf("t%d", vreg);
+	}
+}
+
+static void showOperand(IrProc * proc, Instr * instr)
+{
+	if (instr->src2 == VREG_NONE) {
+		printf("%d", instr->imm);
+	} else {
+		showVreg(proc, instr->src2);
+	}
+}
+
+static void showAddress(IrProc * proc, int base, int offset)
+{
+	printf("[");
+	showVreg(proc, base);
+	if (offset < 0) {
+		printf(" - %d]", -offset);
+	} else {
+		printf(" + %d]", offset);
+	}
+}
+
+static char *relationName(int cond)
+{
+	switch (cond) {
+	case ABSYN_OP_EQU:	return "=";
+	case ABSYN_OP_NEQ:	return "#";
+	case ABSYN_OP_LST:	return "<";
+	case ABSYN_OP_LSE:	return "<=";
+	case ABSYN_OP_GRT:	return ">";
+	case ABSYN_OP_GRE:	return ">=";
+	}
+	return "?";
+}
+
+static void showInstr(IrProc * proc, Instr * instr)
+{
+	static char *opNames[] = {
+		NULL, NULL, NULL, "+", "-", "*", "/", "<<"
+	};
+
+	printf("\t");
+	switch (instr->op) {
+	case IR_LDC:
+		showVreg(proc, instr->dst);
+		printf(" := %d", instr->imm);
+		break;
+	case IR_MOV:
+		showVreg(proc, instr->dst);
+		printf(" := ");
+		showVreg(proc, instr->src1);
+		break;
+	case IR_ADD:
+	case IR_SUB:
+	case IR_MUL:
+	case IR_DIV:
+	case IR_SLL:
+		showVreg(proc, instr->dst);
+		printf(" := ");
+		showVreg(proc, instr->src1);
+		printf(" %s ", opNames[instr->op]);
+		showOperand(proc, instr);
+		break;
+	case IR_LDW:
+		showVreg(proc, instr->dst);
+		printf(" := ");
+		showAddress(proc, instr->src1, instr->imm);
+		break;
+	case IR_STW:
+		showAddress(proc, instr->src1, instr->imm);
+		printf(" := ");
+		showVreg(proc, instr->src2);
+		break;
+	case IR_BR:
+		printf("if ");
+		showVreg(proc, instr->src1);
+		printf(" %s ", relationName(instr->cond));
+		showVreg(proc, instr->src2);
+		printf(" goto L%d", instr->label);
+		break;
+	case IR_JMP:
+		printf("goto L%d", instr->label);
+		break;
+	case IR_CHK:
+		printf("check ");
+		showVreg(proc, instr->src1);
+		printf(" < %d", instr->imm);
+		break;
+	case IR_CALL:
+		printf("call %s", symToString(instr->sym));
+		break;
+	}
+	printf("\n");
+}
+
+/**
+ * @brief Show the basic blocks of a procedure with their edges
+ *
+ * @param proc procedure with control flow graph
+ * @return void
+ **/
+void showIr(IrProc * proc)
+{
+	Block *block;
+	Instr *instr;
+	int i;
+
+	printf("\nIntermediate code for procedure '%s'\n",
+	       symToString(proc->name));
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		printf("B%d:", block->id);
+		if (block->first != NULL && block->first->op == IR_LABEL) {
+			printf(" L%d", block->first->label);
+		}
+		if (block->numPreds > 0) {
+			printf("\tpreds");
+			for (i = 0; i < block->numPreds; i++) {
+				printf(" B%d", block->preds[i]->id);
+			}
+		}
+		printf("\n");
+		for (instr = block->first; instr != NULL; instr = instr->next) {
+			if (instr->op != IR_LABEL) {
+				showInstr(proc, instr);
+			}
+			if (instr == block->last) {
+				break;
+			}
+		}
+		if (block->succ[0] != NULL || block->succ[1] != NULL) {
+			printf("\tsuccs");
+			for (i = 0; i < 2; i++) {
+				if (block->succ[i] != NULL) {
+					printf(" B%d", block->succ[i]->id);
+				}
+			}
+			printf("\n");
+		}
+	}
+}
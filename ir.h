@@ -0,0 +1,117 @@
+/*
+ * ir.h -- intermediate representation
+ */
+
+#ifndef _IR_H_
+#define _IR_H_
+
+#define IR_LABEL	0	/* L<label>:                              */
+#define IR_LDC		1	/* dst := imm                             */
+#define IR_MOV		2	/* dst := src1                            */
+#define IR_ADD		3	/* dst := src1 + (src2 or imm)            */
+#define IR_SUB		4	/* dst := src1 - (src2 or imm)            */
+#define IR_MUL		5	/* dst := src1 * (src2 or imm)            */
+#define IR_DIV		6	/* dst := src1 / (src2 or imm)            */
+#define IR_SLL		7	/* dst := src1 << (src2 or imm)           */
+#define IR_LDW		8	/* dst := mem[src1 + imm]                 */
+#define IR_STW		9	/* mem[src1 + imm] := src2                */
+#define IR_BR		10	/* if src1 cond src2 goto L<label>        */
+#define IR_JMP		11	/* goto L<label>                          */
+#define IR_CHK		12	/* if src1 >= imm (unsigned) index error  */
+#define IR_CALL		13	/* call sym                               */
+
+/* virtual registers with a fixed hardware counterpart */
+#define VREG_NONE	(-1)	/* operand not present, use imm */
+#define VREG_ZERO	0	/* always 0 */
+#define VREG_FP		1	/* frame pointer */
+#define VREG_SP		2	/* stack pointer */
+#define VREG_FIRST	3	/* first allocatable virtual register */
+
+#define NO_HOME		(-1)	/* temporary without spill slot */
+
+/* memory the value of a virtual register can be the address of */
+#define REGION_NONE	0	/* not an address */
+#define REGION_FRAME	1	/* the procedure's own frame */
+#define REGION_ANY	2	/* unknown */
+#define REGION_CALLER	3	/* outside the frame, through a ref parameter */
+#define REGION_PARAM(i)	(4 + (i))	/* through unaliased ref parameter i */
+
+struct block;
+
+typedef struct instr {
+	int op;
+	int dst;
+	int src1;
+	int src2;
+	int imm;
+	int cond;		/* relation of IR_BR, one of ABSYN_OP_xxx */
+	int label;		/* IR_LABEL, IR_BR, IR_JMP */
+	Sym *sym;		/* callee of IR_CALL */
+	struct block *block;	/* basic block, NULL before buildCfg */
+	struct instr *prev;
+	struct instr *next;
+} Instr;
+
+/*
+ * A basic block is a range of the instruction list. It starts with
+ * a label or after a branch and ends with a branch or before a label.
+ * IR_CHK leaves the procedure on failure only, it does not end a block.
+ */
+typedef struct block {
+	int id;			/* number in layout order */
+	Instr *first;		/* first and last instruction, NULL if empty */
+	Instr *last;
+	struct block *succ[2];	/* fall-through or jump target, branch target */
+	struct block **preds;	/* predecessors */
+	int numPreds;
+	struct block *next;	/* next block in layout order */
+} Block;
+
+typedef struct {
+	int home;		/* frame offset of a variable, spill slot of a temp */
+	Sym *name;		/* variable name, NULL for temps */
+	int reg;		/* hardware register, 0 if kept at home */
+	boolean inFrame;	/* home is a frame offset, not a spill slot */
+	int region;		/* what a variable can point to */
+} Vreg;
+
+typedef struct {
+	Sym *name;		/* procedure name */
+	Entry *entry;		/* procedure entry in global table */
+	Instr *first;		/* instruction list */
+	Instr *last;
+	Vreg *vregs;		/* information on virtual registers */
+	int numVregs;
+	int maxVregs;
+	int numLabels;		/* labels are numbered per procedure */
+	Block *blocks;		/* control flow graph, entry block first */
+	int numBlocks;
+	int spillSize;		/* frame bytes for spilled temporaries */
+	unsigned savedRegs;	/* callee-saved registers in use, bit mask */
+	int argSize;		/* outgoing arguments, -1 if no calls */
+	int numInlined;		/* calls replaced by the body of the callee */
+	int numTailCalls;	/* self-calls turned into jumps */
+	int numHoisted;		/* instructions moved in front of loops */
+	int numReduced;		/* element addresses taken from pointers */
+} IrProc;
+
+IrProc *buildIr(Absyn * procDec, Table * globalTable, Inliner * inliner,
+	       Aliases * aliases);
+void buildCfg(IrProc * proc);
+void showIr(IrProc * proc);
+
+int newVreg(IrProc * proc, int home, Sym * name);
+int newLabel(IrProc * proc);
+Instr *newInstr(int op, int dst, int src1, int src2, int imm);
+void appendInstr(IrProc * proc, Instr * instr);
+void insertBefore(IrProc * proc, Instr * pos, Instr * instr);
+void insertAfter(IrProc * proc, Instr * pos, Instr * instr);
+void removeInstr(IrProc * proc, Instr * instr);
+
+int resultRegion(IrProc * proc, Instr * instr, int r1, int r2);
+boolean regionsOverlap(int r1, int r2);
+
+boolean definesVreg(Instr * instr);
+int usedVregs(Instr * instr, int used[2]);
+
+#endif				/* _IR_H_ */
@@ -0,0 +1,685 @@
+/*
+ * loop.c -- loop-invariant code motion and strength reduction
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "inliner.h"
+#include "alias.h"
+#include "ir.h"
+#include "loop.h"
+
+/*
+ * Loops are the natural loops of the control flow graph: an edge to a
+ * block that dominates its source closes a loop. A while loop is
+ * entered by the jump to its test at the bottom, the block ending in
+ * that jump is the preheader that receives the hoisted instructions.
+ * Temporaries are assigned exactly once, so a temporary computed from
+ * values that do not change in the loop can be computed before it.
+ * A load of a variable, which may be reached through a ref parameter,
+ * moves as well if no store of the loop can hit it. The regions of the
+ * addresses tell, so a ref parameter that aliases no other one keeps
+ * its value in a register while the loop stores through the others.
+ *
+ * Array elements indexed by a variable that is counted up or down by a
+ * constant, as in
+ *
+ *     while (i < n) { a[i] := a[i] + 1; i := i + 1; }
+ *
+ * are addressed through a pointer that starts at the address of a[i]
+ * and is advanced together with i, instead of shifting i and adding
+ * the base address for every access. Inner loops are done first, so
+ * their hoisted instructions can move on out of the enclosing loop.
+ * Loops that call procedures are left alone: values kept over the
+ * loop would have to survive the calls in the few callee-saved
+ * registers, and spilling them costs more than computing them again.
+ */
+
+#define BITS_PER_WORD	32
+
+typedef struct {
+	Block *header;
+	Block *preheader;	/* NULL if the loop has none */
+	boolean *blocks;	/* membership, indexed by block id */
+	int size;		/* number of blocks */
+	boolean hasCall;	/* contains a procedure call */
+} Loop;
+
+typedef struct {
+	int base;		/* pointer = base + var * scale */
+	int var;
+	int scaleOp;		/* IR_SLL or IR_MUL by scaleImm */
+	int scaleImm;
+	int ptr;
+} Pointer;
+
+typedef struct {
+	IrProc *proc;
+	int numVregs;		/* size of the tables below */
+	int *defs;		/* definitions of each vreg */
+	int *uses;		/* uses of each vreg */
+	int *loopDefs;		/* definitions inside the current loop */
+	Instr **loopDef;	/* the last of them */
+	Instr **def;		/* the last definition anywhere */
+	Instr **stores;		/* stores inside the current loop */
+	int numStores;
+	Pointer *pointers;	/* induction pointers of the current loop */
+	int numPointers;
+} Optimizer;
+
+/**************************************************************/
+
+static void markReached(Block * block, boolean * reached)
+{
+	int i;
+
+	if (reached[block->id]) {
+		return;
+	}
+	reached[block->id] = TRUE;
+	for (i = 0; i < 2; i++) {
+		if (block->succ[i] != NULL) {
+			markReached(block->succ[i], reached);
+		}
+	}
+}
+
+static boolean dominates(unsigned *dom, int words, Block * d, Block * b)
+{
+	return (dom[b->id * words + d->id / BITS_PER_WORD] >>
+		(d->id % BITS_PER_WORD)) & 1;
+}
+
+/**
+ * @brief Dominator sets of all reachable blocks, iterated to a fixed
+ * point. Set b has bit d on if block d dominates block b.
+ *
+ * @param proc procedure with control flow graph
+ * @param reached blocks reachable from the entry
+ * @param words words per set
+ * @return unsigned* - one set per block
+ **/
+static unsigned *findDominators(IrProc * proc, boolean * reached, int words)
+{
+	unsigned *dom;
+	unsigned word;
+	Block *block, *pred;
+	boolean changed;
+	int i, w;
+
+	dom = (unsigned *) allocate(proc->numBlocks * words * sizeof(unsigned));
+	memset(dom, 0xFF, proc->numBlocks * words * sizeof(unsigned));
+	memset(dom + proc->blocks->id * words, 0, words * sizeof(unsigned));
+	dom[proc->blocks->id * words + proc->blocks->id / BITS_PER_WORD] =
+	    1u << (proc->blocks->id % BITS_PER_WORD);
+	do {
+		changed = FALSE;
+		for (block = proc->blocks->next; block != NULL; block = block->next) {
+			if (!reached[block->id]) {
+				continue;
+			}
+			for (w = 0; w < words; w++) {
+				word = ~0u;
+				for (i = 0; i < block->numPreds; i++) {
+					pred = block->preds[i];
+					if (reached[pred->id]) {
+						word &= dom[pred->id * words + w];
+					}
+				}
+				if (w == block->id / BITS_PER_WORD) {
+					word |= 1u << (block->id % BITS_PER_WORD);
+				}
+				if (word != dom[block->id * words + w]) {
+					dom[block->id * words + w] = word;
+					changed = TRUE;
+				}
+			}
+		}
+	} while (changed);
+	return dom;
+}
+
+/* the blocks from which latch is reached without passing the header */
+static void addToLoop(Loop * loop, Block * latch, Block ** stack)
+{
+	Block *block, *pred;
+	int top, i;
+
+	top = 0;
+	if (!loop->blocks[latch->id]) {
+		loop->blocks[latch->id] = TRUE;
+		loop->size++;
+		stack[top++] = latch;
+	}
+	while (top > 0) {
+		block = stack[--top];
+		for (i = 0; i < block->numPreds; i++) {
+			pred = block->preds[i];
+			if (!loop->blocks[pred->id]) {
+				loop->blocks[pred->id] = TRUE;
+				loop->size++;
+				stack[top++] = pred;
+			}
+		}
+	}
+}
+
+/* the only block outside the loop leading to the header, by a jump */
+static Block *findPreheader(Loop * loop)
+{
+	Block *pred, *preheader;
+	int i;
+
+	preheader = NULL;
+	for (i = 0; i < loop->header->numPreds; i++) {
+		pred = loop->header->preds[i];
+		if (loop->blocks[pred->id]) {
+			continue;
+		}
+		if (preheader != NULL) {
+			return NULL;
+		}
+		preheader = pred;
+	}
+	if (preheader == NULL || preheader->last == NULL ||
+	    preheader->last->op != IR_JMP) {
+		return NULL;
+	}
+	return preheader;
+}
+
+static boolean containsCall(Block * block)
+{
+	Instr *instr;
+
+	if (block->first == NULL) {
+		return FALSE;
+	}
+	for (instr = block->first; instr != block->last; instr = instr->next) {
+		if (instr->op == IR_CALL) {
+			return TRUE;
+		}
+	}
+	return block->last->op == IR_CALL;
+}
+
+static int compareSize(const void *p, const void *q)
+{
+	return ((Loop *) p)->size - ((Loop *) q)->size;
+}
+
+/**
+ * @brief Find the natural loops of a procedure, innermost first
+ *
+ * @param proc procedure with control flow graph
+ * @param numLoops number of loops returned
+ * @return Loop* - the loops, sorted by size
+ **/
+static Loop *findLoops(IrProc * proc, int *numLoops)
+{
+	boolean *reached;
+	unsigned *dom;
+	Block **stack;
+	Block *block, *header;
+	Loop *loops;
+	int words, n, i, j;
+
+	reached = (boolean *) allocate(proc->numBlocks * sizeof(boolean));
+	memset(reached, 0, proc->numBlocks * sizeof(boolean));
+	markReached(proc->blocks, reached);
+	words = (proc->numBlocks + BITS_PER_WORD - 1) / BITS_PER_WORD;
+	dom = findDominators(proc, reached, words);
+	stack = (Block **) allocate(proc->numBlocks * sizeof(Block *));
+	loops = (Loop *) allocate(proc->numBlocks * sizeof(Loop));
+	n = 0;
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		if (!reached[block->id]) {
+			continue;
+		}
+		for (i = 0; i < 2; i++) {
+			header = block->succ[i];
+			if (header == NULL || !dominates(dom, words, header, block)) {
+				continue;
+			}
+			/* back edges to the same header make one loop */
+			for (j = 0; j < n && loops[j].header != header; j++) ;
+			if (j == n) {
+				loops[n].header = header;
+				loops[n].blocks = (boolean *)
+				    allocate(proc->numBlocks * sizeof(boolean));
+				memset(loops[n].blocks, 0,
+				       proc->numBlocks * sizeof(boolean));
+				loops[n].blocks[header->id] = TRUE;
+				loops[n].size = 1;
+				n++;
+			}
+			addToLoop(&loops[j], block, stack);
+		}
+	}
+	for (j = 0; j < n; j++) {
+		loops[j].preheader = findPreheader(&loops[j]);
+		loops[j].hasCall = FALSE;
+		for (block = proc->blocks; block != NULL; block = block->next) {
+			if (loops[j].blocks[block->id] && containsCall(block)) {
+				loops[j].hasCall = TRUE;
+			}
+		}
+	}
+	qsort(loops, n, sizeof(Loop), compareSize);
+	*numLoops = n;
+	return loops;
+}
+
+/**************************************************************/
+
+/* count definitions and uses, in the whole procedure and in the loop */
+static void countVregs(Optimizer * o, Loop * loop)
+{
+	IrProc *proc;
+	Instr *instr;
+	boolean inLoop;
+	int used[2];
+	int i, n;
+
+	proc = o->proc;
+	o->numVregs = proc->numVregs;
+	o->defs = (int *) allocate(o->numVregs * sizeof(int));
+	o->uses = (int *) allocate(o->numVregs * sizeof(int));
+	o->loopDefs = (int *) allocate(o->numVregs * sizeof(int));
+	o->loopDef = (Instr **) allocate(o->numVregs * sizeof(Instr *));
+	o->def = (Instr **) allocate(o->numVregs * sizeof(Instr *));
+	memset(o->defs, 0, o->numVregs * sizeof(int));
+	memset(o->uses, 0, o->numVregs * sizeof(int));
+	memset(o->loopDefs, 0, o->numVregs * sizeof(int));
+	n = 0;
+	for (instr = proc->first; instr != NULL; instr = instr->next) {
+		n++;
+	}
+	o->stores = (Instr **) allocate((n + 1) * sizeof(Instr *));
+	o->numStores = 0;
+	for (instr = proc->first; instr != NULL; instr = instr->next) {
+		n = usedVregs(instr, used);
+		for (i = 0; i < n; i++) {
+			o->uses[used[i]]++;
+		}
+		inLoop = instr->block != NULL && loop->blocks[instr->block->id];
+		if (inLoop && instr->op == IR_STW) {
+			o->stores[o->numStores++] = instr;
+		}
+		if (!definesVreg(instr)) {
+			continue;
+		}
+		o->defs[instr->dst]++;
+		o->def[instr->dst] = instr;
+		if (inLoop) {
+			o->loopDefs[instr->dst]++;
+			o->loopDef[instr->dst] = instr;
+		}
+	}
+}
+
+/* the value does not change while the loop runs */
+static boolean isInvariant(Optimizer * o, int vreg)
+{
+	return vreg < VREG_FIRST ||
+	    (vreg < o->numVregs && o->loopDefs[vreg] == 0);
+}
+
+static boolean isTemp(Optimizer * o, int vreg)
+{
+	return vreg >= VREG_FIRST && vreg < o->numVregs &&
+	    o->proc->vregs[vreg].name == NULL && o->defs[vreg] == 1;
+}
+
+/* what the value of a vreg can point to, from its definitions */
+static int regionOf(Optimizer * o, int vreg)
+{
+	Instr *def;
+
+	if (vreg == VREG_ZERO) {
+		return REGION_NONE;
+	}
+	if (vreg < VREG_FIRST) {
+		return REGION_FRAME;
+	}
+	if (vreg >= o->numVregs) {
+		return REGION_ANY;
+	}
+	if (o->proc->vregs[vreg].name != NULL) {
+		return o->proc->vregs[vreg].region;
+	}
+	if (o->defs[vreg] != 1) {
+		return REGION_ANY;
+	}
+	def = o->def[vreg];
+	return resultRegion(o->proc, def,
+			    def->src1 == VREG_NONE ? REGION_NONE :
+			    regionOf(o, def->src1),
+			    def->src2 == VREG_NONE ? REGION_NONE :
+			    regionOf(o, def->src2));
+}
+
+/*
+ * A variable or a constant element addressed through a variable is
+ * always there to be loaded. It keeps its value in the loop if no
+ * store of the loop can hit it.
+ */
+static boolean isUnclobbered(Optimizer * o, Instr * load)
+{
+	Instr *store;
+	int region, i;
+
+	if (load->src1 != VREG_FP &&
+	    (load->src1 < VREG_FIRST || o->proc->vregs[load->src1].name == NULL)) {
+		return FALSE;
+	}
+	region = regionOf(o, load->src1);
+	for (i = 0; i < o->numStores; i++) {
+		store = o->stores[i];
+		if (store->src1 == load->src1 ? store->imm == load->imm :
+		    regionsOverlap(region, regionOf(o, store->src1))) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * Computing the instruction earlier cannot stop the program. Small
+ * constants stay where they are, loading one again is cheaper than
+ * keeping it in a register over the whole loop.
+ */
+static boolean canHoist(Optimizer * o, Instr * instr)
+{
+	int used[2];
+	int i, n;
+
+	switch (instr->op) {
+	case IR_LDC:
+		if (instr->imm >= -32768 && instr->imm <= 32767) {
+			return FALSE;
+		}
+		break;
+	case IR_LDW:
+		if (!isUnclobbered(o, instr)) {
+			return FALSE;
+		}
+		break;
+	case IR_MOV:
+	case IR_ADD:
+	case IR_SUB:
+	case IR_MUL:
+	case IR_SLL:
+		break;
+	case IR_DIV:
+		if (instr->src2 == VREG_NONE && instr->imm != 0) {
+			break;
+		}
+		return FALSE;
+	default:
+		return FALSE;
+	}
+	if (!isTemp(o, instr->dst)) {
+		return FALSE;
+	}
+	n = usedVregs(instr, used);
+	for (i = 0; i < n; i++) {
+		if (!isInvariant(o, used[i])) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static int hoistInvariants(Optimizer * o, Loop * loop)
+{
+	IrProc *proc;
+	Block *block;
+	Instr *instr, *next;
+	boolean changed;
+	int hoisted;
+
+	proc = o->proc;
+	hoisted = 0;
+	do {
+		changed = FALSE;
+		for (block = proc->blocks; block != NULL; block = block->next) {
+			if (!loop->blocks[block->id]) {
+				continue;
+			}
+			for (instr = block->first; instr != NULL; instr = next) {
+				next = instr == block->last ? NULL : instr->next;
+				if (canHoist(o, instr)) {
+					removeInstr(proc, instr);
+					insertBefore(proc, loop->preheader->last, instr);
+					o->loopDefs[instr->dst]--;
+					hoisted++;
+					changed = TRUE;
+				}
+			}
+		}
+	} while (changed);
+	return hoisted;
+}
+
+/**************************************************************/
+
+/* step of a variable counted by a constant in the loop, 0 if none */
+static int stepOf(Optimizer * o, int var)
+{
+	Instr *def;
+
+	if (var < VREG_FIRST || var >= o->numVregs ||
+	    o->proc->vregs[var].name == NULL || o->loopDefs[var] != 1) {
+		return 0;
+	}
+	def = o->loopDef[var];
+	if (def->src1 != var || def->src2 != VREG_NONE) {
+		return 0;
+	}
+	if (def->op == IR_ADD) {
+		return def->imm;
+	}
+	if (def->op == IR_SUB) {
+		return -def->imm;
+	}
+	return 0;
+}
+
+static Sym *pointerName(Sym * var)
+{
+	char *name;
+
+	name = (char *) allocate(strlen(symToString(var)) + 5);
+	strcpy(name, symToString(var));
+	strcat(name, ".ptr");
+	return newSym(name);
+}
+
+/* a pointer advancing with var, created on first use */
+static int getPointer(Optimizer * o, Loop * loop, int base, Instr * scale)
+{
+	IrProc *proc;
+	Pointer *p;
+	Instr *instr;
+	int i, scaled;
+
+	for (i = 0; i < o->numPointers; i++) {
+		p = &o->pointers[i];
+		if (p->base == base && p->var == scale->src1 &&
+		    p->scaleOp == scale->op && p->scaleImm == scale->imm) {
+			return p->ptr;
+		}
+	}
+	proc = o->proc;
+	p = &o->pointers[o->numPointers++];
+	p->base = base;
+	p->var = scale->src1;
+	p->scaleOp = scale->op;
+	p->scaleImm = scale->imm;
+	p->ptr = newVreg(proc, NO_HOME, pointerName(proc->vregs[p->var].name));
+	proc->vregs[p->ptr].region = regionOf(o, base);
+	/* the start address before the loop */
+	scaled = newVreg(proc, NO_HOME, NULL);
+	insertBefore(proc, loop->preheader->last,
+		     newInstr(scale->op, scaled, p->var, VREG_NONE, scale->imm));
+	insertBefore(proc, loop->preheader->last,
+		     newInstr(IR_ADD, p->ptr, base, scaled, 0));
+	/* and the step along with the variable */
+	instr = newInstr(IR_ADD, p->ptr, p->ptr, VREG_NONE,
+			 scale->op == IR_SLL ?
+			 stepOf(o, p->var) << scale->imm :
+			 stepOf(o, p->var) * scale->imm);
+	insertAfter(proc, o->loopDef[p->var], instr);
+	return p->ptr;
+}
+
+/* the instruction reads vreg */
+static boolean readsVreg(Instr * instr, int vreg)
+{
+	int used[2];
+	int i, n;
+
+	n = usedVregs(instr, used);
+	for (i = 0; i < n; i++) {
+		if (used[i] == vreg) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/**
+ * @brief Replace "addr := base + scaled" with "scaled := var << k" by
+ * an induction pointer. All uses of addr follow in the same block with
+ * var unchanged, as they do for an element address.
+ *
+ * @return boolean - TRUE if the address was replaced
+ **/
+static boolean reduceAddress(Optimizer * o, Loop * loop, Instr * add,
+			     int base, int scaled)
+{
+	Instr *scale, *instr;
+	int var, found, ptr;
+
+	if (!isInvariant(o, base) || !isTemp(o, scaled) ||
+	    !isTemp(o, add->dst)) {
+		return FALSE;
+	}
+	for (scale = add->prev; scale != NULL && scale->block == add->block;
+	     scale = scale->prev) {
+		if (definesVreg(scale) && scale->dst == scaled) {
+			break;
+		}
+	}
+	if (scale == NULL || scale->block != add->block ||
+	    (scale->op != IR_SLL && scale->op != IR_MUL) ||
+	    scale->src2 != VREG_NONE) {
+		return FALSE;
+	}
+	var = scale->src1;
+	if (stepOf(o, var) == 0) {
+		return FALSE;
+	}
+	for (instr = scale->next; instr != add; instr = instr->next) {
+		if (definesVreg(instr) && instr->dst == var) {
+			return FALSE;
+		}
+	}
+	found = 0;
+	for (instr = add->next; instr != NULL && instr->block == add->block;
+	     instr = instr->next) {
+		if (readsVreg(instr, add->dst)) {
+			found++;
+		}
+		if (definesVreg(instr) && instr->dst == var) {
+			break;
+		}
+	}
+	if (found != o->uses[add->dst]) {
+		return FALSE;
+	}
+	ptr = getPointer(o, loop, base, scale);
+	for (instr = add->next; found > 0; instr = instr->next) {
+		if (readsVreg(instr, add->dst)) {
+			if (instr->src1 == add->dst) {
+				instr->src1 = ptr;
+			}
+			if (instr->src2 == add->dst) {
+				instr->src2 = ptr;
+			}
+			found--;
+		}
+	}
+	removeInstr(o->proc, add);
+	return TRUE;
+}
+
+static int reduceAddresses(Optimizer * o, Loop * loop)
+{
+	IrProc *proc;
+	Block *block;
+	Instr *instr, *next;
+	int reduced;
+
+	proc = o->proc;
+	o->pointers = (Pointer *) allocate((proc->numVregs + 1) * sizeof(Pointer));
+	o->numPointers = 0;
+	reduced = 0;
+	for (block = proc->blocks; block != NULL; block = block->next) {
+		if (!loop->blocks[block->id]) {
+			continue;
+		}
+		for (instr = block->first; instr != NULL; instr = next) {
+			next = instr == block->last ? NULL : instr->next;
+			if (instr->op != IR_ADD || instr->src2 == VREG_NONE) {
+				continue;
+			}
+			if (reduceAddress(o, loop, instr, instr->src1, instr->src2) ||
+			    reduceAddress(o, loop, instr, instr->src2, instr->src1)) {
+				reduced++;
+			}
+		}
+	}
+	return reduced;
+}
+
+/**************************************************************/
+
+/**
+ * @brief Move loop-invariant computations in front of their loops and
+ * address array elements indexed by a counted variable through an
+ * induction pointer
+ *
+ * @param proc procedure with control flow graph
+ * @return void
+ **/
+void optimizeLoops(IrProc * proc)
+{
+	Optimizer o;
+	Loop *loops;
+	int numLoops, i;
+
+	if (proc->blocks == NULL) {
+		return;
+	}
+	memset(&o, 0, sizeof(Optimizer));
+	o.proc = proc;
+	loops = findLoops(proc, &numLoops);
+	for (i = 0; i < numLoops; i++) {
+		if (loops[i].preheader == NULL || loops[i].hasCall) {
+			continue;
+		}
+		countVregs(&o, &loops[i]);
+		proc->numHoisted += hoistInvariants(&o, &loops[i]);
+		proc->numReduced += reduceAddresses(&o, &loops[i]);
+	}
+}
@@ -0,0 +1,10 @@
+/*
+ * loop.h -- loop-invariant code motion and strength reduction
+ */
+
+#ifndef _LOOP_H_
+#define _LOOP_H_
+
+void optimizeLoops(IrProc * proc);
+
+#endif				/* _LOOP_H_ */
@@ -6,6 +6,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "common.h"
 #include "utils.h"
@@ -14,10 +18,15 @@
 #include "absyn.h"
 #include "scanner.h"
 #include "parser.h"
+#include "parser.tab.h"
 #include "table.h"
 #include "semant.h"
+#include "fold.h"
+#include "prune.h"
 #include "varalloc.h"
+#include "inliner.h"
 #include "codegen.h"
+#include "interp.h"
 
 
 #define VERSION		"1.1"
@@ -31,35 +40,584 @@ static void version(char *myself) {
 static void help(char *myself) {
   /* show some help how to use the program */
   printf("Usage: %s [options] <input file> <output file>\n", myself);
+  printf("       %s --run [options] <input file>\n", myself);
+  printf("       %s --server [options]\n", myself);
+  printf("       %s --batch --out-dir <dir> [options] <input file>...\n",
+         myself);
   printf("Options:\n");
   printf("  --tokens         show stream of tokens\n");
   printf("  --absyn          show abstract syntax\n");
   printf("  --tables         show symbol tables\n");
   printf("  --vars           show variable allocation\n");
+  printf("  --ir             show intermediate code\n");
+  printf("  --stats          show optimization statistics\n");
+  printf("  --inline-threshold <n>\n");
+  printf("                   inline procedures up to size n (default %d, "
+         "0 for none)\n", DEFAULT_INLINE_THRESHOLD);
+  printf("  --jobs <n>, -j <n>\n");
+  printf("                   check and translate procedures (with --batch: "
+         "files)\n");
+  printf("                   on n threads\n");
+  printf("                   (default one per processor)\n");
+  printf("  --cache-dir <dir>\n");
+  printf("                   reuse the code of unchanged procedures "
+         "from dir\n");
+  printf("  --run            run the program instead of compiling it\n");
+  printf("  --server         compile the requests read from stdin, "
+         "one per line\n");
+  printf("  --batch          compile every input file into the output "
+         "directory\n");
+  printf("  --out-dir <dir>  output directory of --batch\n");
   printf("  --version        show compiler version\n");
   printf("  --help           show this help\n");
 }
 
 
+typedef struct {
+  char *inFileName;
+  char *outFileName;
+  FILE *inFile;		/* open while the unit is parsed */
+  Scanner scanner;	/* NULL unless the unit is parsed */
+  FILE *outFile;	/* open while the code is written */
+  char *message;	/* error, NULL if the unit was compiled */
+  boolean done;
+} Unit;
+
+
+typedef struct {
+  Unit *units;		/* in the order of the command line */
+  int numUnits;
+  int nextUnit;		/* first unit not taken by a worker */
+  CodegenOptions *codegenOptions;
+  pthread_mutex_t lock;	/* protects nextUnit and done */
+  pthread_cond_t unitDone;
+} Batch;
+
+
+static char *copyString(char *s) {
+  char *copy;
+
+  copy = malloc(strlen(s) + 1);
+  if (copy == NULL) {
+    error("out of memory");
+  }
+  strcpy(copy, s);
+  return copy;
+}
+
+
+static void openInput(Unit *unit) {
+  unit->inFile = fopen(unit->inFileName, "r");
+  if (unit->inFile == NULL) {
+    error("cannot open input file '%s'", unit->inFileName);
+  }
+  unit->scanner = newScanner(unit->inFile);
+}
+
+
+static void closeInput(Unit *unit) {
+  if (unit->scanner != NULL) {
+    freeScanner(unit->scanner);
+    unit->scanner = NULL;
+  }
+  if (unit->inFile != NULL) {
+    fclose(unit->inFile);
+    unit->inFile = NULL;
+  }
+}
+
+
+static Absyn *parseInput(Unit *unit) {
+  AbsynRef root;
+  Absyn *program;
+
+  selectArena(ARENA_PARSE);
+  startAbsyn();
+  yyparse(&root, unit->scanner);
+  closeInput(unit);
+  program = compactAbsyn(root, ARENA_ABSYN);
+  releaseArena(ARENA_PARSE);
+  return program;
+}
+
+
+static Table *analyze(Absyn **program, boolean optionTables,
+                      boolean optionVars, int numThreads) {
+  Table *globalTable;
+
+  selectArena(ARENA_SEMANT);
+  globalTable = check(*program, optionTables, numThreads);
+  foldConstants(*program);
+  selectArena(ARENA_VARALLOC);
+  allocVars(*program, globalTable, optionVars);
+  *program = removeUnusedProcs(*program, globalTable);
+  return globalTable;
+}
+
+
+static void compile(Unit *unit, Absyn *program, Table *globalTable,
+                    CodegenOptions *codegenOptions) {
+  unit->outFile = fopen(unit->outFileName, "w");
+  if (unit->outFile == NULL) {
+    error("cannot open output file '%s'", unit->outFileName);
+  }
+  selectArena(ARENA_CODEGEN);
+  genCode(program, globalTable, unit->outFile, codegenOptions);
+  fclose(unit->outFile);
+  unit->outFile = NULL;
+}
+
+
+/*
+ * Compile a unit in the calling thread without ending the program on
+ * an error: the message is kept in the unit, no output file is left
+ * behind, and everything but the symbols is released. Every unit has a
+ * scanner of its own, so units are parsed concurrently as well.
+ */
+static void runUnit(Unit *unit, CodegenOptions *codegenOptions) {
+  jmp_buf handler;
+  Absyn *program;
+  Table *globalTable;
+
+  unit->inFile = NULL;
+  unit->scanner = NULL;
+  unit->outFile = NULL;
+  unit->message = NULL;
+  if (setjmp(handler) == 0) {
+    catchErrors(&handler);
+    openInput(unit);
+    program = parseInput(unit);
+    globalTable = analyze(&program, FALSE, FALSE,
+                          codegenOptions->numThreads);
+    compile(unit, program, globalTable, codegenOptions);
+  } else {
+    unit->message = copyString(errorMessage());
+    closeInput(unit);
+    if (unit->outFile != NULL) {
+      fclose(unit->outFile);
+      unit->outFile = NULL;
+      remove(unit->outFileName);
+    }
+  }
+  catchErrors(NULL);
+  releaseUnit();
+}
+
+
+static void putJsonString(char *s) {
+  putchar('"');
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\') {
+      printf("\\%c", *s);
+    } else if ((unsigned char) *s < ' ') {
+      printf("\\u%04x", *s);
+    } else {
+      putchar(*s);
+    }
+  }
+  putchar('"');
+}
+
+
+static char *skipBlanks(char *p) {
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+    p++;
+  }
+  return p;
+}
+
+
+/* value of 4 hex digits, -1 if there are none */
+static int hexValue(char *p) {
+  int value, i;
+
+  value = 0;
+  for (i = 0; i < 4; i++) {
+    value <<= 4;
+    if (p[i] >= '0' && p[i] <= '9') {
+      value |= p[i] - '0';
+    } else if (p[i] >= 'a' && p[i] <= 'f') {
+      value |= p[i] - 'a' + 10;
+    } else if (p[i] >= 'A' && p[i] <= 'F') {
+      value |= p[i] - 'A' + 10;
+    } else {
+      return -1;
+    }
+  }
+  return value;
+}
+
+
+static char *putUtf8(char *q, int c) {
+  if (c < 0x80) {
+    *q++ = c;
+  } else if (c < 0x800) {
+    *q++ = 0xC0 | (c >> 6);
+    *q++ = 0x80 | (c & 0x3F);
+  } else if (c < 0x10000) {
+    *q++ = 0xE0 | (c >> 12);
+    *q++ = 0x80 | ((c >> 6) & 0x3F);
+    *q++ = 0x80 | (c & 0x3F);
+  } else {
+    *q++ = 0xF0 | (c >> 18);
+    *q++ = 0x80 | ((c >> 12) & 0x3F);
+    *q++ = 0x80 | ((c >> 6) & 0x3F);
+    *q++ = 0x80 | (c & 0x3F);
+  }
+  return q;
+}
+
+
+/*
+ * Decode the JSON string starting at the quote p in place; it never
+ * gets longer. Returns the position after the closing quote, or NULL
+ * if the string is malformed or contains a NUL.
+ */
+static char *getJsonString(char *p, char **value) {
+  char *q;
+  int c, low;
+
+  *value = p;
+  q = p;
+  p++;
+  while (*p != '"') {
+    if ((unsigned char) *p < ' ') {
+      /* also the end of the line */
+      return NULL;
+    }
+    if (*p != '\\') {
+      *q++ = *p++;
+      continue;
+    }
+    p++;
+    switch (*p++) {
+      case '"':
+      case '\\':
+      case '/':
+        *q++ = p[-1];
+        break;
+      case 'b':
+        *q++ = '\b';
+        break;
+      case 'f':
+        *q++ = '\f';
+        break;
+      case 'n':
+        *q++ = '\n';
+        break;
+      case 'r':
+        *q++ = '\r';
+        break;
+      case 't':
+        *q++ = '\t';
+        break;
+      case 'u':
+        c = hexValue(p);
+        if (c <= 0 || (c >= 0xDC00 && c <= 0xDFFF)) {
+          return NULL;
+        }
+        p += 4;
+        if (c >= 0xD800 && c <= 0xDBFF) {
+          /* a surrogate pair */
+          if (p[0] != '\\' || p[1] != 'u') {
+            return NULL;
+          }
+          low = hexValue(p + 2);
+          if (low < 0xDC00 || low > 0xDFFF) {
+            return NULL;
+          }
+          p += 6;
+          c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        }
+        q = putUtf8(q, c);
+        break;
+      default:
+        return NULL;
+    }
+  }
+  *q = '\0';
+  return p + 1;
+}
+
+
+/*
+ * A request is one JSON object with the string members "input" and
+ * "output", e.g. {"input": "Tests/sort.spl", "output": "sort.s"}.
+ * Returns NULL if the line is one, else what is wrong with it.
+ */
+static char *parseRequest(char *line, char **inFileName,
+                          char **outFileName) {
+  char *p, *name, *value;
+
+  *inFileName = NULL;
+  *outFileName = NULL;
+  p = skipBlanks(line);
+  if (*p != '{') {
+    return "request is not a JSON object";
+  }
+  p = skipBlanks(p + 1);
+  while (*p != '}') {
+    if (*p != '"' || (p = getJsonString(p, &name)) == NULL) {
+      return "malformed member name in request";
+    }
+    p = skipBlanks(p);
+    if (*p != ':') {
+      return "missing ':' in request";
+    }
+    p = skipBlanks(p + 1);
+    if (*p != '"' || (p = getJsonString(p, &value)) == NULL) {
+      return "member of request is not a well-formed string";
+    }
+    if (strcmp(name, "input") == 0 && *inFileName == NULL) {
+      *inFileName = value;
+    } else if (strcmp(name, "output") == 0 && *outFileName == NULL) {
+      *outFileName = value;
+    } else {
+      return "unknown or repeated member in request";
+    }
+    p = skipBlanks(p);
+    if (*p == ',') {
+      p = skipBlanks(p + 1);
+      if (*p == '}') {
+        return "missing member after ',' in request";
+      }
+    } else if (*p != '}') {
+      return "missing ',' or '}' in request";
+    }
+  }
+  if (*skipBlanks(p + 1) != '\0') {
+    return "text after the request";
+  }
+  if (*inFileName == NULL || *outFileName == NULL) {
+    return "request needs \"input\" and \"output\"";
+  }
+  return NULL;
+}
+
+
+/*
+ * Every line of stdin is a request, see parseRequest(); blank lines
+ * are skipped. The symbols stay interned from one request to the next,
+ * everything else of a unit is released. For every request one line
+ * with a JSON object is written to stdout, with "status" either "ok"
+ * or "error"; an error also has a "message", and no output file is
+ * left behind. The reply to a malformed line has no "input" and
+ * "output", and nothing is compiled for it.
+ */
+static void serve(CodegenOptions *codegenOptions) {
+  char *line;
+  size_t size;
+  ssize_t length;
+  char *malformed;
+  Unit unit;
+
+  line = NULL;
+  size = 0;
+  while ((length = getline(&line, &size, stdin)) != -1) {
+    if (strlen(line) != length) {
+      malformed = "request contains a NUL character";
+    } else if (*skipBlanks(line) == '\0') {
+      continue;
+    } else {
+      malformed = parseRequest(line, &unit.inFileName, &unit.outFileName);
+    }
+    if (malformed != NULL) {
+      printf("{\"status\": \"error\", \"message\": ");
+      putJsonString(malformed);
+      printf("}\n");
+      fflush(stdout);
+      continue;
+    }
+    runUnit(&unit, codegenOptions);
+    printf("{\"input\": ");
+    putJsonString(unit.inFileName);
+    printf(", \"output\": ");
+    putJsonString(unit.outFileName);
+    if (unit.message != NULL) {
+      printf(", \"status\": \"error\", \"message\": ");
+      putJsonString(unit.message);
+      printf("}\n");
+      free(unit.message);
+    } else {
+      printf(", \"status\": \"ok\"}\n");
+    }
+    fflush(stdout);
+  }
+  free(line);
+}
+
+
+static void *runWorker(void *arg) {
+  Batch *batch;
+  int i;
+
+  batch = (Batch *) arg;
+  for (;;) {
+    pthread_mutex_lock(&batch->lock);
+    i = batch->nextUnit;
+    if (i < batch->numUnits) {
+      batch->nextUnit++;
+    }
+    pthread_mutex_unlock(&batch->lock);
+    if (i == batch->numUnits) {
+      break;
+    }
+    runUnit(&batch->units[i], batch->codegenOptions);
+    pthread_mutex_lock(&batch->lock);
+    batch->units[i].done = TRUE;
+    pthread_cond_broadcast(&batch->unitDone);
+    pthread_mutex_unlock(&batch->lock);
+  }
+  return NULL;
+}
+
+
+/* "dir/name.s" for "some/path/name.spl" */
+static char *outFileNameFor(char *outDir, char *inFileName) {
+  char *base, *name;
+  int length;
+
+  base = strrchr(inFileName, '/');
+  base = base == NULL ? inFileName : base + 1;
+  length = strlen(base);
+  if (length > 4 && strcmp(base + length - 4, ".spl") == 0) {
+    length -= 4;
+  }
+  name = malloc(strlen(outDir) + length + 4);
+  if (name == NULL) {
+    error("out of memory");
+  }
+  sprintf(name, "%s/%.*s.s", outDir, length, base);
+  return name;
+}
+
+
+/*
+ * Compile every file into the output directory, numThreads files at a
+ * time; the procedures of one file are translated by a single thread.
+ * The errors are reported in the order of the command line, one line
+ * per file that could not be compiled.
+ */
+static int compileBatch(char **fileNames, int numFiles, char *outDir,
+                        int numThreads, CodegenOptions *codegenOptions) {
+  Batch batch;
+  CodegenOptions unitOptions;
+  pthread_t *threads;
+  int i, j, status;
+
+  if (mkdir(outDir, 0777) != 0 && errno != EEXIST) {
+    error("cannot create output directory '%s'", outDir);
+  }
+  batch.units = malloc((numFiles + 1) * sizeof(Unit));
+  if (batch.units == NULL) {
+    error("out of memory");
+  }
+  for (i = 0; i < numFiles; i++) {
+    batch.units[i].inFileName = fileNames[i];
+    batch.units[i].outFileName = outFileNameFor(outDir, fileNames[i]);
+    batch.units[i].done = FALSE;
+    for (j = 0; j < i; j++) {
+      if (strcmp(batch.units[i].outFileName,
+                 batch.units[j].outFileName) == 0) {
+        error("files '%s' and '%s' would both be compiled into '%s'",
+              fileNames[j], fileNames[i], batch.units[i].outFileName);
+      }
+    }
+  }
+  batch.numUnits = numFiles;
+  batch.nextUnit = 0;
+  unitOptions = *codegenOptions;
+  unitOptions.numThreads = 1;
+  batch.codegenOptions = &unitOptions;
+  if (numThreads > numFiles) {
+    numThreads = numFiles;
+  }
+  threads = NULL;
+  if (numThreads > 1) {
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.unitDone, NULL);
+    threads = malloc(numThreads * sizeof(pthread_t));
+    if (threads == NULL) {
+      error("out of memory");
+    }
+    for (i = 0; i < numThreads; i++) {
+      if (pthread_create(&threads[i], NULL, runWorker, &batch) != 0) {
+        error("cannot create compiler thread");
+      }
+    }
+  }
+  status = 0;
+  for (i = 0; i < numFiles; i++) {
+    if (threads == NULL) {
+      runUnit(&batch.units[i], batch.codegenOptions);
+    } else {
+      pthread_mutex_lock(&batch.lock);
+      while (!batch.units[i].done) {
+        pthread_cond_wait(&batch.unitDone, &batch.lock);
+      }
+      pthread_mutex_unlock(&batch.lock);
+    }
+    if (batch.units[i].message != NULL) {
+      printf("Error: %s: %s\n", fileNames[i], batch.units[i].message);
+      free(batch.units[i].message);
+      status = 1;
+    }
+    free(batch.units[i].outFileName);
+  }
+  if (threads != NULL) {
+    for (i = 0; i < numThreads; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_cond_destroy(&batch.unitDone);
+    pthread_mutex_destroy(&batch.lock);
+  }
+  free(batch.units);
+  return status;
+}
+
+
 int main(int argc, char *argv[]) {
   int i;
+  char **fileNames;
+  int numFiles;
   char *inFileName;
   char *outFileName;
+  char *outDir;
   boolean optionTokens;
   boolean optionAbsyn;
   boolean optionTables;
   boolean optionVars;
+  boolean optionRun;
+  boolean optionServer;
+  boolean optionBatch;
+  CodegenOptions codegenOptions;
   int token;
+  YYSTYPE value;
+  Absyn *program;
   Table *globalTable;
-  FILE *outFile;
+  Unit unit;
+  int status;
 
   /* analyze command line */
-  inFileName = NULL;
-  outFileName = NULL;
+  fileNames = malloc(argc * sizeof(char *));
+  if (fileNames == NULL) {
+    error("out of memory");
+  }
+  numFiles = 0;
+  outDir = NULL;
   optionTokens = FALSE;
   optionAbsyn = FALSE;
   optionTables = FALSE;
   optionVars = FALSE;
+  optionRun = FALSE;
+  optionServer = FALSE;
+  optionBatch = FALSE;
+  codegenOptions.showIr = FALSE;
+  codegenOptions.showStats = FALSE;
+  codegenOptions.inlineThreshold = DEFAULT_INLINE_THRESHOLD;
+  codegenOptions.numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  codegenOptions.cacheDir = NULL;
   for (i = 1; i < argc; i++) {
     if (argv[i][0] == '-') {
       /* option */
@@ -75,6 +633,46 @@ int main(int argc, char *argv[]) {
       if (strcmp(argv[i], "--vars") == 0) {
         optionVars = TRUE;
       } else
+      if (strcmp(argv[i], "--ir") == 0) {
+        codegenOptions.showIr = TRUE;
+      } else
+      if (strcmp(argv[i], "--stats") == 0) {
+        codegenOptions.showStats = TRUE;
+      } else
+      if (strcmp(argv[i], "--inline-threshold") == 0) {
+        if (i + 1 == argc) {
+          error("option '%s' needs a size", argv[i]);
+        }
+        codegenOptions.inlineThreshold = atoi(argv[++i]);
+      } else
+      if (strcmp(argv[i], "--jobs") == 0 ||
+          strcmp(argv[i], "-j") == 0) {
+        if (i + 1 == argc) {
+          error("option '%s' needs a number", argv[i]);
+        }
+        codegenOptions.numThreads = atoi(argv[++i]);
+      } else
+      if (strcmp(argv[i], "--cache-dir") == 0) {
+        if (i + 1 == argc) {
+          error("option '%s' needs a directory", argv[i]);
+        }
+        codegenOptions.cacheDir = argv[++i];
+      } else
+      if (strcmp(argv[i], "--run") == 0) {
+        optionRun = TRUE;
+      } else
+      if (strcmp(argv[i], "--server") == 0) {
+        optionServer = TRUE;
+      } else
+      if (strcmp(argv[i], "--batch") == 0) {
+        optionBatch = TRUE;
+      } else
+      if (strcmp(argv[i], "--out-dir") == 0) {
+        if (i + 1 == argc) {
+          error("option '%s' needs a directory", argv[i]);
+        }
+        outDir = argv[++i];
+      } else
       if (strcmp(argv[i], "--version") == 0) {
         version(argv[0]);
         exit(0);
@@ -88,47 +686,76 @@ int main(int argc, char *argv[]) {
       }
     } else {
       /* file */
-      if (outFileName != NULL) {
-        error("more than two file names not allowed");
-      }
-      if (inFileName != NULL) {
-        outFileName = argv[i];
-      } else {
-        inFileName = argv[i];
-      }
+      fileNames[numFiles++] = argv[i];
     }
   }
+  if (optionServer || optionBatch) {
+    /* stdout carries the replies, nothing else may be shown there */
+    if (optionTokens || optionAbsyn || optionTables || optionVars ||
+        optionRun || codegenOptions.showIr || codegenOptions.showStats) {
+      error("options '--server' and '--batch' show nothing");
+    }
+  }
+  if (optionServer) {
+    if (numFiles != 0 || optionBatch) {
+      error("option '--server' takes no files");
+    }
+    serve(&codegenOptions);
+    return 0;
+  }
+  if (optionBatch) {
+    if (outDir == NULL) {
+      error("option '--batch' needs '--out-dir'");
+    }
+    if (numFiles == 0) {
+      error("no input file");
+    }
+    status = compileBatch(fileNames, numFiles, outDir,
+                          codegenOptions.numThreads, &codegenOptions);
+    free(fileNames);
+    return status;
+  }
+  if (outDir != NULL) {
+    error("option '--out-dir' needs '--batch'");
+  }
+  if (numFiles > 2) {
+    error("more than two file names not allowed");
+  }
+  inFileName = numFiles > 0 ? fileNames[0] : NULL;
+  outFileName = numFiles > 1 ? fileNames[1] : NULL;
+  free(fileNames);
   if (inFileName == NULL) {
     error("no input file");
   }
-  if (outFileName == NULL) {
+  if (outFileName == NULL && !optionRun) {
     error("no output file");
   }
-  yyin = fopen(inFileName, "r");
-  if (yyin == NULL) {
-    error("cannot open input file '%s'", inFileName);
-  }
+  unit.inFileName = inFileName;
+  unit.outFileName = outFileName;
+  openInput(&unit);
+  selectArena(ARENA_PARSE);
   if (optionTokens) {
     do {
-      token = yylex();
-      showToken(token);
+      token = yylex(&value, unit.scanner);
+      showToken(token, &value);
     } while (token != 0);
-    fclose(yyin);
+    closeInput(&unit);
     exit(0);
   }
-  yyparse();
-  fclose(yyin);
+  program = parseInput(&unit);
   if (optionAbsyn) {
-    showAbsyn(progTree);
+    showAbsyn(program);
     exit(0);
   }
-  globalTable = check(progTree, optionTables);
-  allocVars(progTree, globalTable, optionVars);
-  outFile = fopen(outFileName, "w");
-  if (outFile == NULL) {
-    error("cannot open output file '%s'", outFileName);
+  globalTable = analyze(&program, optionTables, optionVars,
+                        codegenOptions.numThreads);
+  if (optionRun) {
+    selectArena(ARENA_CODEGEN);
+    status = runProgram(program, globalTable);
+    releaseUnit();
+    return status;
   }
-  genCode(progTree, globalTable, outFile);
-  fclose(outFile);
+  compile(&unit, program, globalTable, &codegenOptions);
+  releaseUnit();
   return 0;
 }
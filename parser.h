@@ -5,9 +5,7 @@
 #ifndef _PARSER_H_
 #define _PARSER_H_
 
-extern Absyn *progTree;
-
-int yyparse(void);
-void yyerror(char *msg);
+int yyparse(AbsynRef * program, Scanner scanner);
+void yyerror(AbsynRef * program, Scanner scanner, char *msg);
 
 #endif				/* _PARSER_H_ */
@@ -17,16 +17,19 @@
 
 #define YYDEBUG 1
 
-Absyn *progTree;
-
 %}
 
+%define api.pure
+%lex-param	{ Scanner scanner }
+%parse-param	{ AbsynRef *program }
+%parse-param	{ Scanner scanner }
+
 %union
 {
 	NoVal noVal;
 	IntVal intVal;
-	StringVal stringVal;
-	Absyn *node;
+	SymVal symVal;
+	AbsynRef node;
 }
 
 /*______________________________Tokendefinitionen___________________________*/
@@ -35,7 +38,7 @@ Absyn *progTree;
 				EQ NE LT LE GT GE ASGN COLON COMMA SEMIC
 				PLUS  MINUS  STAR  SLASH
 
-%token <stringVal>		IDENT
+%token <symVal>			IDENT
 
 %token <intVal>			INTLIT
 //////////////////////////////////////////////////////////////////////////////
@@ -60,7 +63,7 @@ Absyn *progTree;
 
 /*______________________________Hauptprogramm_______________________________*/
 program		:	declarations
-			{ progTree = $1; $$ = $1; }
+			{ *program = $1; $$ = $1; }
 ;
 //////////////////////////////////////////////////////////////////////////////
 
@@ -78,11 +81,11 @@ declarations	: 	/*empty*/
 /*______________________________Typen_______________________________________*/
 
 type_def	:	TYPE IDENT EQ typ SEMIC
-			{ $$ = newTypeDec($1.line, newSym($2.val), $4); }
+			{ $$ = newTypeDec($1.line, $2.val, $4); }
 ;
 
 typ		:	IDENT
-			{ $$ = newNameTy($1.line, newSym($1.val)); }
+			{ $$ = newNameTy($1.line, $1.val); }
 		|	ARRAY LBRACK INTLIT RBRACK OF typ
 			{ $$ = newArrayTy($1.line, $3.val, $6); }
 ;
@@ -94,16 +97,16 @@ procedure	:	PROC IDENT LPAREN opt_parameters RPAREN
 			LCURL
 				opt_variables opt_statements
 			RCURL
-			{ $$ = newProcDec($1.line, newSym($2.val), $4, $7, $8); }
+			{ $$ = newProcDec($1.line, $2.val, $4, $7, $8); }
 ;
 //////////////////////////////////////////////////////////////////////////////
 
 
 /*____________________________Parameter_____________________________________*/
 parameter	:	IDENT COLON typ
-			{ $$ = newParDec($1.line, newSym($1.val), $3, FALSE); }
+			{ $$ = newParDec($1.line, $1.val, $3, FALSE); }
 		|	REF IDENT COLON typ
-			{ $$ = newParDec($1.line, newSym($2.val), $4, TRUE); }
+			{ $$ = newParDec($1.line, $2.val, $4, TRUE); }
 ;
 
 add_parameter	:	parameter
@@ -122,13 +125,13 @@ opt_parameters	:	/*empty*/
 
 /*_____________________________Variablen____________________________________*/
 variable	:	IDENT
-			{ $$ = newSimpleVar($1.line, newSym($1.val)); }
+			{ $$ = newSimpleVar($1.line, $1.val); }
 		|	variable LBRACK expression RBRACK
-			{ $$ = newArrayVar($1->line, $1, $3); }
+			{ $$ = newArrayVar(ABSYN($1)->line, $1, $3); }
 ;
 
 variable_decl	:	VAR IDENT COLON typ SEMIC
-			{ $$ = newVarDec($1.line, newSym($2.val), $4); }
+			{ $$ = newVarDec($1.line, $2.val, $4); }
 ;
 
 opt_variables	:	/*empty*/
@@ -179,9 +182,9 @@ factor_expr	:	MINUS factor_expr
 		|	INTLIT
 			{ $$ = newIntExp($1.line, $1.val); }
 		|	variable
-			{ $$ = newVarExp($1->line, $1); }
+			{ $$ = newVarExp(ABSYN($1)->line, $1); }
 		|	LPAREN expression RPAREN
-			{ $$ = $2 }
+			{ $$ = $2; }
 ;
 
 add_expression	:	expression
@@ -202,7 +205,7 @@ opt_expressions	:	/* empty */
 statement	:	SEMIC
 			{ $$ = newEmptyStm($1.line); }
 		|	variable ASGN expression SEMIC
-			{ $$ = newAssignStm($1->line, $1, $3); }
+			{ $$ = newAssignStm(ABSYN($1)->line, $1, $3); }
 		|	IF LPAREN expression RPAREN statement
 			{ $$ = newIfStm($1.line, $3, $5, newEmptyStm($1.line)); }
 		|	IF LPAREN expression RPAREN statement ELSE statement
@@ -212,7 +215,7 @@ statement	:	SEMIC
 		|	LCURL opt_statements RCURL
 			{ $$ = newCompStm($1.line, $2); }
 		|	IDENT LPAREN opt_expressions RPAREN SEMIC
-			{ $$ = newCallStm($1.line, newSym($1.val), $3); }
+			{ $$ = newCallStm($1.line, $1.val, $3); }
 ;
 
 opt_statements	:	/*empty*/
@@ -226,7 +229,7 @@ opt_statements	:	/*empty*/
 %%
 
 
-void yyerror(char *msg)
+void yyerror(AbsynRef *program, Scanner scanner, char *msg)
 {
-	error("%s in line %d", msg, yylval.noVal.line);
+	error("%s in line %d", msg, yyget_lval(scanner)->noVal.line);
 }
@@ -0,0 +1,504 @@
+/*
+ * peephole.c -- peephole optimization of ECO32 instructions
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "inliner.h"
+#include "alias.h"
+#include "ir.h"
+#include "regalloc.h"
+#include "asm.h"
+#include "peephole.h"
+
+/*
+ * The instructions of one procedure are rewritten until nothing
+ * changes any more. Deleted records are marked and squeezed out after
+ * every round. Jumps and labels are cleaned up first, then stores
+ * followed by loads of the same word are forwarded and moves are
+ * folded into the instruction computing their source.
+ */
+
+#define DELETED		(-1)	/* op of a removed record */
+
+typedef struct {
+	AsmCode *code;
+	int minLabel;
+	int numLabels;
+	int *labelPos;		/* record defining each label, -1 if none */
+	int *refs;		/* jumps and branches to each label */
+} Peephole;
+
+static boolean isBranch(AsmInstr * instr)
+{
+	return instr->op >= ASM_BEQ && instr->op <= ASM_BGEU &&
+	    instr->sym == NULL;
+}
+
+/* jump or branch to a label of this procedure */
+static boolean hasTarget(AsmInstr * instr)
+{
+	return instr->op == ASM_J || isBranch(instr);
+}
+
+static boolean endsBlock(AsmInstr * instr)
+{
+	switch (instr->op) {
+	case ASM_LABEL:
+	case ASM_PROC:
+	case ASM_J:
+	case ASM_JAL:
+	case ASM_JR:
+		return TRUE;
+	}
+	return instr->op >= ASM_BEQ && instr->op <= ASM_BGEU;
+}
+
+static boolean reads(AsmInstr * instr, int reg)
+{
+	switch (instr->op) {
+	case ASM_ADD:
+	case ASM_SUB:
+	case ASM_MUL:
+	case ASM_DIV:
+	case ASM_SLL:
+		return instr->src1 == reg ||
+		    (instr->src2 != ASM_IMM && instr->src2 == reg);
+	case ASM_OR:
+	case ASM_LDW:
+	case ASM_JR:
+		return instr->src1 == reg;
+	case ASM_STW:
+		return instr->src1 == reg || instr->src2 == reg;
+	}
+	if (instr->op >= ASM_BEQ && instr->op <= ASM_BGEU) {
+		return instr->src1 == reg || instr->src2 == reg;
+	}
+	return FALSE;
+}
+
+static boolean writes(AsmInstr * instr, int reg)
+{
+	switch (instr->op) {
+	case ASM_ADD:
+	case ASM_SUB:
+	case ASM_MUL:
+	case ASM_DIV:
+	case ASM_SLL:
+	case ASM_OR:
+	case ASM_LDHI:
+	case ASM_LDW:
+		return instr->dst == reg;
+	case ASM_JAL:
+		return reg == REG_RA;
+	}
+	return FALSE;
+}
+
+/**
+ * @brief Whether a register is not read any more after a record.
+ * Scratch registers never live beyond the end of a block, temporaries
+ * in caller-saved registers do not survive a call. Everything else is
+ * assumed to be live at the end of a block.
+ *
+ * @param code instructions
+ * @param pos record after which the register is set
+ * @param reg register
+ * @return boolean - TRUE if the value is never used
+ **/
+static boolean isDeadAfter(AsmCode * code, int pos, int reg)
+{
+	AsmInstr *instr;
+	int i;
+
+	for (i = pos + 1; i < code->count; i++) {
+		instr = &code->instrs[i];
+		if (instr->op == DELETED) {
+			continue;
+		}
+		if (reads(instr, reg)) {
+			return FALSE;
+		}
+		if (writes(instr, reg)) {
+			return TRUE;
+		}
+		if (instr->op == ASM_JAL) {
+			return reg >= REG_CALLER_MIN && reg <= REG_SCRATCH2;
+		}
+		if (endsBlock(instr)) {
+			return reg == REG_SCRATCH1 || reg == REG_SCRATCH2;
+		}
+	}
+	return FALSE;
+}
+
+/* next record that is neither deleted nor a label, count if none */
+static int nextInstr(AsmCode * code, int pos)
+{
+	while (pos < code->count &&
+	       (code->instrs[pos].op == DELETED ||
+		code->instrs[pos].op == ASM_LABEL)) {
+		pos++;
+	}
+	return pos;
+}
+
+static void findLabels(Peephole * p)
+{
+	AsmCode *code;
+	AsmInstr *instr;
+	boolean first;
+	int i, maxLabel;
+
+	code = p->code;
+	first = TRUE;
+	p->minLabel = 0;
+	maxLabel = -1;
+	for (i = 0; i < code->count; i++) {
+		instr = &code->instrs[i];
+		if (instr->op != ASM_LABEL && !hasTarget(instr)) {
+			continue;
+		}
+		if (first || instr->label < p->minLabel) {
+			p->minLabel = instr->label;
+		}
+		if (first || instr->label > maxLabel) {
+			maxLabel = instr->label;
+		}
+		first = FALSE;
+	}
+	p->numLabels = maxLabel - p->minLabel + 1;
+	p->labelPos = (int *) allocate((p->numLabels + 1) * sizeof(int));
+	p->refs = (int *) allocate((p->numLabels + 1) * sizeof(int));
+	for (i = 0; i < p->numLabels; i++) {
+		p->labelPos[i] = -1;
+		p->refs[i] = 0;
+	}
+	for (i = 0; i < code->count; i++) {
+		instr = &code->instrs[i];
+		if (instr->op == ASM_LABEL) {
+			p->labelPos[instr->label - p->minLabel] = i;
+		} else if (hasTarget(instr)) {
+			p->refs[instr->label - p->minLabel]++;
+		}
+	}
+}
+
+/* first instruction executed after a jump to label */
+static int jumpDestination(Peephole * p, int label)
+{
+	int pos;
+
+	pos = p->labelPos[label - p->minLabel];
+	if (pos < 0) {
+		error("undefined label L%d in peephole optimization", label);
+	}
+	return nextInstr(p->code, pos);
+}
+
+static void retarget(Peephole * p, AsmInstr * instr, int label)
+{
+	p->refs[instr->label - p->minLabel]--;
+	p->refs[label - p->minLabel]++;
+	instr->label = label;
+}
+
+/* jumps and branches to a jump go to its target directly */
+static boolean threadJumps(Peephole * p)
+{
+	AsmCode *code;
+	AsmInstr *instr;
+	boolean changed;
+	int i, dest, hops;
+
+	code = p->code;
+	changed = FALSE;
+	for (i = 0; i < code->count; i++) {
+		instr = &code->instrs[i];
+		if (!hasTarget(instr)) {
+			continue;
+		}
+		/* a loop of jumps has no end, give up after one round */
+		for (hops = 0; hops < p->numLabels; hops++) {
+			dest = jumpDestination(p, instr->label);
+			if (dest == code->count || code->instrs[dest].op != ASM_J ||
+			    code->instrs[dest].label == instr->label) {
+				break;
+			}
+			retarget(p, instr, code->instrs[dest].label);
+			changed = TRUE;
+		}
+	}
+	return changed;
+}
+
+static int invertBranch(int op)
+{
+	switch (op) {
+	case ASM_BEQ:	return ASM_BNE;
+	case ASM_BNE:	return ASM_BEQ;
+	case ASM_BLT:	return ASM_BGE;
+	case ASM_BLE:	return ASM_BGT;
+	case ASM_BGT:	return ASM_BLE;
+	case ASM_BGE:	return ASM_BLT;
+	}
+	return DELETED;
+}
+
+/**
+ * @brief Remove jumps to the next instruction and turn a branch
+ * around a jump into one inverted branch
+ **/
+static boolean removeJumpsToNext(Peephole * p)
+{
+	AsmCode *code;
+	AsmInstr *instr, *jump;
+	boolean changed;
+	int i, next;
+
+	code = p->code;
+	changed = FALSE;
+	for (i = 0; i < code->count; i++) {
+		instr = &code->instrs[i];
+		if (!hasTarget(instr)) {
+			continue;
+		}
+		next = nextInstr(code, i + 1);
+		if (jumpDestination(p, instr->label) == next) {
+			p->refs[instr->label - p->minLabel]--;
+			instr->op = DELETED;
+			changed = TRUE;
+			continue;
+		}
+		/* bcc L1; j L2; L1: => b!cc L2; L1: */
+		if (isBranch(instr) && invertBranch(instr->op) != DELETED &&
+		    i + 1 < code->count && code->instrs[i + 1].op == ASM_J &&
+		    jumpDestination(p, instr->label) == nextInstr(code, i + 2)) {
+			jump = &code->instrs[i + 1];
+			instr->op = invertBranch(instr->op);
+			retarget(p, instr, jump->label);
+			p->refs[jump->label - p->minLabel]--;
+			jump->op = DELETED;
+			changed = TRUE;
+		}
+	}
+	return changed;
+}
+
+/* nothing after an unconditional jump is reached without a label */
+static boolean removeUnreachable(Peephole * p)
+{
+	AsmCode *code;
+	AsmInstr *instr;
+	boolean changed;
+	int i;
+
+	code = p->code;
+	changed = FALSE;
+	for (i = 0; i < code->count; i++) {
+		if (code->instrs[i].op != ASM_J && code->instrs[i].op != ASM_JR) {
+			continue;
+		}
+		while (i + 1 < code->count) {
+			instr = &code->instrs[i + 1];
+			if (instr->op == ASM_LABEL || instr->op == ASM_PROC) {
+				break;
+			}
+			if (instr->op != DELETED) {
+				if (hasTarget(instr)) {
+					p->refs[instr->label - p->minLabel]--;
+				}
+				instr->op = DELETED;
+				changed = TRUE;
+			}
+			i++;
+		}
+	}
+	return changed;
+}
+
+static boolean removeDeadLabels(Peephole * p)
+{
+	AsmCode *code;
+	boolean changed;
+	int i;
+
+	code = p->code;
+	changed = FALSE;
+	for (i = 0; i < code->count; i++) {
+		if (code->instrs[i].op == ASM_LABEL &&
+		    p->refs[code->instrs[i].label - p->minLabel] == 0) {
+			code->instrs[i].op = DELETED;
+			changed = TRUE;
+		}
+	}
+	return changed;
+}
+
+/**
+ * @brief Replace a load of a word stored earlier in the same block by
+ * a move of the stored register. A store through another base register
+ * may hit the same word, so it ends the search.
+ **/
+static boolean forwardStores(Peephole * p)
+{
+	AsmCode *code;
+	AsmInstr *store, *instr;
+	boolean changed;
+	int i, j;
+
+	code = p->code;
+	changed = FALSE;
+	for (i = 0; i < code->count; i++) {
+		store = &code->instrs[i];
+		if (store->op != ASM_STW) {
+			continue;
+		}
+		for (j = i + 1; j < code->count; j++) {
+			instr = &code->instrs[j];
+			if (instr->op == DELETED) {
+				continue;
+			}
+			if (endsBlock(instr)) {
+				break;
+			}
+			if (instr->op == ASM_STW) {
+				if (instr->src1 != store->src1 ||
+				    instr->imm == store->imm) {
+					break;
+				}
+				continue;
+			}
+			if (instr->op == ASM_LDW && instr->src1 == store->src1 &&
+			    instr->imm == store->imm) {
+				if (instr->dst == store->src2) {
+					instr->op = DELETED;
+				} else {
+					instr->op = ASM_ADD;
+					instr->src1 = store->src2;
+					instr->src2 = REG_ZERO;
+					instr->comment = NULL;
+				}
+				changed = TRUE;
+			}
+			if (writes(instr, store->src1) || writes(instr, store->src2)) {
+				break;
+			}
+		}
+	}
+	return changed;
+}
+
+static boolean isMove(AsmInstr * instr)
+{
+	return instr->op == ASM_ADD && instr->src2 == REG_ZERO;
+}
+
+/**
+ * @brief Let the instruction computing a register write the target of
+ * a following move directly, e.g. "add $8,$0,5; add $9,$8,$0" becomes
+ * "add $9,$0,5" if $8 is not used afterwards. Moves of a register to
+ * itself are removed.
+ **/
+static boolean foldMoves(Peephole * p)
+{
+	AsmCode *code;
+	AsmInstr *move, *def;
+	boolean changed;
+	int i, j;
+
+	code = p->code;
+	changed = FALSE;
+	for (i = 0; i < code->count; i++) {
+		move = &code->instrs[i];
+		if (!isMove(move)) {
+			continue;
+		}
+		if (move->dst == move->src1) {
+			move->op = DELETED;
+			changed = TRUE;
+			continue;
+		}
+		for (j = i - 1; j >= 0 && code->instrs[j].op == DELETED; j--) ;
+		if (j < 0 || move->src1 == REG_ZERO || move->src1 == REG_SP ||
+		    move->src1 == REG_FP || move->src1 == REG_RA) {
+			continue;
+		}
+		def = &code->instrs[j];
+		switch (def->op) {
+		case ASM_ADD:
+		case ASM_SUB:
+		case ASM_MUL:
+		case ASM_DIV:
+		case ASM_SLL:
+		case ASM_LDW:
+			break;
+		default:
+			continue;
+		}
+		if (def->dst != move->src1 || def->comment != NULL ||
+		    !isDeadAfter(code, i, move->src1)) {
+			continue;
+		}
+		def->dst = move->dst;
+		move->op = DELETED;
+		changed = TRUE;
+	}
+	return changed;
+}
+
+static void compact(AsmCode * code)
+{
+	int i, n;
+
+	n = 0;
+	for (i = 0; i < code->count; i++) {
+		if (code->instrs[i].op != DELETED) {
+			code->instrs[n++] = code->instrs[i];
+		}
+	}
+	code->count = n;
+}
+
+/**
+ * @brief Remove jumps to the next instruction, jumps to jumps, unused
+ * labels, unreachable code, loads of just stored words and moves that
+ * can be avoided from the instructions of a procedure
+ *
+ * @param code instructions of one procedure
+ * @return int - number of instructions saved
+ **/
+int optimizePeephole(AsmCode * code)
+{
+	Peephole p;
+	boolean changed;
+	int i, before;
+
+	before = 0;
+	for (i = 0; i < code->count; i++) {
+		before += code->instrs[i].op != ASM_LABEL;
+	}
+	p.code = code;
+	do {
+		findLabels(&p);
+		changed = threadJumps(&p);
+		changed |= removeJumpsToNext(&p);
+		changed |= removeUnreachable(&p);
+		changed |= removeDeadLabels(&p);
+		changed |= forwardStores(&p);
+		changed |= foldMoves(&p);
+		compact(code);
+	} while (changed);
+	for (i = 0; i < code->count; i++) {
+		before -= code->instrs[i].op != ASM_LABEL;
+	}
+	return before;
+}
@@ -0,0 +1,10 @@
+/*
+ * peephole.h -- peephole optimization of ECO32 instructions
+ */
+
+#ifndef _PEEPHOLE_H_
+#define _PEEPHOLE_H_
+
+int optimizePeephole(AsmCode * code);
+
+#endif				/* _PEEPHOLE_H_ */
@@ -0,0 +1,194 @@
+/*
+ * pool.c -- pool of worker threads
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "utils.h"
+#include "pool.h"
+
+/*
+ * The jobs of a pool are numbered from 0 and are taken in that order,
+ * each by the next worker that is free. The owner waits for the jobs
+ * in the same order and uses their results meanwhile. An error in a
+ * job is caught; it stops the pool, i.e. no further job is taken, and
+ * only the earliest failed job counts, so that the message does not
+ * depend on the number of threads. The owner reports it once the pool
+ * is finished, when no worker is running any more. Whatever a worker
+ * allocated is adopted by the owner when the worker ends.
+ *
+ * One counter of the next job is enough, no per-worker queues: a job
+ * is a whole procedure or file, so taking it under the lock is cheap
+ * in comparison, and since the owner needs the results in job order,
+ * handing out the jobs in that order is what keeps it busy.
+ */
+
+static void runJob(Pool * pool, int job)
+{
+	jmp_buf handler;
+	jmp_buf *previous;
+
+	previous = catchErrors(&handler);
+	if (setjmp(handler) == 0) {
+		pool->run(pool->context, job);
+	} else {
+		failJob(pool, job, errorMessage());
+	}
+	catchErrors(previous);
+	pthread_mutex_lock(&pool->lock);
+	pool->done[job] = TRUE;
+	pthread_cond_broadcast(&pool->jobDone);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void *runWorker(void *arg)
+{
+	Pool *pool;
+	int job;
+
+	pool = (Pool *) arg;
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		job = pool->nextJob;
+		if (job == pool->numJobs || pool->failedJob < pool->numJobs) {
+			break;
+		}
+		pool->nextJob++;
+		pthread_mutex_unlock(&pool->lock);
+		runJob(pool, job);
+	}
+	detachArenas(pool->chunks);
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+/**
+ * @brief Start the workers of a pool; if none can be started, the
+ * jobs are done by the owner as it waits for them
+ *
+ * @param pool gets the workers
+ * @param numThreads most workers wanted, 1 or less for none
+ * @param numJobs number of jobs
+ * @param run does one job
+ * @param context handed to run
+ * @return void
+ **/
+void startPool(Pool * pool, int numThreads, int numJobs,
+	       PoolJob * run, void *context)
+{
+	int i;
+
+	pool->run = run;
+	pool->context = context;
+	pool->numJobs = numJobs;
+	pool->nextJob = 0;
+	pool->done = (boolean *) malloc((numJobs + 1) * sizeof(boolean));
+	if (pool->done == NULL) {
+		error("out of memory");
+	}
+	memset(pool->done, 0, (numJobs + 1) * sizeof(boolean));
+	pool->failedJob = numJobs;
+	pool->message[0] = '\0';
+	memset(pool->chunks, 0, sizeof(ArenaChunks));
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->jobDone, NULL);
+	pool->threads = NULL;
+	pool->numThreads = 0;
+	if (numThreads > numJobs) {
+		numThreads = numJobs;
+	}
+	if (numThreads <= 1) {
+		return;
+	}
+	pool->threads = (pthread_t *) malloc(numThreads * sizeof(pthread_t));
+	if (pool->threads == NULL) {
+		return;
+	}
+	for (i = 0; i < numThreads; i++) {
+		if (pthread_create(&pool->threads[i], NULL,
+				   runWorker, pool) != 0) {
+			/* fewer workers do the same jobs */
+			break;
+		}
+		pool->numThreads++;
+	}
+}
+
+/**
+ * @brief Wait until a job is done, jobs being waited for in order
+ *
+ * @param pool pool
+ * @param job number of the job
+ * @return boolean - TRUE if it and all jobs before it succeeded,
+ * FALSE if the pool was stopped before it was done
+ **/
+boolean waitForJob(Pool * pool, int job)
+{
+	boolean succeeded;
+
+	if (pool->numThreads == 0) {
+		/* no worker takes jobs, nothing runs concurrently */
+		while (pool->nextJob <= job &&
+		       pool->failedJob == pool->numJobs) {
+			runJob(pool, pool->nextJob++);
+		}
+		return pool->done[job] && job < pool->failedJob;
+	}
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->done[job] &&
+	       !(pool->failedJob < pool->numJobs && job >= pool->nextJob)) {
+		pthread_cond_wait(&pool->jobDone, &pool->lock);
+	}
+	succeeded = pool->done[job] && job < pool->failedJob;
+	pthread_mutex_unlock(&pool->lock);
+	return succeeded;
+}
+
+/**
+ * @brief Let a job fail and stop the pool; also used by the owner for
+ * what it does with the result of a job
+ *
+ * @param pool pool
+ * @param job number of the job
+ * @param message kept if no earlier job failed
+ * @return void
+ **/
+void failJob(Pool * pool, int job, char *message)
+{
+	pthread_mutex_lock(&pool->lock);
+	if (job < pool->failedJob) {
+		pool->failedJob = job;
+		snprintf(pool->message, ERROR_MESSAGE_SIZE, "%s", message);
+	}
+	pthread_cond_broadcast(&pool->jobDone);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Let the workers end after the jobs they are doing, wait for
+ * them and adopt their memory; the failure of a job, if any, is left
+ * in the pool for the owner to report
+ *
+ * @param pool pool
+ * @return void
+ **/
+void finishPool(Pool * pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->nextJob = pool->numJobs;
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->numThreads; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	attachArenas(pool->chunks);
+	pthread_cond_destroy(&pool->jobDone);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool->done);
+}
@@ -0,0 +1,33 @@
+/*
+ * pool.h -- pool of worker threads
+ */
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <pthread.h>
+
+typedef void PoolJob(void *context, int job);
+
+typedef struct {
+	PoolJob *run;		/* does one job, may call error() */
+	void *context;
+	int numJobs;
+	int nextJob;		/* first job not taken */
+	boolean *done;		/* by job, also set for failed jobs */
+	int failedJob;		/* earliest failed job, numJobs if none */
+	char message[ERROR_MESSAGE_SIZE];	/* of the earliest failed job */
+	pthread_t *threads;
+	int numThreads;		/* 0: the jobs run in waitForJob */
+	ArenaChunks chunks;	/* left behind by ended workers */
+	pthread_mutex_t lock;	/* protects all of the above but run */
+	pthread_cond_t jobDone;
+} Pool;
+
+void startPool(Pool * pool, int numThreads, int numJobs,
+	       PoolJob * run, void *context);
+boolean waitForJob(Pool * pool, int job);
+void failJob(Pool * pool, int job, char *message);
+void finishPool(Pool * pool);
+
+#endif				/* _POOL_H_ */
@@ -0,0 +1,110 @@
+/*
+ * prune.c -- removal of unreachable procedures
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "prune.h"
+
+/*
+ * A procedure is needed if main calls it, directly or through other
+ * procedures. The calls are taken from the bodies after constant
+ * folding, so a call in a branch that is never taken or after exit()
+ * keeps nothing alive. Procedures that are not needed are removed
+ * from the declaration list and never compiled. They have been checked
+ * like all others, so their errors are still reported. The remaining
+ * procedures are numbered again in program order, the later passes
+ * keep their data about procedures in arrays indexed by that number.
+ */
+
+typedef struct {
+	Table *globalTable;
+	boolean *reached;	/* by the number of the procedure */
+} Reach;
+
+static void markProc(Reach * reach, Sym * name);
+
+static void markCalls(Reach * reach, Absyn * node)
+{
+	int i;
+
+	switch (node->type) {
+	case ABSYN_COMPSTM:
+		markCalls(reach, ABSYN(node->u.compStm.stms));
+		break;
+	case ABSYN_STMLIST:
+		for (i = 0; i < node->u.stmList.count; i++) {
+			markCalls(reach, ABSYN(node->u.stmList.items[i]));
+		}
+		break;
+	case ABSYN_IFSTM:
+		markCalls(reach, ABSYN(node->u.ifStm.thenPart));
+		markCalls(reach, ABSYN(node->u.ifStm.elsePart));
+		break;
+	case ABSYN_WHILESTM:
+		markCalls(reach, ABSYN(node->u.whileStm.body));
+		break;
+	case ABSYN_CALLSTM:
+		markProc(reach, node->u.callStm.name);
+		break;
+	}
+}
+
+static void markProc(Reach * reach, Sym * name)
+{
+	Entry *entry;
+
+	entry = lookup(reach->globalTable, name);
+	if (entry->u.procEntry.procDec == NULL ||
+	    reach->reached[entry->u.procEntry.number]) {
+		/* predefined, or already visited */
+		return;
+	}
+	reach->reached[entry->u.procEntry.number] = TRUE;
+	markCalls(reach, ABSYN(entry->u.procEntry.procDec->u.procDec.body));
+}
+
+/**
+ * @brief Remove the procedures that cannot be called from main from
+ * the declarations of the program, and number the remaining ones again
+ *
+ * @param program checked and folded abstract syntax
+ * @param globalTable symbol table
+ * @return Absyn* - the program with the reachable procedures only
+ **/
+Absyn *removeUnusedProcs(Absyn * program, Table * globalTable)
+{
+	Reach reach;
+	Entry *entry;
+	Absyn *node;
+	int n, i, k;
+
+	n = program->u.decList.count;
+	reach.globalTable = globalTable;
+	reach.reached = (boolean *) allocate((n + 1) * sizeof(boolean));
+	memset(reach.reached, 0, (n + 1) * sizeof(boolean));
+	markProc(&reach, newSym("main"));
+	n = 0;
+	k = 0;
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		if (node->type == ABSYN_PROCDEC) {
+			entry = lookup(globalTable, node->u.procDec.name);
+			if (!reach.reached[entry->u.procEntry.number]) {
+				continue;
+			}
+			entry->u.procEntry.number = n++;
+		}
+		program->u.decList.items[k++] = program->u.decList.items[i];
+	}
+	program->u.decList.count = k;
+	return program;
+}
@@ -0,0 +1,10 @@
+/*
+ * prune.h -- removal of unreachable procedures
+ */
+
+#ifndef _PRUNE_H_
+#define _PRUNE_H_
+
+Absyn *removeUnusedProcs(Absyn * program, Table * globalTable);
+
+#endif				/* _PRUNE_H_ */
@@ -0,0 +1,290 @@
+/*
+ * regalloc.c -- register allocation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "types.h"
+#include "absyn.h"
+#include "table.h"
+#include "varalloc.h"
+#include "inliner.h"
+#include "alias.h"
+#include "ir.h"
+#include "regalloc.h"
+
+typedef struct {
+	int vreg;
+	int start;		/* position of first definition or use */
+	int end;		/* position of last use */
+	boolean crossesCall;	/* a call lies strictly inside */
+} Interval;
+
+/**
+ * @brief Remove computations whose results are never used.
+ * Divisions stay, they may stop the program.
+ *
+ * @param proc procedure
+ * @return void
+ **/
+static void removeDeadCode(IrProc * proc)
+{
+	int *uses;
+	int used[2];
+	int i, n;
+	Instr *instr, *prev;
+
+	uses = (int *) allocate(proc->numVregs * sizeof(int));
+	memset(uses, 0, proc->numVregs * sizeof(int));
+	for (instr = proc->first; instr != NULL; instr = instr->next) {
+		n = usedVregs(instr, used);
+		for (i = 0; i < n; i++) {
+			uses[used[i]]++;
+		}
+	}
+	for (instr = proc->last; instr != NULL; instr = prev) {
+		prev = instr->prev;
+		if (definesVreg(instr) && instr->op != IR_DIV &&
+		    instr->dst >= VREG_FIRST && uses[instr->dst] == 0) {
+			n = usedVregs(instr, used);
+			for (i = 0; i < n; i++) {
+				uses[used[i]]--;
+			}
+			removeInstr(proc, instr);
+		}
+	}
+}
+
+static int compareStart(const void *p, const void *q)
+{
+	return ((Interval *) p)->start - ((Interval *) q)->start;
+}
+
+/**
+ * @brief Compute one live interval per virtual register over the
+ * linear instruction order. Variables that are touched inside a loop
+ * stay live for the whole loop, their values flow along the back edge.
+ * So do temporaries that were moved in front of a loop they are used in.
+ *
+ * @param proc procedure
+ * @param numIntervals number of intervals returned
+ * @return Interval* - intervals sorted by start position
+ **/
+static Interval *buildIntervals(IrProc * proc, int *numIntervals)
+{
+	int *start, *end, *labelPos, *callsBefore;
+	int *loopStart, *loopEnd;
+	int numLoops, numInstrs;
+	int used[2];
+	int i, j, n, v, pos;
+	boolean changed;
+	Instr *instr;
+	Interval *intervals;
+
+	numInstrs = 0;
+	for (instr = proc->first; instr != NULL; instr = instr->next) {
+		numInstrs++;
+	}
+	start = (int *) allocate(proc->numVregs * sizeof(int));
+	end = (int *) allocate(proc->numVregs * sizeof(int));
+	for (v = 0; v < proc->numVregs; v++) {
+		start[v] = -1;
+		end[v] = -1;
+	}
+	labelPos = (int *) allocate((proc->numLabels + 1) * sizeof(int));
+	callsBefore = (int *) allocate((numInstrs + 1) * sizeof(int));
+	loopStart = (int *) allocate((numInstrs + 1) * sizeof(int));
+	loopEnd = (int *) allocate((numInstrs + 1) * sizeof(int));
+
+	/* positions of definitions, uses, labels and calls */
+	pos = 0;
+	callsBefore[0] = 0;
+	for (instr = proc->first; instr != NULL; instr = instr->next) {
+		n = usedVregs(instr, used);
+		if (definesVreg(instr)) {
+			used[n++] = instr->dst;
+		}
+		for (i = 0; i < n; i++) {
+			v = used[i];
+			if (start[v] < 0) {
+				start[v] = pos;
+			}
+			end[v] = pos;
+		}
+		if (instr->op == IR_LABEL) {
+			labelPos[instr->label] = pos;
+		}
+		callsBefore[pos + 1] = callsBefore[pos] + (instr->op == IR_CALL);
+		pos++;
+	}
+
+	/* loops are the ranges spanned by backward branches */
+	numLoops = 0;
+	pos = 0;
+	for (instr = proc->first; instr != NULL; instr = instr->next) {
+		if ((instr->op == IR_BR || instr->op == IR_JMP) &&
+		    labelPos[instr->label] <= pos) {
+			loopStart[numLoops] = labelPos[instr->label];
+			loopEnd[numLoops] = pos;
+			numLoops++;
+		}
+		pos++;
+	}
+	for (v = VREG_FIRST; v < proc->numVregs; v++) {
+		if (start[v] < 0) {
+			continue;
+		}
+		if (proc->vregs[v].name == NULL) {
+			/* a temporary computed in front of a loop and used in it */
+			do {
+				changed = FALSE;
+				for (j = 0; j < numLoops; j++) {
+					if (start[v] < loopStart[j] &&
+					    end[v] >= loopStart[j] && end[v] < loopEnd[j]) {
+						end[v] = loopEnd[j];
+						changed = TRUE;
+					}
+				}
+			} while (changed);
+			continue;
+		}
+		do {
+			changed = FALSE;
+			for (j = 0; j < numLoops; j++) {
+				if (start[v] <= loopEnd[j] && end[v] >= loopStart[j] &&
+				    (start[v] > loopStart[j] || end[v] < loopEnd[j])) {
+					if (start[v] > loopStart[j]) {
+						start[v] = loopStart[j];
+					}
+					if (end[v] < loopEnd[j]) {
+						end[v] = loopEnd[j];
+					}
+					changed = TRUE;
+				}
+			}
+		} while (changed);
+	}
+
+	intervals = (Interval *) allocate(proc->numVregs * sizeof(Interval));
+	n = 0;
+	for (v = VREG_FIRST; v < proc->numVregs; v++) {
+		if (start[v] < 0) {
+			continue;
+		}
+		intervals[n].vreg = v;
+		intervals[n].start = start[v];
+		intervals[n].end = end[v];
+		intervals[n].crossesCall =
+		    callsBefore[end[v]] - callsBefore[start[v] + 1] > 0;
+		n++;
+	}
+	qsort(intervals, n, sizeof(Interval), compareStart);
+	*numIntervals = n;
+	return intervals;
+}
+
+static boolean isCalleeSaved(int reg)
+{
+	return reg >= REG_CALLEE_MIN && reg <= REG_CALLEE_MAX;
+}
+
+static int takeFreeReg(boolean *isFree, boolean crossesCall)
+{
+	int reg;
+
+	if (!crossesCall) {
+		for (reg = REG_CALLER_MIN; reg <= REG_CALLER_MAX; reg++) {
+			if (isFree[reg]) {
+				isFree[reg] = FALSE;
+				return reg;
+			}
+		}
+	}
+	for (reg = REG_CALLEE_MIN; reg <= REG_CALLEE_MAX; reg++) {
+		if (isFree[reg]) {
+			isFree[reg] = FALSE;
+			return reg;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Linear-scan register allocation. Intervals that survive a call
+ * get callee-saved registers. If no register is left, the interval that
+ * ends last is spilled: it stays in its frame slot, which is the
+ * variable itself for promoted variables and a slot in the spill area
+ * for temporaries.
+ *
+ * @param proc procedure
+ * @return void
+ **/
+void allocRegs(IrProc * proc)
+{
+	Interval *intervals, *cur;
+	Interval **active;
+	boolean isFree[32];
+	int numIntervals, numActive;
+	int i, j, reg, victim;
+
+	removeDeadCode(proc);
+	intervals = buildIntervals(proc, &numIntervals);
+	active = (Interval **) allocate(32 * sizeof(Interval *));
+	numActive = 0;
+	for (reg = 0; reg < 32; reg++) {
+		isFree[reg] = (reg >= REG_CALLER_MIN && reg <= REG_CALLER_MAX) ||
+		    isCalleeSaved(reg);
+	}
+	proc->spillSize = 0;
+	proc->savedRegs = 0;
+
+	for (i = 0; i < numIntervals; i++) {
+		cur = &intervals[i];
+		/* expire intervals that end before the current one starts */
+		for (j = 0; j < numActive; j++) {
+			if (active[j]->end <= cur->start) {
+				isFree[proc->vregs[active[j]->vreg].reg] = TRUE;
+				active[j--] = active[--numActive];
+			}
+		}
+		reg = takeFreeReg(isFree, cur->crossesCall);
+		if (reg == 0) {
+			/* spill the interval that ends last */
+			victim = -1;
+			for (j = 0; j < numActive; j++) {
+				if ((!cur->crossesCall ||
+				     isCalleeSaved(proc->vregs[active[j]->vreg].reg)) &&
+				    active[j]->end > cur->end &&
+				    (victim < 0 || active[j]->end > active[victim]->end)) {
+					victim = j;
+				}
+			}
+			if (victim < 0) {
+				continue;
+			}
+			reg = proc->vregs[active[victim]->vreg].reg;
+			proc->vregs[active[victim]->vreg].reg = 0;
+			active[victim] = active[--numActive];
+		}
+		proc->vregs[cur->vreg].reg = reg;
+		active[numActive++] = cur;
+		if (isCalleeSaved(reg)) {
+			proc->savedRegs |= 1u << reg;
+		}
+	}
+
+	/* temporaries and inlined variables without register get a spill slot */
+	for (i = 0; i < numIntervals; i++) {
+		cur = &intervals[i];
+		if (proc->vregs[cur->vreg].reg == 0 &&
+		    !proc->vregs[cur->vreg].inFrame) {
+			proc->vregs[cur->vreg].home = proc->spillSize;
+			proc->spillSize += INT_BYTE_SIZE;
+		}
+	}
+}
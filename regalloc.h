@@ -0,0 +1,21 @@
+/*
+ * regalloc.h -- register allocation
+ */
+
+#ifndef _REGALLOC_H_
+#define _REGALLOC_H_
+
+#define REG_ZERO	0	/* always 0 */
+#define REG_CALLER_MIN	8	/* caller-saved registers for temporaries */
+#define REG_CALLER_MAX	13
+#define REG_SCRATCH1	14	/* reloads of spilled operands */
+#define REG_SCRATCH2	15
+#define REG_CALLEE_MIN	16	/* callee-saved registers, survive calls */
+#define REG_CALLEE_MAX	23
+#define REG_FP		25	/* frame pointer */
+#define REG_SP		29	/* stack pointer */
+#define REG_RA		31	/* return address */
+
+void allocRegs(IrProc * proc);
+
+#endif				/* _REGALLOC_H_ */
@@ -0,0 +1,369 @@
+/*
+ * scanner.c -- hand-written SPL scanner
+ *
+ * A replacement for the scanner generated from scanner.l that
+ * recognizes the same tokens and reports the same errors. A regular
+ * input file is mapped into memory and scanned in place, anything else
+ * (pipes, terminals) is read line by line. No token spans a line, so
+ * both ways the buffer holds every token completely, followed by a
+ * '\0' that stops all lookahead. Identifiers are interned straight
+ * from the buffer. Everything about one input is kept in its scanner,
+ * so several threads can scan inputs of their own at the same time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "common.h"
+#include "utils.h"
+#include "sym.h"
+#include "scanner.h"
+#include "absyn.h"
+#include "parser.tab.h"
+
+#define IS_LETTER(c)	(((c) >= 'a' && (c) <= 'z') || \
+			 ((c) >= 'A' && (c) <= 'Z') || (c) == '_')
+#define IS_DIGIT(c)	((c) >= '0' && (c) <= '9')
+#define IS_HEX(c)	(IS_DIGIT(c) || ((c) >= 'a' && (c) <= 'f') || \
+			 ((c) >= 'A' && (c) <= 'F'))
+
+typedef struct {
+	FILE *in;
+	boolean streaming;	/* read line by line, input is not mapped */
+	char *buffer;		/* input or current line, followed by '\0' */
+	char *end;		/* end of the buffered input */
+	char *next;		/* first character not yet scanned */
+	char *line;		/* line buffer when streaming */
+	size_t lineSize;
+	int lineNumber;
+	YYSTYPE *lval;		/* value of the last token */
+} ScannerState;
+
+/**
+ * @brief Map a regular input file into memory, one byte larger than
+ * the file. The page after the file content is anonymous and reads as
+ * zero, so the input ends with '\0' without being copied.
+ *
+ * @param s scanner
+ * @return boolean - FALSE if the input has to be streamed
+ **/
+static boolean mapInput(ScannerState * s)
+{
+	struct stat st;
+	size_t size;
+	char *p;
+
+	if (fstat(fileno(s->in), &st) != 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size == 0) {
+		return FALSE;
+	}
+	size = st.st_size;
+	p = mmap(NULL, size + 1, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		return FALSE;
+	}
+	if (mmap(p, size, PROT_READ, MAP_PRIVATE | MAP_FIXED,
+		 fileno(s->in), 0) == MAP_FAILED) {
+		munmap(p, size + 1);
+		return FALSE;
+	}
+	s->buffer = p;
+	s->end = p + size;
+	s->next = p;
+	return TRUE;
+}
+
+static boolean readLine(ScannerState * s)
+{
+	ssize_t n;
+
+	n = getline(&s->line, &s->lineSize, s->in);
+	if (n <= 0) {
+		return FALSE;
+	}
+	s->buffer = s->line;
+	s->end = s->line + n;
+	s->next = s->line;
+	return TRUE;
+}
+
+/**
+ * @brief Start scanning an input in line 1; every thread may scan an
+ * input of its own
+ *
+ * @param in input, stays open until the scanner is freed
+ * @return Scanner - scanner
+ **/
+Scanner newScanner(FILE * in)
+{
+	ScannerState *s;
+
+	s = (ScannerState *) malloc(sizeof(ScannerState));
+	if (s == NULL) {
+		error("out of memory");
+	}
+	s->in = in;
+	s->line = NULL;
+	s->lineSize = 0;
+	s->lineNumber = 1;
+	s->lval = NULL;
+	s->streaming = !mapInput(s);
+	if (s->streaming) {
+		s->buffer = "";
+		s->end = s->buffer;
+		s->next = s->buffer;
+	}
+	return s;
+}
+
+/**
+ * @brief Forget the input, which is not closed
+ *
+ * @param scanner scanner
+ * @return void
+ **/
+void freeScanner(Scanner scanner)
+{
+	ScannerState *s;
+
+	s = (ScannerState *) scanner;
+	if (!s->streaming) {
+		munmap(s->buffer, s->end - s->buffer + 1);
+	}
+	free(s->line);
+	free(s);
+}
+
+/**
+ * @brief The value of the last token, left alone at the end of the
+ * input, as flex does
+ *
+ * @param scanner scanner
+ * @return YYSTYPE* - what yylex() was called with last
+ **/
+YYSTYPE *yyget_lval(Scanner scanner)
+{
+	return ((ScannerState *) scanner)->lval;
+}
+
+/**
+ * @brief Tell keywords from identifiers
+ *
+ * @param s first character of the word
+ * @param length number of characters
+ * @return int - keyword token or IDENT
+ **/
+static int keyword(char *s, int length)
+{
+	switch (length) {
+	case 2:
+		if (s[0] == 'i' && s[1] == 'f') {
+			return IF;
+		}
+		if (s[0] == 'o' && s[1] == 'f') {
+			return OF;
+		}
+		break;
+	case 3:
+		if (memcmp(s, "ref", 3) == 0) {
+			return REF;
+		}
+		if (memcmp(s, "var", 3) == 0) {
+			return VAR;
+		}
+		break;
+	case 4:
+		switch (s[0]) {
+		case 'e':
+			return memcmp(s, "else", 4) == 0 ? ELSE : IDENT;
+		case 'p':
+			return memcmp(s, "proc", 4) == 0 ? PROC : IDENT;
+		case 't':
+			return memcmp(s, "type", 4) == 0 ? TYPE : IDENT;
+		}
+		break;
+	case 5:
+		if (memcmp(s, "array", 5) == 0) {
+			return ARRAY;
+		}
+		if (memcmp(s, "while", 5) == 0) {
+			return WHILE;
+		}
+		break;
+	}
+	return IDENT;
+}
+
+int yylex(YYSTYPE * lval, Scanner scanner)
+{
+	ScannerState *s;
+	char *p, *start;
+	int token;
+
+	s = (ScannerState *) scanner;
+	s->lval = lval;
+	p = s->next;
+	/* skip white space and comments */
+	for (;;) {
+		if (*p == ' ' || *p == '\t') {
+			p++;
+		} else if (*p == '\n') {
+			s->lineNumber++;
+			p++;
+		} else if (*p == '/' && p[1] == '/') {
+			while (p != s->end && *p != '\n') {
+				p++;
+			}
+		} else if (p == s->end && s->streaming && readLine(s)) {
+			p = s->next;
+		} else {
+			break;
+		}
+	}
+	if (p == s->end) {
+		s->next = p;
+		return 0;
+	}
+	start = p;
+	lval->noVal.line = s->lineNumber;
+	switch (*p++) {
+	case '(':	token = LPAREN; break;
+	case ')':	token = RPAREN; break;
+	case '[':	token = LBRACK; break;
+	case ']':	token = RBRACK; break;
+	case '{':	token = LCURL; break;
+	case '}':	token = RCURL; break;
+	case '=':	token = EQ; break;
+	case '#':	token = NE; break;
+	case ',':	token = COMMA; break;
+	case ';':	token = SEMIC; break;
+	case '+':	token = PLUS; break;
+	case '-':	token = MINUS; break;
+	case '*':	token = STAR; break;
+	case '/':	token = SLASH; break;
+	case '<':
+		token = LT;
+		if (*p == '=') {
+			p++;
+			token = LE;
+		}
+		break;
+	case '>':
+		token = GT;
+		if (*p == '=') {
+			p++;
+			token = GE;
+		}
+		break;
+	case ':':
+		token = COLON;
+		if (*p == '=') {
+			p++;
+			token = ASGN;
+		}
+		break;
+	case '\'':
+		if (p[0] == '\\' && p[1] == 'n' && p[2] == '\'') {
+			lval->intVal.val = '\n';
+			p += 3;
+			token = INTLIT;
+		} else if (p + 1 < s->end && p[0] != '\n' && p[1] == '\'') {
+			lval->intVal.val = p[0];
+			p += 2;
+			token = INTLIT;
+		} else {
+			token = -1;
+		}
+		break;
+	default:
+		if (IS_LETTER(*start)) {
+			while (IS_LETTER(*p) || IS_DIGIT(*p)) {
+				p++;
+			}
+			token = keyword(start, p - start);
+			if (token == IDENT) {
+				lval->symVal.val = newSymLen(start, p - start);
+			}
+		} else if (IS_DIGIT(*start)) {
+			/* the input ends with '\0', strtol stops there */
+			if (start[0] == '0' && start[1] == 'x' && IS_HEX(start[2])) {
+				lval->intVal.val = strtol(start, &p, 16);
+			} else {
+				lval->intVal.val = (int) strtol(start, &p, 10);
+			}
+			token = INTLIT;
+		} else {
+			token = -1;
+		}
+	}
+	if (token < 0) {
+		error("Illegal character at '%c' \t in line %i.\n",
+		      *start, s->lineNumber);
+	}
+	s->next = p;
+	return token;
+}
+
+static char *tokenName(int token)
+{
+	switch (token) {
+	case ARRAY:	return "ARRAY";
+	case ELSE:	return "ELSE";
+	case IF:	return "IF";
+	case OF:	return "OF";
+	case PROC:	return "PROC";
+	case REF:	return "REF";
+	case TYPE:	return "TYPE";
+	case VAR:	return "VAR";
+	case WHILE:	return "WHILE";
+	case LPAREN:	return "LPAREN";
+	case RPAREN:	return "RPAREN";
+	case LBRACK:	return "LBRACK";
+	case RBRACK:	return "RBRACK";
+	case LCURL:	return "LCURL";
+	case RCURL:	return "RCURL";
+	case EQ:	return "EQ";
+	case NE:	return "NE";
+	case LT:	return "LT";
+	case LE:	return "LE";
+	case GT:	return "GT";
+	case GE:	return "GE";
+	case ASGN:	return "ASGN";
+	case COLON:	return "COLON";
+	case COMMA:	return "COMMA";
+	case SEMIC:	return "SEMIC";
+	case PLUS:	return "PLUS";
+	case MINUS:	return "MINUS";
+	case STAR:	return "STAR";
+	case SLASH:	return "SLASH";
+	}
+	return NULL;
+}
+
+void showToken(int token, YYSTYPE * lval)
+{
+	switch (token) {
+	case 0:
+		printf("TOKEN = - - EOF --\n");
+		break;
+	case IDENT:
+		printf("TOKEN = %s in line %i, value=\"%s\"\n",
+			"IDENT", lval->symVal.line, symToString(lval->symVal.val));
+		break;
+	case INTLIT:
+		printf("TOKEN = %s in line %i, value=\"%i\"\n",
+			"INTLIT", lval->intVal.line, lval->intVal.val);
+		break;
+	default:
+		if (tokenName(token) == NULL) {
+			error("No match found - undefined Token.");
+		}
+		printf("TOKEN = %s in line %i\n", tokenName(token),
+		       lval->noVal.line);
+		break;
+	}
+}
@@ -16,12 +16,17 @@ typedef struct {
 
 typedef struct {
 	int line;
-	char *val;
-} StringVal;
+	struct sym *val;	/* interned identifier */
+} SymVal;
 
-extern FILE *yyin;
+union YYSTYPE;			/* token values, see parser.tab.h */
 
-int yylex(void);
-void showToken(int token);
+typedef void *Scanner;		/* state of one input, a yyscan_t of flex */
+
+Scanner newScanner(FILE * in);
+void freeScanner(Scanner scanner);
+int yylex(union YYSTYPE *lval, Scanner scanner);
+union YYSTYPE *yyget_lval(Scanner scanner);
+void showToken(int token, union YYSTYPE *lval);
 
 #endif				/* _SCANNER_H_ */
@@ -14,19 +14,20 @@
 #include "table.h"
 #include "semant.h"
 #include "varalloc.h"
+#include "pool.h"
 
-static Type *intType;
-static Type *booleanType;
-static boolean showSymbolTable;
-static boolean semanticPhase;
+static __thread Type *intType;
+static __thread Type *booleanType;
+static __thread boolean showSymbolTable;
 
 /**
  * @brief (root) Initiating semantic analysis phase
  * @param Absyn symbol table
  * @param boolean  show symbol table flag
+ * @param int most threads to check procedure bodies with
  * @return globalTable - global table of parsed symbols
  * */
-Table *check(Absyn * program, boolean tables)
+Table *check(Absyn * program, boolean tables, int numThreads)
 {
 	Table *globalTable;
 	Entry *entry;
@@ -44,12 +45,9 @@ Table *check(Absyn * program, boolean tables)
 	/* enter types and procedures into symboltable*/
 	enterBibProcs(globalTable);
 
-	/* do semantic checks */
-	semanticPhase = FALSE;
-	checkNode(program, globalTable);
-
-	semanticPhase = TRUE;
-	checkNode(program, globalTable);
+	/* enter global types and procedure headers, then check bodies */
+	checkHeaders(program, globalTable);
+	checkBodies(program, globalTable, numThreads);
 
 	/* check if "main()" is present */
 	entry = newProcEntry(emptyParamTypes(), newTable(globalTable));
@@ -209,7 +207,7 @@ Type *checkArrayTy(Absyn * node, Table * symTab)
 {
 	Type *arrayType;
 
-	arrayType = checkNode(node->u.arrayTy.ty, symTab);
+	arrayType = checkNode(ABSYN(node->u.arrayTy.ty), symTab);
 
 	return newArrayType(node->u.arrayTy.size, arrayType);
 }
@@ -225,60 +223,167 @@ Type *checkTypeDec(Absyn * node, Table * symTab) {
 	Type *type;
 	Entry *typeEntry;
 
-	if (!semanticPhase) {
-		type = checkNode(node->u.typeDec.ty, symTab);
-		typeEntry = newTypeEntry(type);
+	type = checkNode(ABSYN(node->u.typeDec.ty), symTab);
+	typeEntry = newTypeEntry(type);
 
-		if (enter(symTab, node->u.typeDec.name, typeEntry)  == NULL) {
-			error("redeclaration of %s as type in line %i",
-			      symToString(node->u.typeDec.name), node->line);
-		}
+	if (enter(symTab, node->u.typeDec.name, typeEntry)  == NULL) {
+		error("redeclaration of %s as type in line %i",
+		      symToString(node->u.typeDec.name), node->line);
 	}
 
 	return NULL;
 }
 
 /**
- * @brief (4) Checking type declarations for conformity
+ * @brief (4) Checking procedure bodies for conformity, the header has
+ * been entered by checkProcHead
  *
  * @param node abstract syntax
  * @param symTab symbol table
  * @return Type* - Typechecks of statements always return NULL
  **/
 Type *checkProcDec(Absyn * node, Table * symTab) {
-	ParamTypes *parTypes;
 	Entry *procEntry;
 	Table *localSymTable;
 
-	if (!semanticPhase) {
-		localSymTable = newTable(NULL);
+	procEntry = lookup(symTab, node->u.procDec.name);
+	localSymTable = procEntry->u.procEntry.localTable;
 
-		parTypes = checkParamTypes(node->u.procDec.params, symTab);
-		localSymTable = newTable(symTab);
-		procEntry = newProcEntry(parTypes, localSymTable);
+	checkNode(ABSYN(node->u.procDec.params), localSymTable);
+	checkNode(ABSYN(node->u.procDec.decls), localSymTable);
+	checkNode(ABSYN(node->u.procDec.body), localSymTable);
 
-		if (enter(symTab, node->u.procDec.name, procEntry)  == NULL) {
-			error("redeclaration of %s as procedure in line %i",
-			      symToString(node->u.procDec.name), node->line);
-		}
+	if (showSymbolTable) {
+	  printf("\nsymbol table at end of procedure '%s':\n",
+		     symToString(node->u.procDec.name));
 
-	} else {
-		procEntry = lookup(symTab, node->u.procDec.name);
-		localSymTable = procEntry->u.procEntry.localTable;
+	      showTable(localSymTable);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Enter a procedure with its parameter types into the symbol
+ * table
+ *
+ * @param node abstract syntax
+ * @param symTab symbol table
+ * @param number position among the procedures of the program
+ * @return void
+ **/
+void checkProcHead(Absyn * node, Table * symTab, int number) {
+	ParamTypes *parTypes;
+	Entry *procEntry;
+	Table *localSymTable;
 
-		checkNode(node->u.procDec.params, localSymTable);
-		checkNode(node->u.procDec.decls, localSymTable);
-		checkNode(node->u.procDec.body, localSymTable);
+	parTypes = checkParamTypes(ABSYN(node->u.procDec.params), symTab);
+	localSymTable = newTable(symTab);
+	procEntry = newProcEntry(parTypes, localSymTable);
+	procEntry->u.procEntry.procDec = node;
+	procEntry->u.procEntry.number = number;
 
-		if (showSymbolTable) {
-		  printf("\nsymbol table at end of procedure '%s':\n",
-			     symToString(node->u.procDec.name));
+	if (enter(symTab, node->u.procDec.name, procEntry)  == NULL) {
+		error("redeclaration of %s as procedure in line %i",
+		      symToString(node->u.procDec.name), node->line);
+	}
+}
 
-		      showTable(localSymTable);
+/**
+ * @brief Enter the global declarations into the symbol table, without
+ * looking into procedure bodies
+ *
+ * @param program abstract syntax
+ * @param symTab global symbol table
+ * @return void
+ **/
+void checkHeaders(Absyn * program, Table * symTab)
+{
+	Absyn *node;
+	int numProcs, i;
+
+	numProcs = 0;
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		if (node->type == ABSYN_TYPEDEC) {
+			checkTypeDec(node, symTab);
+		} else {
+			checkProcHead(node, symTab, numProcs++);
 		}
 	}
+}
 
-	return NULL;
+/*
+ * The bodies of different procedures only read the global table, so
+ * they are checked concurrently, each in a job of its own. Every job
+ * enters into the local table of its procedure alone and allocates in
+ * the arenas of its thread. The first error in the order of the
+ * program is reported, as if the bodies were checked one by one.
+ */
+typedef struct {
+	Absyn *program;
+	Absyn **procDecs;	/* by procedure number */
+	Table *globalTable;
+	Type *intType;
+	Type *booleanType;
+} Bodies;
+
+static void checkBody(void *context, int job)
+{
+	Bodies *bodies;
+
+	bodies = (Bodies *) context;
+	intType = bodies->intType;
+	booleanType = bodies->booleanType;
+	selectAbsyn(bodies->program);
+	selectArena(ARENA_SEMANT);
+	checkProcDec(bodies->procDecs[job], bodies->globalTable);
+}
+
+/**
+ * @brief Check the procedure bodies, once all global declarations are
+ * known
+ *
+ * @param program abstract syntax
+ * @param symTab global symbol table
+ * @param numThreads most threads to use, the symbol tables are always
+ * shown by one
+ * @return void
+ **/
+void checkBodies(Absyn * program, Table * symTab, int numThreads)
+{
+	Absyn *node;
+	Bodies bodies;
+	Pool pool;
+	int numProcs, i;
+
+	numProcs = 0;
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		numProcs += node->type == ABSYN_PROCDEC;
+	}
+	bodies.procDecs = (Absyn **) allocate((numProcs + 1) * sizeof(Absyn *));
+	numProcs = 0;
+	for (i = 0; i < program->u.decList.count; i++) {
+		node = ABSYN(program->u.decList.items[i]);
+		if (node->type == ABSYN_PROCDEC) {
+			bodies.procDecs[numProcs++] = node;
+		}
+	}
+	bodies.program = program;
+	bodies.globalTable = symTab;
+	bodies.intType = intType;
+	bodies.booleanType = booleanType;
+	startPool(&pool, showSymbolTable ? 1 : numThreads, numProcs,
+		  checkBody, &bodies);
+	i = 0;
+	while (i < numProcs && waitForJob(&pool, i)) {
+		i++;
+	}
+	finishPool(&pool);
+	if (pool.failedJob < numProcs) {
+		error("%s", pool.message);
+	}
 }
 
 /**
@@ -292,7 +397,7 @@ Type *checkParDec(Absyn * node, Table * symTab) {
 	Type *paramType;
 	Entry *paramEntry;
 
-	paramType = checkNode(node->u.parDec.ty, symTab);
+	paramType = checkNode(ABSYN(node->u.parDec.ty), symTab);
 	paramEntry = newVarEntry(paramType, node->u.parDec.isRef);
 
 	if (enter(symTab, node->u.parDec.name, paramEntry)  == NULL) {
@@ -314,7 +419,7 @@ Type *checkVarDec(Absyn * node, Table * symTab) {
 	Type *varType;
 	Entry *varEntry;
 
-	varType = checkNode(node->u.varDec.ty, symTab);
+	varType = checkNode(ABSYN(node->u.varDec.ty), symTab);
 	varEntry = newVarEntry(varType, FALSE);
 
 	if (enter(symTab, node->u.varDec.name, varEntry)  == NULL) {
@@ -343,7 +448,7 @@ Type *checkEmptyStm() {
  **/
 Type *checkCompStm(Absyn * node, Table * symTab) {
 
-	checkNode(node->u.compStm.stms, symTab);
+	checkNode(ABSYN(node->u.compStm.stms), symTab);
 
 	return NULL;
 }
@@ -359,8 +464,8 @@ Type *checkAssignStm(Absyn * node, Table * symTab) {
 	Type 	*leftType,
 		*rightType;
 
-	leftType = checkNode(node->u.assignStm.var, symTab);
-	rightType = checkNode(node->u.assignStm.exp, symTab);
+	leftType = checkNode(ABSYN(node->u.assignStm.var), symTab);
+	rightType = checkNode(ABSYN(node->u.assignStm.exp), symTab);
 
 	if (leftType != rightType) {
 		error("assignment has different types in line %i", node->line);
@@ -383,14 +488,14 @@ Type *checkAssignStm(Absyn * node, Table * symTab) {
 Type *checkIfStm(Absyn * node, Table * symTab) {
 	Type *ifType;
 
-	ifType = checkNode(node->u.ifStm.test, symTab);
+	ifType = checkNode(ABSYN(node->u.ifStm.test), symTab);
 
 	if (ifType != booleanType) {
 		error("'if' test expression must be of type boolean in line %i", node->line);
 	}
 
-	checkNode(node->u.ifStm.thenPart, symTab);
-	checkNode(node->u.ifStm.elsePart, symTab);
+	checkNode(ABSYN(node->u.ifStm.thenPart), symTab);
+	checkNode(ABSYN(node->u.ifStm.elsePart), symTab);
 
 	return NULL;
 }
@@ -405,13 +510,13 @@ Type *checkIfStm(Absyn * node, Table * symTab) {
 Type *checkWhileStm(Absyn * node, Table * symTab) {
 	Type *whileType;
 
-	whileType = checkNode(node->u.whileStm.test, symTab);
+	whileType = checkNode(ABSYN(node->u.whileStm.test), symTab);
 
 	if (whileType != booleanType) {
 		error("'while' test expression must be of type boolean in line %i", node->line);
 	}
 
-	checkNode(node->u.whileStm.body, symTab);
+	checkNode(ABSYN(node->u.whileStm.body), symTab);
 
 	return NULL;
 }
@@ -425,7 +530,7 @@ Type *checkWhileStm(Absyn * node, Table * symTab) {
  **/
 Type *checkCallStm(Absyn * node, Table * symTab) {
 	int argNr = 1;
-	Absyn *callArgs;
+	Absyn *callArgs, *arg;
 	Type *callType;
 	ParamTypes *paramTypes;
 	Entry *entryParam;
@@ -443,22 +548,22 @@ Type *checkCallStm(Absyn * node, Table * symTab) {
 	}
 
 	paramTypes = entryParam->u.procEntry.paramTypes;
-	callArgs = node->u.callStm.args;
+	callArgs = ABSYN(node->u.callStm.args);
 
-	while (!(paramTypes->isEmpty) && !(callArgs->u.expList.isEmpty)) {
-		callType = checkNode(callArgs->u.expList.head, symTab);
+	while (!(paramTypes->isEmpty) && argNr <= callArgs->u.expList.count) {
+		arg = ABSYN(callArgs->u.expList.items[argNr - 1]);
+		callType = checkNode(arg, symTab);
 		if (paramTypes->type != callType) {
 		      error("procedure %s argument %i type mismatch in line %i",
 			    symToString(node->u.callStm.name), argNr, node->line);
 		}
 
-		if (paramTypes->isRef && callArgs->u.expList.head->type != ABSYN_VAREXP) {
+		if (paramTypes->isRef && arg->type != ABSYN_VAREXP) {
 		      error("procedure %s argument %i must be a variable in line %i",
 			    symToString(node->u.callStm.name), argNr, node->line);
 		}
 
 		paramTypes = paramTypes->next;
-		callArgs = callArgs->u.expList.tail;
 		argNr++;
 	}
 
@@ -467,7 +572,7 @@ Type *checkCallStm(Absyn * node, Table * symTab) {
 		      symToString(node->u.callStm.name), node->line);
 	}
 
-	if (!callArgs->u.expList.isEmpty) {
+	if (argNr <= callArgs->u.expList.count) {
 		error("procedure %s called with too many arguments in line %i",
 		      symToString(node->u.callStm.name), node->line);
 	}
@@ -488,8 +593,8 @@ Type *checkOpExp(Absyn * node, Table * symTab)
 	     *rightType,
 	     *type;
 
-	leftType = checkNode(node->u.opExp.left, symTab);
-	rightType = checkNode(node->u.opExp.right, symTab);
+	leftType = checkNode(ABSYN(node->u.opExp.left), symTab);
+	rightType = checkNode(ABSYN(node->u.opExp.right), symTab);
 
 	if (leftType != rightType) {
 		error("expression combines different types in line %i", node->line);
@@ -571,7 +676,7 @@ Type *checkOpExp(Absyn * node, Table * symTab)
  **/
 Type *checkVarExp(Absyn * node, Table * symTab)
 {
-	node->typeGraph = checkNode(node->u.varExp.var, symTab);
+	node->typeGraph = checkNode(ABSYN(node->u.varExp.var), symTab);
 
 	return node->typeGraph;
 }
@@ -631,8 +736,8 @@ Type *checkArrayVar(Absyn * node, Table * symTab)
 	     *arrayType;
 	Entry *arrayEntry = NULL;
 
-	if(node->u.arrayVar.var->type == ABSYN_SIMPLEVAR) {
-		arrayEntry = lookup(symTab,node->u.arrayVar.var->u.simpleVar.name);
+	if(ABSYN(node->u.arrayVar.var)->type == ABSYN_SIMPLEVAR) {
+		arrayEntry = lookup(symTab,ABSYN(node->u.arrayVar.var)->u.simpleVar.name);
 		if(arrayEntry != NULL &&
 		   arrayEntry->u.varEntry.type->kind != TYPE_KIND_ARRAY)
 		{
@@ -641,9 +746,9 @@ Type *checkArrayVar(Absyn * node, Table * symTab)
 
 	}
 
-	arrayType = checkNode(node->u.arrayVar.var, symTab);
+	arrayType = checkNode(ABSYN(node->u.arrayVar.var), symTab);
 	node->typeGraph = arrayType;
-	indexType = checkNode(node->u.arrayVar.index, symTab);
+	indexType = checkNode(ABSYN(node->u.arrayVar.index), symTab);
 
 	if(indexType != intType) {
 		error("illegal indexing with a non-integer in line %d", node->line);
@@ -662,9 +767,10 @@ Type *checkArrayVar(Absyn * node, Table * symTab)
  **/
 Type *checkDecList(Absyn * node, Table * symTab)
 {
-	if (node->u.decList.isEmpty == FALSE) {
-		checkNode(node->u.decList.head, symTab);
-		checkNode(node->u.decList.tail, symTab);
+	int i;
+
+	for (i = 0; i < node->u.decList.count; i++) {
+		checkNode(ABSYN(node->u.decList.items[i]), symTab);
 	}
 
 	return NULL;
@@ -679,9 +785,10 @@ Type *checkDecList(Absyn * node, Table * symTab)
  **/
 Type *checkStmList(Absyn * node, Table * symTab)
 {
-	if (node->u.stmList.isEmpty == FALSE) {
-		checkNode(node->u.stmList.head, symTab);
-		checkNode(node->u.stmList.tail, symTab);
+	int i;
+
+	for (i = 0; i < node->u.stmList.count; i++) {
+		checkNode(ABSYN(node->u.stmList.items[i]), symTab);
 	}
 	return NULL;
 }
@@ -695,42 +802,50 @@ Type *checkStmList(Absyn * node, Table * symTab)
  **/
 Type *checkExpList(Absyn * node, Table * symTab)
 {
-	if (node->u.expList.isEmpty == FALSE) {
-		checkNode(node->u.expList.head, symTab);
-		checkNode(node->u.expList.tail, symTab);
+	int i;
+
+	for (i = 0; i < node->u.expList.count; i++) {
+		checkNode(ABSYN(node->u.expList.items[i]), symTab);
 	}
 
 	return NULL;
 }
 
 
-/**
- * @brief Check semantic validity of parameters types
- *
- * @param params procedure parameters
- * @param symTab symbol table of procedure header
- * @return ParamTypes*
- **/
-ParamTypes *checkParamTypes(Absyn * params, Table * symTab)
+static ParamTypes *checkParamsFrom(Absyn * params, int i, Table * symTab)
 {
+      Absyn *param;
       Type *parType;
       Entry *parEntry;
 
-      if (params->u.decList.isEmpty){
+      if (i == params->u.decList.count){
 	      return emptyParamTypes();
       }
 
-      parType = checkNode(params->u.decList.head->u.parDec.ty, symTab);
+      param = ABSYN(params->u.decList.items[i]);
+      parType = checkNode(ABSYN(param->u.parDec.ty), symTab);
 
-      if (parType->kind == TYPE_KIND_ARRAY && !params->u.decList.head->u.parDec.isRef) {
+      if (parType->kind == TYPE_KIND_ARRAY && !param->u.parDec.isRef) {
 	      error("parameter %s must be a reference parameter in line %i",
-		    symToString(params->u.decList.head->u.parDec.name), params->line);
+		    symToString(param->u.parDec.name), params->line);
       }
 
-      parEntry = newVarEntry(parType, params->u.decList.head->u.parDec.isRef);
+      parEntry = newVarEntry(parType, param->u.parDec.isRef);
+
+      enter(symTab, param->u.parDec.name, parEntry);
 
-      enter(symTab, params->u.decList.head->u.parDec.name, parEntry);
+      return newParamTypes(parType, param->u.parDec.isRef,
+			   checkParamsFrom(params, i + 1, symTab));
+}
 
-      return newParamTypes(parType, params->u.decList.head->u.parDec.isRef,
-			   checkParamTypes(params->u.decList.tail, symTab));
+/**
+ * @brief Check semantic validity of parameters types
+ *
+ * @param params procedure parameters
+ * @param symTab symbol table of procedure header
+ * @return ParamTypes*
+ **/
+ParamTypes *checkParamTypes(Absyn * params, Table * symTab)
+{
+      return checkParamsFrom(params, 0, symTab);
 }
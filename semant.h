@@ -5,7 +5,7 @@
 #ifndef _SEMANT_H_
 #define _SEMANT_H_
 
-Table *check(Absyn * program, boolean tables);
+Table *check(Absyn * program, boolean tables, int numThreads);
 
 void enterBibProcs(Table * symTab);
 
@@ -14,6 +14,9 @@ Type *checkNameTy(Absyn * node, Table * symTab);
 Type *checkArrayTy(Absyn * node, Table * symTab);
 Type *checkTypeDec(Absyn * node, Table * symTab);
 Type *checkProcDec(Absyn * node, Table * symTab);
+void checkProcHead(Absyn * node, Table * symTab, int number);
+void checkHeaders(Absyn * program, Table * symTab);
+void checkBodies(Absyn * program, Table * symTab, int numThreads);
 Type *checkParDec(Absyn * node, Table * symTab);
 Type *checkVarDec(Absyn * node, Table * symTab);
 Type *checkEmptyStm();
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "common.h"
 #include "utils.h"
@@ -16,12 +17,18 @@ static int numEntries;
 
 static unsigned stamp = 314159265;
 
-static unsigned hash(char *s)
+/*
+ * threads may enter symbols concurrently, into the shared symbol arena;
+ * nothing that can call error() may run while the lock is held
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned hash(char *s, int length)
 {
 	unsigned h, g;
 
 	h = 0;
-	while (*s != '\0') {
+	while (length-- > 0) {
 		h = (h << 4) + *s++;
 		g = h & 0xF0000000;
 		if (g != 0) {
@@ -55,22 +62,29 @@ static boolean isPrime(int i)
 	return TRUE;
 }
 
-static void initTable(void)
+static boolean initTable(void)
 {
+	int newHashSize;
 	int i;
 
-	hashSize = INITIAL_HASH_SIZE;
-	while (!isPrime(hashSize)) {
-		hashSize++;
+	newHashSize = INITIAL_HASH_SIZE;
+	while (!isPrime(newHashSize)) {
+		newHashSize++;
 	}
-	buckets = (Sym **) allocate(hashSize * sizeof(Sym *));
-	for (i = 0; i < hashSize; i++) {
+	buckets = (Sym **) tryAllocateIn(ARENA_SYMBOLS,
+					 newHashSize * sizeof(Sym *));
+	if (buckets == NULL) {
+		return FALSE;
+	}
+	for (i = 0; i < newHashSize; i++) {
 		buckets[i] = NULL;
 	}
+	hashSize = newHashSize;
 	numEntries = 0;
+	return TRUE;
 }
 
-static void growTable(void)
+static boolean growTable(void)
 {
 	int newHashSize;
 	Sym **newBuckets;
@@ -83,7 +97,11 @@ static void growTable(void)
 		newHashSize += 2;
 	}
 	/* init new hash table */
-	newBuckets = (Sym **) allocate(newHashSize * sizeof(Sym *));
+	newBuckets = (Sym **) tryAllocateIn(ARENA_SYMBOLS,
+					     newHashSize * sizeof(Sym *));
+	if (newBuckets == NULL) {
+		return FALSE;
+	}
 	for (i = 0; i < newHashSize; i++) {
 		newBuckets[i] = NULL;
 	}
@@ -98,34 +116,36 @@ static void growTable(void)
 			newBuckets[n] = q;
 		}
 	}
-	/* swap tables */
-	release(buckets);
+	/* swap tables, the old one stays in the symbol arena */
 	buckets = newBuckets;
 	hashSize = newHashSize;
+	return TRUE;
 }
 
-Sym *newSym(char *string)
+/* find or add a symbol, the lock is held; NULL if memory runs out */
+static Sym *internSym(char *string, int length)
 {
 	unsigned hashValue;
 	int n;
 	Sym *p;
 
 	/* initialize hash table if necessary */
-	if (hashSize == 0) {
-		initTable();
+	if (hashSize == 0 && !initTable()) {
+		return NULL;
 	}
 	/* grow hash table if necessary */
-	if (numEntries == hashSize) {
-		growTable();
+	if (numEntries == hashSize && !growTable()) {
+		return NULL;
 	}
 	/* compute hash value and bucket number */
-	hashValue = hash(string);
+	hashValue = hash(string, length);
 	n = hashValue % hashSize;
 	/* search in bucket list */
 	p = buckets[n];
 	while (p != NULL) {
 		if (p->hashValue == hashValue) {
-			if (strcmp(p->string, string) == 0) {
+			if (strncmp(p->string, string, length) == 0 &&
+			    p->string[length] == '\0') {
 				/* found: return symbol */
 				return p;
 			}
@@ -133,9 +153,16 @@ Sym *newSym(char *string)
 		p = p->next;
 	}
 	/* not found: add new symbol to bucket list */
-	p = (Sym *) allocate(sizeof(Sym));
-	p->string = (char *)allocate(strlen(string) + 1);
-	strcpy(p->string, string);
+	p = (Sym *) tryAllocateIn(ARENA_SYMBOLS, sizeof(Sym));
+	if (p == NULL) {
+		return NULL;
+	}
+	p->string = (char *) tryAllocateIn(ARENA_SYMBOLS, length + 1);
+	if (p->string == NULL) {
+		return NULL;
+	}
+	memcpy(p->string, string, length);
+	p->string[length] = '\0';
 	p->stamp = stamp;
 	stamp += 0x9E3779B9;	/* Fibonacci hashing, see Knuth Vol. 3 */
 	p->hashValue = hashValue;
@@ -145,6 +172,33 @@ Sym *newSym(char *string)
 	return p;
 }
 
+/**
+ * @brief Intern a string that need not be terminated, e.g. a token in
+ * the input buffer. The characters are only copied the first time.
+ *
+ * @param string first character
+ * @param length number of characters
+ * @return Sym* - the unique symbol for the string
+ **/
+Sym *newSymLen(char *string, int length)
+{
+	Sym *p;
+
+	pthread_mutex_lock(&lock);
+	p = internSym(string, length);
+	pthread_mutex_unlock(&lock);
+	if (p == NULL) {
+		/* error() leaves by longjmp, so only once the lock is free */
+		error("out of memory");
+	}
+	return p;
+}
+
+Sym *newSym(char *string)
+{
+	return newSymLen(string, strlen(string));
+}
+
 char *symToString(Sym * sym)
 {
 	return sym->string;
@@ -15,6 +15,7 @@ typedef struct sym {
 } Sym;
 
 Sym *newSym(char *string);
+Sym *newSymLen(char *string, int length);
 char *symToString(Sym * sym);
 unsigned symToStamp(Sym * sym);
 
@@ -41,6 +41,8 @@ Entry *newProcEntry(ParamTypes * paramTypes, Table * localTable)
 	entry->kind = ENTRY_KIND_PROC;
 	entry->u.procEntry.paramTypes = paramTypes;
 	entry->u.procEntry.localTable = localTable;
+	entry->u.procEntry.procDec = NULL;
+	entry->u.procEntry.number = -1;
 	return entry;
 }
 
@@ -49,78 +51,93 @@ Table *newTable(Table * upperLevel)
 	Table *table;
 
 	table = (Table *) allocate(sizeof(Table));
-	table->bintree = NULL;
+	table->slots = NULL;
+	table->size = 0;
+	table->shift = 32;
+	table->count = 0;
 	table->upperLevel = upperLevel;
 	return table;
 }
 
-Entry *enter(Table * table, Sym * sym, Entry * entry)
+/*
+ * Stamps are spaced by the golden ratio (see sym.c), so their upper
+ * bits are already well distributed and serve directly as home slot.
+ */
+static Slot *findSlot(Table * table, unsigned key)
 {
-	unsigned key;
-	Bintree *newtree;
-	Bintree *current;
-	Bintree *previous;
+	unsigned mask;
+	unsigned i;
+	Slot *slot;
+
+	mask = table->size - 1;
+	i = key >> table->shift;
+	while (1) {
+		slot = &table->slots[i];
+		if (slot->entry == NULL || slot->key == key) {
+			return slot;
+		}
+		i = (i + 1) & mask;
+	}
+}
 
-	key = symToStamp(sym);
-	newtree = (Bintree *) allocate(sizeof(Bintree));
-	newtree->sym = sym;
-	newtree->key = key;
-	newtree->entry = entry;
-	newtree->left = NULL;
-	newtree->right = NULL;
-	if (table->bintree == NULL) {
-		table->bintree = newtree;
+static void growTable(Table * table)
+{
+	Slot *oldSlots;
+	int oldSize;
+	int i;
+
+	oldSlots = table->slots;
+	oldSize = table->size;
+	if (oldSize == 0) {
+		table->size = TABLE_INITIAL_SIZE;
+		table->shift = 32 - 3;
 	} else {
-		current = table->bintree;
-		while (1) {
-			if (current->key == key) {
-				/* symbol already in table */
-				return NULL;
-			}
-			previous = current;
-			if (current->key > key) {
-				current = current->left;
-			} else {
-				current = current->right;
-			}
-			if (current == NULL) {
-				if (previous->key > key) {
-					previous->left = newtree;
-				} else {
-					previous->right = newtree;
-				}
-				break;
-			}
+		table->size = 2 * oldSize;
+		table->shift--;
+	}
+	table->slots = (Slot *) allocate(table->size * sizeof(Slot));
+	memset(table->slots, 0, table->size * sizeof(Slot));
+	for (i = 0; i < oldSize; i++) {
+		if (oldSlots[i].entry != NULL) {
+			*findSlot(table, oldSlots[i].key) = oldSlots[i];
 		}
 	}
-	return entry;
 }
 
-static Entry *lookupBintree(Bintree * bintree, unsigned key)
+Entry *enter(Table * table, Sym * sym, Entry * entry)
 {
-	while (bintree != NULL) {
-		if (bintree->key == key) {
-			return bintree->entry;
-		}
-		if (bintree->key > key) {
-			bintree = bintree->left;
-		} else {
-			bintree = bintree->right;
-		}
+	unsigned key;
+	Slot *slot;
+
+	/* keep load factor below 3/4 */
+	if (4 * (table->count + 1) > 3 * table->size) {
+		growTable(table);
 	}
-	return NULL;
+	key = symToStamp(sym);
+	slot = findSlot(table, key);
+	if (slot->entry != NULL) {
+		/* symbol already in table */
+		return NULL;
+	}
+	slot->sym = sym;
+	slot->key = key;
+	slot->entry = entry;
+	table->count++;
+	return entry;
 }
 
 Entry *lookup(Table * table, Sym * sym)
 {
 	unsigned key;
-	Entry *entry;
+	Slot *slot;
 
 	key = symToStamp(sym);
 	while (table != NULL) {
-		entry = lookupBintree(table->bintree, key);
-		if (entry != NULL) {
-			return entry;
+		if (table->count != 0) {
+			slot = findSlot(table, key);
+			if (slot->entry != NULL) {
+				return slot->entry;
+			}
 		}
 		table = table->upperLevel;
 	}
@@ -151,15 +168,32 @@ void showEntry(Entry * entry)
 	printf("\n");
 }
 
-static void showBintree(Bintree * bintree)
+static int compareSlots(const void *p, const void *q)
 {
-	if (bintree == NULL) {
-		return;
+	unsigned k1 = ((Slot *) p)->key;
+	unsigned k2 = ((Slot *) q)->key;
+
+	return (k1 > k2) - (k1 < k2);
+}
+
+static void showSlots(Table * table)
+{
+	Slot *sorted;
+	int i, n;
+
+	/* show entries in stamp order, as the former search tree did */
+	sorted = (Slot *) allocate(table->count * sizeof(Slot) + 1);
+	n = 0;
+	for (i = 0; i < table->size; i++) {
+		if (table->slots[i].entry != NULL) {
+			sorted[n++] = table->slots[i];
+		}
+	}
+	qsort(sorted, n, sizeof(Slot), compareSlots);
+	for (i = 0; i < n; i++) {
+		printf("  %-10s --> ", symToString(sorted[i].sym));
+		showEntry(sorted[i].entry);
 	}
-	showBintree(bintree->left);
-	printf("  %-10s --> ", symToString(bintree->sym));
-	showEntry(bintree->entry);
-	showBintree(bintree->right);
 }
 
 void showTable(Table * table)
@@ -169,7 +203,7 @@ void showTable(Table * table)
 	level = 0;
 	while (table != NULL) {
 		printf("  level %d\n", level);
-		showBintree(table->bintree);
+		showSlots(table);
 		table = table->upperLevel;
 		level++;
 	}
@@ -26,20 +26,25 @@ typedef struct {
 			int argSize;		/* ausgehende Argumente */
 			int localVarSize;	/* lokale Variable */
 			struct table *localTable;
+			struct absyn *procDec;	/* NULL if predefined */
+			int number;		/* position among the ProcDecs */
 		} procEntry;
 	} u;
 } Entry;
 
-typedef struct bintree {
+#define TABLE_INITIAL_SIZE	8	/* number of slots, power of 2 */
+
+typedef struct {
 	Sym *sym;
-	unsigned key;
+	unsigned key;		/* symbol stamp, 0 entry means unused */
 	Entry *entry;
-	struct bintree *left;
-	struct bintree *right;
-} Bintree;
+} Slot;
 
 typedef struct table {
-	Bintree *bintree;
+	Slot *slots;		/* open addressing with linear probing */
+	int size;		/* number of slots, always a power of 2 */
+	int shift;		/* 32 - log2(size), selects home slot */
+	int count;		/* number of used slots */
 	struct table *upperLevel;
 } Table;
 
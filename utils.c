@@ -6,15 +6,57 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #include "common.h"
 #include "utils.h"
 
+/*
+ * Memory is handed out by bump-pointer regions, one per compiler
+ * phase. Nothing is freed individually; a whole arena is given back
+ * with releaseArena(), and releaseUnit() drops everything that belongs
+ * to one compilation unit. Standard-sized chunks are kept on a free
+ * list so that the next unit does not have to ask malloc again.
+ * Every thread has arenas of its own, so the code generator threads
+ * allocate without locking; only the free list is shared. What a
+ * thread allocates stays valid until it releases the arena itself.
+ * The symbol arena is the exception: symbols live as long as the
+ * process and are interned by every thread, so there is one symbol
+ * arena for all of them, and sym.c allocates from it under its lock.
+ */
+
+typedef struct chunk {
+	struct chunk *next;	/* next (older) chunk of the same arena */
+	unsigned size;		/* usable bytes in this chunk */
+} Chunk;
+
+typedef struct {
+	Chunk *chunks;		/* current chunk is first in list */
+	char *next;		/* first free byte in current chunk */
+	char *limit;		/* end of current chunk */
+} Arena;
+
+#define CHUNK_HEADER	((sizeof(Chunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+static __thread Arena arenas[NUM_ARENAS];
+static Arena symbolArena;
+static __thread int currentArena = ARENA_PARSE;
+static Chunk *freeChunks = NULL;
+static pthread_mutex_t freeLock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread jmp_buf *errorHandler = NULL;
+static __thread char message[ERROR_MESSAGE_SIZE];
+
 void error(char *fmt, ...)
 {
 	va_list ap;
 
 	va_start(ap, fmt);
+	if (errorHandler != NULL) {
+		vsnprintf(message, ERROR_MESSAGE_SIZE, fmt, ap);
+		va_end(ap);
+		longjmp(*errorHandler, 1);
+	}
 	printf("Error: ");
 	vprintf(fmt, ap);
 	printf("\n");
@@ -22,21 +64,219 @@ void error(char *fmt, ...)
 	exit(1);
 }
 
-void *allocate(unsigned size)
+/**
+ * @brief Let error() keep its message and jump to a handler instead of
+ * ending the program, in the calling thread
+ *
+ * @param handler set up by setjmp, NULL to end the program again
+ * @return jmp_buf* - the previous handler
+ **/
+jmp_buf *catchErrors(jmp_buf * handler)
+{
+	jmp_buf *previous;
+
+	previous = errorHandler;
+	errorHandler = handler;
+	return previous;
+}
+
+/**
+ * @brief The message of the last error caught in the calling thread
+ *
+ * @return char* - message without the "Error: " prefix
+ **/
+char *errorMessage(void)
+{
+	return message;
+}
+
+static Chunk *newChunk(unsigned size)
+{
+	Chunk *chunk;
+
+	if (size <= ARENA_CHUNK_SIZE) {
+		pthread_mutex_lock(&freeLock);
+		chunk = freeChunks;
+		if (chunk != NULL) {
+			freeChunks = chunk->next;
+		}
+		pthread_mutex_unlock(&freeLock);
+		if (chunk != NULL) {
+			return chunk;
+		}
+	}
+	if (size < ARENA_CHUNK_SIZE) {
+		size = ARENA_CHUNK_SIZE;
+	}
+	chunk = malloc(CHUNK_HEADER + size);
+	if (chunk == NULL) {
+		return NULL;
+	}
+	chunk->size = size;
+	return chunk;
+}
+
+/* like allocateIn, but NULL instead of an error if memory runs out */
+void *tryAllocateIn(int arena, unsigned size)
+{
+	Arena *a;
+	Chunk *chunk;
+	char *p;
+
+	a = arena == ARENA_SYMBOLS ? &symbolArena : &arenas[arena];
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	if (size > ARENA_CHUNK_SIZE / 4 && a->chunks != NULL) {
+		/* big block: give it a chunk of its own, keep bumping in current */
+		chunk = newChunk(size);
+		if (chunk == NULL) {
+			return NULL;
+		}
+		chunk->next = a->chunks->next;
+		a->chunks->next = chunk;
+		return (char *) chunk + CHUNK_HEADER;
+	}
+	if (a->next == NULL || (unsigned) (a->limit - a->next) < size) {
+		chunk = newChunk(size);
+		if (chunk == NULL) {
+			return NULL;
+		}
+		chunk->next = a->chunks;
+		a->chunks = chunk;
+		a->next = (char *) chunk + CHUNK_HEADER;
+		a->limit = a->next + chunk->size;
+	}
+	p = a->next;
+	a->next += size;
+	return p;
+}
+
+void *allocateIn(int arena, unsigned size)
 {
 	void *p;
 
-	p = malloc(size);
+	p = tryAllocateIn(arena, size);
 	if (p == NULL) {
 		error("out of memory");
 	}
 	return p;
 }
 
+void *allocate(unsigned size)
+{
+	return allocateIn(currentArena, size);
+}
+
 void release(void *p)
 {
+	/* arena memory is reclaimed in bulk by releaseArena() */
 	if (p == NULL) {
 		error("NULL pointer detected in release");
 	}
-	free(p);
+}
+
+int selectArena(int arena)
+{
+	int previous;
+
+	previous = currentArena;
+	currentArena = arena;
+	return previous;
+}
+
+void releaseArena(int arena)
+{
+	Arena *a;
+	Chunk *chunk;
+
+	a = arena == ARENA_SYMBOLS ? &symbolArena : &arenas[arena];
+	while (a->chunks != NULL) {
+		chunk = a->chunks;
+		a->chunks = chunk->next;
+		if (chunk->size == ARENA_CHUNK_SIZE) {
+			pthread_mutex_lock(&freeLock);
+			chunk->next = freeChunks;
+			freeChunks = chunk;
+			pthread_mutex_unlock(&freeLock);
+		} else {
+			free(chunk);
+		}
+	}
+	a->next = NULL;
+	a->limit = NULL;
+}
+
+/**
+ * @brief Take the memory of all arenas of the calling thread, e.g.
+ * one that is about to end, so that another thread can adopt it
+ *
+ * @param chunks gets the chunks of every arena, added to what is
+ * already there
+ * @return void
+ **/
+void detachArenas(ArenaChunks chunks)
+{
+	int arena;
+	Arena *a;
+	Chunk *last;
+
+	for (arena = 0; arena < NUM_ARENAS; arena++) {
+		a = &arenas[arena];
+		if (arena == ARENA_SYMBOLS || a->chunks == NULL) {
+			continue;
+		}
+		last = a->chunks;
+		while (last->next != NULL) {
+			last = last->next;
+		}
+		last->next = chunks[arena];
+		chunks[arena] = a->chunks;
+		a->chunks = NULL;
+		a->next = NULL;
+		a->limit = NULL;
+	}
+}
+
+/**
+ * @brief Adopt the memory detached from other threads; it stays valid
+ * until the calling thread releases the arenas it belongs to
+ *
+ * @param chunks detached chunks, emptied
+ * @return void
+ **/
+void attachArenas(ArenaChunks chunks)
+{
+	int arena;
+	Arena *a;
+	Chunk *last;
+
+	for (arena = 0; arena < NUM_ARENAS; arena++) {
+		if (chunks[arena] == NULL) {
+			continue;
+		}
+		a = &arenas[arena];
+		last = chunks[arena];
+		while (last->next != NULL) {
+			last = last->next;
+		}
+		if (a->chunks == NULL) {
+			/* the next allocation starts a chunk of its own */
+			a->chunks = chunks[arena];
+		} else {
+			/* keep bumping in the current chunk */
+			last->next = a->chunks->next;
+			a->chunks->next = chunks[arena];
+		}
+		chunks[arena] = NULL;
+	}
+}
+
+void releaseUnit(void)
+{
+	int arena;
+
+	for (arena = 0; arena < NUM_ARENAS; arena++) {
+		if (arena != ARENA_SYMBOLS) {
+			releaseArena(arena);
+		}
+	}
 }
@@ -5,8 +5,35 @@
 #ifndef _UTILS_H_
 #define _UTILS_H_
 
+#include <setjmp.h>
+
+#define ARENA_SYMBOLS	0	/* interned symbols, shared, never released */
+#define ARENA_PARSE	1	/* tokens and abstract syntax as parsed */
+#define ARENA_ABSYN	2	/* compacted abstract syntax */
+#define ARENA_SEMANT	3	/* types, entries and symbol tables */
+#define ARENA_VARALLOC	4	/* variable allocation */
+#define ARENA_CODEGEN	5	/* code generation */
+#define NUM_ARENAS	6
+
+#define ARENA_CHUNK_SIZE	(64 * 1024)	/* default size of a chunk */
+#define ARENA_ALIGN		8		/* alignment of all blocks */
+
+#define ERROR_MESSAGE_SIZE	512	/* longest message kept by catchErrors */
+
 void error(char *fmt, ...);
+jmp_buf *catchErrors(jmp_buf * handler);
+char *errorMessage(void);
 void *allocate(unsigned size);
 void release(void *p);
 
+typedef struct chunk *ArenaChunks[NUM_ARENAS];	/* arenas of another thread */
+
+int selectArena(int arena);
+void *allocateIn(int arena, unsigned size);
+void *tryAllocateIn(int arena, unsigned size);
+void releaseArena(int arena);
+void releaseUnit(void);
+void detachArenas(ArenaChunks chunks);
+void attachArenas(ArenaChunks chunks);
+
 #endif				/* _UTILS_H_ */
@@ -25,7 +25,7 @@ void allocVars(Absyn * program, Table * globalTable, boolean showVarAlloc)
 	char *builtinProcs[] = {
 		"clearAll"	,	"drawCircle"	,
 		"drawLine"	, 	"exit" 		,
-		"printc"	,	"printc"	,
+		"printc"	,	"readi"		,
 		"printi"	,	"readc"		,
 		"setPixel"	,	"time"
 	};
@@ -39,9 +39,9 @@ void allocVars(Absyn * program, Table * globalTable, boolean showVarAlloc)
 
 	/* compute access information for arguments, parameters and local vars */
 	node = program;
-	while (!node->u.decList.isEmpty) {
-		if (node->u.decList.head->type == ABSYN_PROCDEC) {
-			entry = lookup(globalTable, node->u.decList.head->u.procDec.name);
+	for (i = 0; i < node->u.decList.count; i++) {
+		if (ABSYN(node->u.decList.items[i])->type == ABSYN_PROCDEC) {
+			entry = lookup(globalTable, ABSYN(node->u.decList.items[i])->u.procDec.name);
 
 			/* set incoming arguments offsets */
 			entry->u.procEntry.paramSize =
@@ -49,30 +49,26 @@ void allocVars(Absyn * program, Table * globalTable, boolean showVarAlloc)
 
 			/* set outgoing arguments offsets */
 			entry->u.procEntry.paramSize =
-			setArgOffsets(node->u.decList.head->u.procDec.params,
+			setArgOffsets(ABSYN(ABSYN(node->u.decList.items[i])->u.procDec.params),
 				      entry->u.procEntry.localTable, entry);
 
 			/* set local variable offsets */
 			entry->u.procEntry.localVarSize=
-			setVarOffsets(node->u.decList.head->u.procDec.decls,
+			setVarOffsets(ABSYN(ABSYN(node->u.decList.items[i])->u.procDec.decls),
 				      entry->u.procEntry.localTable, entry);
 		}
-
-		node = node->u.decList.tail;
 	}
 
 	/* compute outgoing area sizes */
 	node = program;
-	while (!node->u.decList.isEmpty) {
-		if (node->u.decList.head->type == ABSYN_PROCDEC) {
+	for (i = 0; i < node->u.decList.count; i++) {
+		if (ABSYN(node->u.decList.items[i])->type == ABSYN_PROCDEC) {
 			entry =
-			lookup(globalTable, node->u.decList.head->u.procDec.name);
+			lookup(globalTable, ABSYN(node->u.decList.items[i])->u.procDec.name);
 
 			entry->u.procEntry.argSize =
-			checkLocalOffsets(node->u.decList.head->u.procDec.body, globalTable);
+			checkLocalOffsets(ABSYN(ABSYN(node->u.decList.items[i])->u.procDec.body), globalTable);
 		}
-
-		node = node->u.decList.tail;
 	}
 
 	/* show variable allocation if requeintsted */
@@ -103,16 +99,15 @@ int setParamOffsets(ParamTypes * params, boolean builtinProcs)
 int setVarOffsets(Absyn * node, Table * symTab, Entry * entry)
 {
 	int varOffset = 0;
+	int i;
 
 	/* set variable offsets */
-	while (!node->u.decList.isEmpty) {
-		if (node->u.decList.head->type == ABSYN_VARDEC) {
-			entry = lookup(symTab, node->u.decList.head->u.varDec.name);
+	for (i = 0; i < node->u.decList.count; i++) {
+		if (ABSYN(node->u.decList.items[i])->type == ABSYN_VARDEC) {
+			entry = lookup(symTab, ABSYN(node->u.decList.items[i])->u.varDec.name);
 			varOffset += entry->u.varEntry.type->byte_size;
 			entry->u.varEntry.offset = -(varOffset);
 		}
-
-		node = node->u.decList.tail;
 	}
 
 	return varOffset;
@@ -122,10 +117,11 @@ int setArgOffsets(Absyn * node, Table * symTab, Entry * entry)
 {
 	Absyn *procDec = node;
 	int argOffset = 0;
+	int i;
 
-	while (!procDec->u.decList.isEmpty) {
-		if (procDec->u.decList.head->type == ABSYN_PARDEC) {
-			entry = lookup(symTab, procDec->u.decList.head->u.parDec.name);
+	for (i = 0; i < procDec->u.decList.count; i++) {
+		if (ABSYN(procDec->u.decList.items[i])->type == ABSYN_PARDEC) {
+			entry = lookup(symTab, ABSYN(procDec->u.decList.items[i])->u.parDec.name);
 			entry->u.varEntry.offset = argOffset;
 			if (entry->u.varEntry.isRef) {
 				argOffset += REF_BYTE_SIZE;
@@ -133,7 +129,6 @@ int setArgOffsets(Absyn * node, Table * symTab, Entry * entry)
 				argOffset += INT_BYTE_SIZE;
 			}
 		}
-		procDec = procDec->u.decList.tail;
 	}
 
 	return argOffset;
@@ -146,15 +141,16 @@ int setLocalAreaOffset(Absyn * node, Table * globalTable)
 	    newarea,
 	    ifarea,
 	    elsearea;
+	int i;
 
-	while (!node->u.stmList.isEmpty) {
+	for (i = 0; i < node->u.stmList.count; i++) {
 		newarea = -1;
 
-		switch (node->u.stmList.head->type) {
+		switch (ABSYN(node->u.stmList.items[i])->type) {
 		case ABSYN_CALLSTM:
 			{
 				callEntry =
-				lookup(globalTable, node->u.stmList.head->u.callStm.name);
+				lookup(globalTable, ABSYN(node->u.stmList.items[i])->u.callStm.name);
 
 				newarea = callEntry->u.procEntry.paramSize;
 				break;
@@ -162,16 +158,16 @@ int setLocalAreaOffset(Absyn * node, Table * globalTable)
 		case ABSYN_COMPSTM:
 			{
 				newarea =
-				checkStmOffsets(node->u.stmList.head->u.compStm.stms, globalTable);
+				checkStmOffsets(ABSYN(ABSYN(node->u.stmList.items[i])->u.compStm.stms), globalTable);
 				break;
 			}
 		case ABSYN_IFSTM:
 			{
 				ifarea =
-				checkStmOffsets(node->u.stmList.head->u.ifStm.thenPart, globalTable);
+				checkStmOffsets(ABSYN(ABSYN(node->u.stmList.items[i])->u.ifStm.thenPart), globalTable);
 
 				elsearea =
-				checkStmOffsets(node->u.stmList.head->u.ifStm.elsePart, globalTable);
+				checkStmOffsets(ABSYN(ABSYN(node->u.stmList.items[i])->u.ifStm.elsePart), globalTable);
 
 				if (ifarea > elsearea) {
 					newarea = ifarea;
@@ -185,7 +181,7 @@ int setLocalAreaOffset(Absyn * node, Table * globalTable)
 		case ABSYN_WHILESTM:
 			{
 				newarea =
-				checkStmOffsets(node->u.stmList.head->u.whileStm.body, globalTable);
+				checkStmOffsets(ABSYN(ABSYN(node->u.stmList.items[i])->u.whileStm.body), globalTable);
 				break;
 			}
 		}
@@ -193,8 +189,6 @@ int setLocalAreaOffset(Absyn * node, Table * globalTable)
 		if (newarea > area) {
 			area = newarea;
 		}
-
-		node = node->u.stmList.tail;
 	}
 
 	return area;
@@ -210,17 +204,20 @@ int checkStms(Absyn * node, Table * symTab)
 	case ABSYN_CALLSTM:
 		{
 			callEntry = lookup(symTab, node->u.callStm.name);
-			showEntry(callEntry);
 			return callEntry->u.procEntry.paramSize;
 		}
+	case ABSYN_STMLIST:
+		{
+			return setLocalAreaOffset(node, symTab);
+		}
 	case ABSYN_COMPSTM:
 		{
-			return checkLocalOffsets(node->u.compStm.stms, symTab);
+			return checkLocalOffsets(ABSYN(node->u.compStm.stms), symTab);
 		}
 	case ABSYN_IFSTM:
 	{
-			ifArea = checkStmOffsets(node->u.ifStm.thenPart, symTab);
-			elseArea = checkStmOffsets(node->u.ifStm.elsePart, symTab);
+			ifArea = checkStmOffsets(ABSYN(node->u.ifStm.thenPart), symTab);
+			elseArea = checkStmOffsets(ABSYN(node->u.ifStm.elsePart), symTab);
 			if (ifArea > elseArea){
 				return ifArea;
 			} else {
@@ -229,11 +226,12 @@ int checkStms(Absyn * node, Table * symTab)
 		}
 	case ABSYN_WHILESTM:
 		{
-			return checkStmOffsets(node->u.whileStm.body, symTab);
+			return checkStmOffsets(ABSYN(node->u.whileStm.body), symTab);
 		}
 	}
 
-	return EXIT_FAILURE;
+	/* statements without calls need no outgoing area */
+	return -1;
 }
 
 int checkStmOffsets(Absyn * node, Table * symTab)
@@ -259,16 +257,16 @@ void showVars(Absyn * program, Table * globalTable)
 	Absyn *node, *vars;
 	Entry *entry, *varEntry;
 	ParamTypes *params;
-	int arg;
+	int arg, i, j;
 
 	node = program;
-	while (!node->u.decList.isEmpty) {
-		if (node->u.decList.head->type == ABSYN_PROCDEC) {
+	for (i = 0; i < node->u.decList.count; i++) {
+		if (ABSYN(node->u.decList.items[i])->type == ABSYN_PROCDEC) {
 			entry =
-			lookup(globalTable, node->u.decList.head->u.procDec.name);
+			lookup(globalTable, ABSYN(node->u.decList.items[i])->u.procDec.name);
 
 			printf("\nVariable allocation for procedure '%s'\n",
-			       symToString(node->u.decList.head->u.procDec.name));
+			       symToString(ABSYN(node->u.decList.items[i])->u.procDec.name));
 
 			params = entry->u.procEntry.paramTypes;
 			arg = 1;
@@ -282,30 +280,26 @@ void showVars(Absyn * program, Table * globalTable)
 			printf("size of argument area = %i\n",
 			       entry->u.procEntry.paramSize);
 
-			vars = node->u.decList.head->u.procDec.params;
-			while (!vars->u.decList.isEmpty) {
+			vars = ABSYN(ABSYN(node->u.decList.items[i])->u.procDec.params);
+			for (j = 0; j < vars->u.decList.count; j++) {
 				varEntry =
 				    lookup(entry->u.procEntry.localTable,
-					   vars->u.decList.head->u.parDec.name);
+					   ABSYN(vars->u.decList.items[j])->u.parDec.name);
 
 				printf("param '%s': fp + %i\n",
-				       symToString(vars->u.decList.head->u. parDec.name),
+				       symToString(ABSYN(vars->u.decList.items[j])->u. parDec.name),
 				       varEntry->u.varEntry.offset);
-
-				vars = vars->u.decList.tail;
 			}
 
-			vars = node->u.decList.head->u.procDec.decls;
-			while (!vars->u.decList.isEmpty) {
+			vars = ABSYN(ABSYN(node->u.decList.items[i])->u.procDec.decls);
+			for (j = 0; j < vars->u.decList.count; j++) {
 				varEntry =
 				    lookup(entry->u.procEntry.localTable,
-					   vars->u.decList.head->u.varDec.name);
+					   ABSYN(vars->u.decList.items[j])->u.varDec.name);
 
 				printf("var '%s': fp - %i\n",
-				       symToString(vars->u.decList.head->u. varDec.name),
+				       symToString(ABSYN(vars->u.decList.items[j])->u. varDec.name),
 				       -(varEntry->u.varEntry.offset));
-
-				vars = vars->u.decList.tail;
 			}
 
 			printf("size of localvar area = %i\n",
@@ -314,7 +308,5 @@ void showVars(Absyn * program, Table * globalTable)
 			printf("size of outgoing area = %i\n",
 			       entry->u.procEntry.argSize);
 		}
-
-		node = node->u.decList.tail;
 	}
 }